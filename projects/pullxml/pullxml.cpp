@@ -1,6 +1,9 @@
 #include "mmap.h"
 #include "xmlscan.h"
 #include "xmlutil.h"
+#include "xmltape.h"
+
+#include <chrono>
 
 using namespace filemapper;
 using namespace svg2b2d;
@@ -9,7 +12,7 @@ int main(int argc, char** argv)
 {
     if (argc < 2)
     {
-        printf("Usage: genimage <svg file>  [output file]\n");
+        printf("Usage: pullxml <svg file>  [-tape]\n");
         return 1;
     }
 
@@ -25,6 +28,38 @@ int main(int argc, char** argv)
 	// Parse the mapped file as XML
     // printing out the con
     ByteSpan s(mapped->data(), mapped->size());
+
+    // Build the structural index instead, and report
+    // how long it took, and what's on it
+    if ((argc > 2) && (strcmp(argv[2], "-tape") == 0))
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        XmlTape tape;
+        tape.build(s);
+
+        auto end = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        size_t depth = 0;
+        size_t maxDepth = 0;
+        for (uint32_t i = 0; i < tape.size(); i++)
+        {
+            if (tape[i].fKind == XML_ELEMENT_TYPE_START_TAG)
+                maxDepth = std::max(maxDepth, ++depth);
+            else if (tape[i].fKind == XML_ELEMENT_TYPE_END_TAG && depth > 0)
+                depth--;
+        }
+
+        printf("bytes: %zu\n", s.size());
+        printf("elements: %zu\n", tape.size());
+        printf("attributes: %zu\n", tape.fAttributes.size());
+        printf("depth: %zu\n", maxDepth);
+        printf("time: %3.3f ms (%3.1f MB/s)\n", ms, ms > 0 ? (s.size() / (1024.0 * 1024.0)) / (ms / 1000.0) : 0.0);
+
+        mapped->close();
+        return 0;
+    }
     
     XmlElementIterator iter(s);
 
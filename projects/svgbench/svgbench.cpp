@@ -0,0 +1,274 @@
+
+#include "blend2d.h"
+#include "mmap.h"
+#include "svgshapes.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace filemapper;
+using namespace svg2b2d;
+
+
+//
+// svgbench
+// Measure rendering of a single document, using different
+// numbers of rasterization threads.  The document is parsed once, and
+// then rendered repeatedly, so only the rendering is being timed.
+// Use the scale to blow small documents up into big renders.
+//
+// After that, the numbers found in the 'd' and 'points' attributes
+// of the document are parsed repeatedly, with chunk_to_double(), and with
+// the pow() based parser it replaced, to compare the two.
+//
+// Usage: svgbench <svg file> [iterations] [scale]
+//
+
+// Render the document once, with the specified thread count
+static void renderDocument(SVGDocument& doc, BLImage& img, uint32_t threadCount, double scale)
+{
+	BLContextCreateInfo createInfo{};
+	createInfo.threadCount = threadCount;
+
+	SVGRenderer ctx(img, createInfo);
+	ctx.clearAll();
+	ctx.scale(scale);
+
+	doc.draw(ctx);
+
+	// Wait for all the threads to finish
+	ctx.flush(BL_CONTEXT_FLUSH_SYNC);
+	ctx.end();
+}
+
+// The number parser chunk_to_double() used to be
+// Kept here as the reference for the comparison
+static double legacy_chunk_to_double(ByteSpan& s) noexcept
+{
+	static constexpr charset digitChars("0123456789");
+
+	double sign = 1.0;
+
+	double res = 0.0;
+	long long intPart = 0, fracPart = 0;
+	bool hasIntPart = false;
+	bool hasFracPart = false;
+
+	// Parse optional sign
+	if (*s == '+') {
+		s++;
+	}
+	else if (*s == '-') {
+		sign = -1;
+		s++;
+	}
+
+	// Parse integer part
+	if (digitChars[*s]) {
+		intPart = chunk_to_u64(s);
+		res = (double)intPart;
+		hasIntPart = true;
+	}
+
+	// Parse fractional part.
+	if (*s == '.') {
+		s++; // Skip '.'
+		auto sentinel = s.fStart;
+
+		if (digitChars(*s)) {
+			fracPart = chunk_to_u64(s);
+			auto ending = s.fStart;
+
+			res += (double)fracPart / pow(10.0, (double)(ending - sentinel));
+			hasFracPart = true;
+		}
+	}
+
+	// A valid number should have integer or fractional part.
+	if (!hasIntPart && !hasFracPart)
+		return 0.0;
+
+	// Parse optional exponent
+	if (*s == 'e' || *s == 'E') {
+		long long expPart = 0;
+		s++; // skip 'E'
+
+		double expSign = 1.0;
+		if (*s == '+') {
+			s++;
+		}
+		else if (*s == '-') {
+			expSign = -1.0;
+			s++;
+		}
+
+		if (digitChars[*s]) {
+			expPart = chunk_to_u64(s);
+			res *= pow(10.0, expSign * (double)expPart);
+		}
+	}
+
+	return res * sign;
+}
+
+// Gather up the numbers in the 'd' and 'points' attributes of the document
+static std::vector<ByteSpan> collectNumbers(const ByteSpan& data)
+{
+	static constexpr charset skipChars(",\t\n\f\r ");
+	static constexpr charset leadingChars("0123456789.+-");
+
+	std::vector<ByteSpan> numbers;
+
+	XmlElementIterator iter(data);
+	while (iter)
+	{
+		for (auto& attr : iter->attributes())
+		{
+			if (attr.nameId() != SVG_NAME_D && attr.nameId() != SVG_NAME_POINTS)
+				continue;
+
+			ByteSpan s = attr.value();
+			while (s)
+			{
+				s = chunk_ltrim(s, skipChars);
+				if (!s)
+					break;
+
+				// skip over path commands
+				if (!leadingChars[*s])
+				{
+					s++;
+					continue;
+				}
+
+				ByteSpan num{};
+				s = scanNumber(s, num);
+				if (!num)
+				{
+					s++;
+					continue;
+				}
+				numbers.push_back(num);
+			}
+		}
+		iter++;
+	}
+
+	return numbers;
+}
+
+template <typename FN>
+static double timeNumbers(const std::vector<ByteSpan>& numbers, int iterations, FN&& parse, double& checksum)
+{
+	checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		for (const auto& num : numbers)
+		{
+			ByteSpan s = num;
+			checksum += parse(s);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void benchNumbers(const ByteSpan& data, int iterations)
+{
+	std::vector<ByteSpan> numbers = collectNumbers(data);
+	if (numbers.empty())
+		return;
+
+	// How often do the two of them disagree?
+	size_t differ = 0;
+	for (const auto& num : numbers)
+	{
+		ByteSpan a = num;
+		ByteSpan b = num;
+		if (chunk_to_double(a) != legacy_chunk_to_double(b))
+			differ++;
+	}
+
+	double sumNew = 0, sumOld = 0;
+	double oldMs = timeNumbers(numbers, iterations, legacy_chunk_to_double, sumOld);
+	double newMs = timeNumbers(numbers, iterations, [](ByteSpan& s) { return chunk_to_double(s); }, sumNew);
+
+	double count = (double)numbers.size() * iterations;
+
+	printf("\n%zu numbers, %d iterations, %zu parse differently\n", numbers.size(), iterations, differ);
+	printf("parser       total ms    ns/number  speedup\n");
+	printf("  pow()  %12.2f  %11.2f  %8.2f\n", oldMs, oldMs * 1e6 / count, 1.0);
+	printf("  fast   %12.2f  %11.2f  %8.2f\n", newMs, newMs * 1e6 / count, oldMs / newMs);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: svgbench <svg file> [iterations] [scale]\n");
+		return 1;
+	}
+
+	const char* filename = argv[1];
+	int iterations = argc > 2 ? atoi(argv[2]) : 20;
+	double scale = argc > 3 ? atof(argv[3]) : 4.0;
+
+	if (iterations < 1)
+		iterations = 1;
+	if (scale <= 0)
+		scale = 1.0;
+
+	auto mapped = mmap::createShared(filename);
+	if (mapped == nullptr)
+	{
+		printf("Could not open: %s\n", filename);
+		return 1;
+	}
+
+	SVGDocument doc;
+	doc.readFromData(ByteSpan(mapped->data(), mapped->size()));
+
+	int width = (int)(doc.width() * scale);
+	int height = (int)(doc.height() * scale);
+	BLImage img(width, height, BL_FORMAT_PRGB32);
+
+	printf("%s: %d X %d, %d iterations\n", filename, width, height, iterations);
+	printf("threads      total ms    ms/frame   speedup\n");
+
+	// 0 is synchronous rendering, the baseline
+	static const uint32_t threadCounts[] = { 0, 1, 2, 4, 8 };
+	double baseline = 0;
+
+	for (auto threadCount : threadCounts)
+	{
+		// warm up, so thread creation and caches are not in the timing
+		renderDocument(doc, img, threadCount, scale);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+			renderDocument(doc, img, threadCount, scale);
+		auto end = std::chrono::steady_clock::now();
+
+		double totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+		double perFrame = totalMs / iterations;
+		if (threadCount == 0)
+			baseline = perFrame;
+
+		if (threadCount == 0)
+			printf("   sync  %12.2f  %10.3f  %8.2f\n", totalMs, perFrame, 1.0);
+		else
+			printf("  %5u  %12.2f  %10.3f  %8.2f\n", threadCount, totalMs, perFrame, baseline / perFrame);
+	}
+
+	benchNumbers(ByteSpan(mapped->data(), mapped->size()), iterations);
+
+	mapped->close();
+
+	return 0;
+}
@@ -0,0 +1,437 @@
+
+#include "blend2d.h"
+#include "mmap.h"
+#include "svgshapes.h"
+#include "base64.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace filemapper;
+using namespace svg2b2d;
+
+
+//
+// svgsuite
+// Benchmark the stages of getting a document onto the screen, over a
+// whole corpus of documents, so regressions in any one of them show up.
+// For each document, the stages are timed separately:
+//   scan   - XmlElementIterator over the whole document, attributes included
+//   build  - SVGDocument::readFromData()
+//   render - SVGDocument::draw(), into an image the size of the document
+// along with the number of heap allocations made by building, and
+// rendering.  Each stage is run a number of times, and the best time is
+// reported, which is the least noisy.  The process-wide caches are cleared
+// before each run, so what they save isn't hidden from the timings.
+//
+// Besides whatever documents are named on the command line (files, or
+// directories of .svg files), a set of synthetic documents is generated,
+// to stress what the corpus might not: lots of paths, deep nesting,
+// lots of <use>, and big inline images.
+//
+// The results are printed as a table, and with -json, written out as
+// JSON, to be compared against from one run to the next.
+//
+// Usage: svgsuite [-n iterations] [-json file] [-nosynthetic] [files or directories...]
+//   With no files, or directories, the 'resources' directory is used.
+//
+
+//
+// Allocation counting
+// Every allocation made through operator new is counted.  Blend2D
+// allocates its own memory with malloc(), so that is not included.
+//
+static std::atomic<uint64_t> gAllocations{ 0 };
+static std::atomic<uint64_t> gAllocatedBytes{ 0 };
+
+void* operator new(size_t size)
+{
+	gAllocations.fetch_add(1, std::memory_order_relaxed);
+	gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	void* p = malloc(size ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+struct AllocationCount
+{
+	uint64_t fCount{ 0 };
+	uint64_t fBytes{ 0 };
+
+	static AllocationCount now() { return AllocationCount{ gAllocations.load(), gAllocatedBytes.load() }; }
+	AllocationCount operator-(const AllocationCount& rhs) const { return AllocationCount{ fCount - rhs.fCount, fBytes - rhs.fBytes }; }
+};
+
+
+
+//
+// Synthetic documents
+//
+static std::string svgHeader(int width, int height)
+{
+	char buff[256];
+	snprintf(buff, sizeof(buff), "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"%d\" height=\"%d\">\n", width, height);
+	return buff;
+}
+
+// Lots of small filled, and stroked, paths
+static std::string synthesizePaths(int count)
+{
+	std::string s = svgHeader(1024, 1024);
+	char buff[256];
+
+	srand(1);
+	for (int i = 0; i < count; i++)
+	{
+		int x = rand() % 1000;
+		int y = rand() % 1000;
+		snprintf(buff, sizeof(buff), "<path d=\"M%d %d l%d %d q10 -20 %d 5 c5 5 -5 10 -12 %d z\" fill=\"#%06x\" stroke=\"black\" stroke-width=\"0.5\"/>\n",
+			x, y, rand() % 30, rand() % 30, rand() % 20, rand() % 20, rand() & 0xffffff);
+		s += buff;
+	}
+	s += "</svg>\n";
+
+	return s;
+}
+
+// Groups nested inside each other, each with a transform, and a shape
+static std::string synthesizeNesting(int depth)
+{
+	std::string s = svgHeader(1024, 1024);
+	char buff[256];
+
+	for (int i = 0; i < depth; i++)
+	{
+		snprintf(buff, sizeof(buff), "<g transform=\"translate(0.5 0.5)\" fill=\"#%06x\">\n<rect x=\"%d\" y=\"%d\" width=\"20\" height=\"10\"/>\n",
+			(i * 2654435761u) & 0xffffff, (i * 7) % 1000, (i * 13) % 1000);
+		s += buff;
+	}
+	for (int i = 0; i < depth; i++)
+		s += "</g>\n";
+	s += "</svg>\n";
+
+	return s;
+}
+
+// One small symbol, drawn lots of times
+static std::string synthesizeUses(int count)
+{
+	std::string s = svgHeader(1024, 1024);
+	char buff[256];
+
+	s += "<defs>\n<g id=\"sym\">\n<circle cx=\"5\" cy=\"5\" r=\"4\" fill=\"red\" stroke=\"navy\"/>\n<rect x=\"2\" y=\"2\" width=\"6\" height=\"6\" fill=\"yellow\"/>\n</g>\n</defs>\n";
+	for (int i = 0; i < count; i++)
+	{
+		snprintf(buff, sizeof(buff), "<use xlink:href=\"#sym\" x=\"%d\" y=\"%d\"/>\n", (i * 11) % 1010, ((i * 11) / 1010) * 11 % 1010);
+		s += buff;
+	}
+	s += "</svg>\n";
+
+	return s;
+}
+
+// A big image, inlined as base64 encoded PNG
+// Each 'seed' draws something different, so no two images are the same
+// data, and each one has to be decoded.
+static std::string synthesizeImage(int size, int seed)
+{
+	BLImage img(size, size, BL_FORMAT_PRGB32);
+	{
+		BLContext ctx(img);
+		BLGradient gradient(BLLinearGradientValues(0, 0, size, size));
+		gradient.addStop(0.0, BLRgba32(0xFFFF0000 | ((seed * 40) & 0xFF)));
+		gradient.addStop(0.5, BLRgba32(0xFF00FF00));
+		gradient.addStop(1.0, BLRgba32(0xFF0000FF | (((seed * 40) & 0xFF) << 16)));
+		ctx.setFillStyle(gradient);
+		ctx.fillAll();
+
+		ctx.setFillStyle(BLRgba32(0x80FFFFFF));
+		for (int i = 0; i < 64; i++)
+			ctx.fillCircle((i * 37 + seed * 101) % size, (i * 91 + seed * 53) % size, size / 16.0);
+		ctx.end();
+	}
+
+	BLImageCodec codec{};
+	codec.findByName("PNG");
+	BLArray<uint8_t> png{};
+	img.writeToData(png, codec);
+
+	std::string encoded((png.size() + 2) / 3 * 4 + 1, '\0');
+	char* end = bintob64(encoded.data(), png.data(), png.size());
+	encoded.resize(end - encoded.data());
+
+	return encoded;
+}
+
+// A few big images, all different
+static std::string synthesizeImages(int count, int size)
+{
+	std::string s = svgHeader(1024, 1024);
+	char buff[256];
+	for (int i = 0; i < count; i++)
+	{
+		snprintf(buff, sizeof(buff), "<image x=\"%d\" y=\"%d\" width=\"512\" height=\"512\" xlink:href=\"data:image/png;base64,", (i % 2) * 512, (i / 2) * 512 % 1024);
+		s += buff;
+		s += synthesizeImage(size, i);
+		s += "\"/>\n";
+	}
+	s += "</svg>\n";
+
+	return s;
+}
+
+
+
+//
+// Running the stages
+//
+struct SuiteResult
+{
+	std::string fName{};
+	size_t fBytes{ 0 };
+	size_t fElements{ 0 };
+	size_t fAttributes{ 0 };
+	int fWidth{ 0 };
+	int fHeight{ 0 };
+
+	double fScanMs{ 0 };
+	double fBuildMs{ 0 };
+	double fRenderMs{ 0 };
+
+	AllocationCount fBuildAllocations{};
+	AllocationCount fRenderAllocations{};
+};
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static constexpr int kMaxRenderSize = 4096;
+
+static SuiteResult runDocument(const std::string& name, const ByteSpan& data, int iterations)
+{
+	SuiteResult res{};
+	res.fName = name;
+	res.fBytes = data.size();
+	res.fScanMs = res.fBuildMs = res.fRenderMs = 1e300;
+
+	for (int i = 0; i < iterations; i++)
+	{
+		// Every iteration starts cold, the process-wide caches would
+		// otherwise have decoded images, and layers, from the last one.
+		// The suite adds no font faces, clearing the font cache only
+		// drops what was looked up.
+		SVGImageCache::shared().clear();
+		SVGFontCache::shared().clear();
+		SVGLayerPool::shared().clear();
+
+		// scan
+		size_t elements = 0;
+		size_t attributes = 0;
+		auto start = std::chrono::steady_clock::now();
+		XmlElementIterator iter(data);
+		while (iter)
+		{
+			elements++;
+			attributes += (*iter).attributes().size();
+			iter++;
+		}
+		res.fScanMs = std::min(res.fScanMs, elapsedMs(start));
+		res.fElements = elements;
+		res.fAttributes = attributes;
+
+		// build
+		AllocationCount before = AllocationCount::now();
+		start = std::chrono::steady_clock::now();
+		SVGDocument doc;
+		doc.readFromData(data);
+		res.fBuildMs = std::min(res.fBuildMs, elapsedMs(start));
+		res.fBuildAllocations = AllocationCount::now() - before;
+
+		// render
+		res.fWidth = std::clamp((int)doc.width(), 1, kMaxRenderSize);
+		res.fHeight = std::clamp((int)doc.height(), 1, kMaxRenderSize);
+		BLImage img(res.fWidth, res.fHeight, BL_FORMAT_PRGB32);
+
+		before = AllocationCount::now();
+		start = std::chrono::steady_clock::now();
+		{
+			SVGRenderer ctx(img);
+			ctx.clearAll();
+			doc.draw(ctx);
+			ctx.end();
+		}
+		res.fRenderMs = std::min(res.fRenderMs, elapsedMs(start));
+		res.fRenderAllocations = AllocationCount::now() - before;
+	}
+
+	return res;
+}
+
+static void printResult(const SuiteResult& r)
+{
+	printf("%-32.32s %10zu %8zu %10.3f %10.3f %10.3f %10llu %10llu\n",
+		r.fName.c_str(), r.fBytes, r.fElements, r.fScanMs, r.fBuildMs, r.fRenderMs,
+		(unsigned long long)r.fBuildAllocations.fCount, (unsigned long long)r.fRenderAllocations.fCount);
+}
+
+static void writeJsonString(FILE* f, const std::string& s)
+{
+	fputc('"', f);
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+			fputc('\\', f);
+		if ((unsigned char)c < 0x20)
+			continue;
+		fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static bool writeJson(const char* filename, const std::vector<SuiteResult>& results, int iterations)
+{
+	FILE* f = fopen(filename, "w");
+	if (f == nullptr)
+		return false;
+
+	fprintf(f, "{\n  \"iterations\": %d,\n  \"documents\": [\n", iterations);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const SuiteResult& r = results[i];
+		fprintf(f, "    { \"name\": ");
+		writeJsonString(f, r.fName);
+		fprintf(f, ", \"bytes\": %zu, \"elements\": %zu, \"attributes\": %zu, \"width\": %d, \"height\": %d,"
+			" \"scan_ms\": %.4f, \"build_ms\": %.4f, \"render_ms\": %.4f,"
+			" \"build_allocations\": %llu, \"build_allocated_bytes\": %llu,"
+			" \"render_allocations\": %llu, \"render_allocated_bytes\": %llu }%s\n",
+			r.fBytes, r.fElements, r.fAttributes, r.fWidth, r.fHeight,
+			r.fScanMs, r.fBuildMs, r.fRenderMs,
+			(unsigned long long)r.fBuildAllocations.fCount, (unsigned long long)r.fBuildAllocations.fBytes,
+			(unsigned long long)r.fRenderAllocations.fCount, (unsigned long long)r.fRenderAllocations.fBytes,
+			(i + 1 < results.size()) ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+	fclose(f);
+
+	return true;
+}
+
+// Files named directly, and the .svg files in directories, sorted
+// so the order is the same from one run to the next
+static std::vector<std::string> gatherFiles(const std::vector<std::string>& paths)
+{
+	std::vector<std::string> files{};
+	std::error_code ec{};
+
+	for (const auto& p : paths)
+	{
+		if (std::filesystem::is_directory(p, ec))
+		{
+			std::vector<std::string> found{};
+			for (const auto& entry : std::filesystem::directory_iterator(p, ec))
+			{
+				if (entry.is_regular_file(ec) && entry.path().extension() == ".svg")
+					found.push_back(entry.path().string());
+			}
+			std::sort(found.begin(), found.end());
+			files.insert(files.end(), found.begin(), found.end());
+		}
+		else
+			files.push_back(p);
+	}
+
+	return files;
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = 5;
+	const char* jsonFile = nullptr;
+	bool synthetic = true;
+	std::vector<std::string> paths{};
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc)
+			jsonFile = argv[++i];
+		else if (strcmp(argv[i], "-nosynthetic") == 0)
+			synthetic = false;
+		else if (argv[i][0] == '-')
+		{
+			printf("Usage: svgsuite [-n iterations] [-json file] [-nosynthetic] [files or directories...]\n");
+			return 1;
+		}
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (iterations < 1)
+		iterations = 1;
+	if (paths.empty())
+		paths.push_back("resources");
+
+	std::vector<SuiteResult> results{};
+
+	printf("%-32s %10s %8s %10s %10s %10s %10s %10s\n", "document", "bytes", "elements", "scan ms", "build ms", "render ms", "build new", "render new");
+
+	for (const auto& filename : gatherFiles(paths))
+	{
+		auto mapped = mmap::createShared(filename.c_str());
+		if (mapped == nullptr)
+		{
+			printf("Could not open: %s\n", filename.c_str());
+			continue;
+		}
+
+		results.push_back(runDocument(filename, ByteSpan(mapped->data(), mapped->size()), iterations));
+		printResult(results.back());
+
+		mapped->close();
+	}
+
+	if (synthetic)
+	{
+		struct Synthetic { const char* fName; std::string fData; };
+		Synthetic docs[] = {
+			{ "synthetic:paths-20000", synthesizePaths(20000) },
+			{ "synthetic:nesting-1000", synthesizeNesting(1000) },
+			{ "synthetic:uses-10000", synthesizeUses(10000) },
+			{ "synthetic:images-4x1024", synthesizeImages(4, 1024) },
+		};
+
+		for (const auto& d : docs)
+		{
+			results.push_back(runDocument(d.fName, ByteSpan(d.fData.data(), d.fData.size()), iterations));
+			printResult(results.back());
+		}
+	}
+
+	if (jsonFile != nullptr && !writeJson(jsonFile, results, iterations))
+	{
+		printf("Could not write: %s\n", jsonFile);
+		return 1;
+	}
+
+	return 0;
+}
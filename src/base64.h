@@ -32,6 +32,7 @@
 
 #include "bspanutil.h"
 #include <cstddef>
+#include <vector>
 
 namespace svg2b2d
 {
@@ -138,6 +139,158 @@ namespace svg2b2d
 
     }
 
+#if defined(SVG_SIMD_SSSE3)
+    //
+    // Decode 16 base64 digits into 12 bytes, using byte shuffles
+    // to translate the digits, and multiply-adds to pack the bits.
+    // Returns false, without writing anything, if any of the 16 is not
+    // a base64 digit ('=', whitespace, ...).
+    // 16 bytes are stored at 'dst', of which 12 are the result.
+    //
+    static inline bool b64_decode16(const uint8_t* src, uint8_t* dst) noexcept
+    {
+        const __m128i lutLo = _mm_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i lutHi = _mm_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i lutRoll = _mm_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71,
+            0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i nibble = _mm_set1_epi8(0x0f);
+
+        __m128i in = _mm_loadu_si128((const __m128i*)src);
+        __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+        __m128i loNibbles = _mm_and_si128(in, nibble);
+
+        // A digit has no bit in common between its two lookups
+        __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0)
+            return false;
+
+        // Turn the digits into their 6-bit values
+        // '/' is the only one that shares its range with another ('+')
+        __m128i eq2F = _mm_cmpeq_epi8(in, _mm_set1_epi8(0x2f));
+        __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+        in = _mm_add_epi8(in, roll);
+
+        // Pack 4 x 6 bits into 3 bytes, in each 32-bit lane
+        __m128i merged = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+        __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        packed = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+        _mm_storeu_si128((__m128i*)dst, packed);
+
+        return true;
+    }
+#endif
+
+    //
+    // Convert a base64 chunk to binary format, into a buffer that
+    // is reused from one call to the next, so there's no allocation
+    // once the buffer has grown to the size of the largest one.
+    // 
+    // Whitespace between the digits (line breaks) is skipped, and
+    // the last group can leave out its '=' padding.  Decoding stops at
+    // the padding, at the end of the chunk, or at anything else that
+    // isn't a digit.
+    // Returns the decoded bytes, which are in 'buff', or an empty
+    // span if the data is badly formed.
+    //
+    static svg2b2d::ByteSpan b64decode(const svg2b2d::ByteSpan& inChunk, std::vector<uint8_t>& buff)
+    {
+        const uint8_t* s = inChunk.fStart;
+        const uint8_t* end = inChunk.fEnd;
+
+        // Room for the 16 byte stores at the end
+        buff.resize((inChunk.size() / 4) * 3 + 16);
+        uint8_t* p = buff.data();
+
+        for (;;)
+        {
+#if defined(SVG_SIMD_SSSE3)
+            while ((end - s >= 16) && b64_decode16(s, p))
+            {
+                s += 16;
+                p += 12;
+            }
+#endif
+
+            // Whole groups of four digits
+            while (end - s >= 4)
+            {
+                uint32_t const a = digittobin[s[0]];
+                uint32_t const b = digittobin[s[1]];
+                uint32_t const c = digittobin[s[2]];
+                uint32_t const d = digittobin[s[3]];
+                
+                // Both of the special values have bit 6 set
+                if ((a | b | c | d) & 0x40)
+                    break;
+
+                uint32_t const v = (a << 18) | (b << 12) | (c << 6) | d;
+                p[0] = (uint8_t)(v >> 16);
+                p[1] = (uint8_t)(v >> 8);
+                p[2] = (uint8_t)v;
+                
+                s += 4;
+                p += 3;
+            }
+
+            // One group, the slow way, skipping whitespace
+            uint8_t q[4];
+            int k = 0;
+            while ((s < end) && (k < 4))
+            {
+                uint8_t const v = digittobin[*s];
+                if (v == notabase64)
+                {
+                    if (!scan_is_wsp(*s))
+                        break;
+                    s++;
+                    continue;
+                }
+
+                q[k++] = v;
+                s++;
+            }
+
+            if (k == 0)
+                break;
+
+            if (k == 1 && q[0] != terminator)
+                return {};
+
+            // Missing padding
+            for (; k < 4; k++)
+                q[k] = terminator;
+
+            if (q[0] == terminator)
+                break;
+            if (q[1] == terminator)
+                return {};
+
+            *p++ = (q[0] << 2u) | (q[1] >> 4u);
+
+            if (q[2] == terminator) {
+                if (q[3] != terminator)
+                    return {};
+                break;
+            }
+
+            *p++ = (q[1] << 4u) | (q[2] >> 2u);
+
+            if (q[3] == terminator)
+                break;
+
+            *p++ = (q[2] << 6u) | q[3];
+        }
+
+        return { buff.data(), p };
+    }
+
     /** Lookup table that converts a integer to base64 digit. */
     static char const bintodigit[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
         "abcdefghijklmnopqrstuvwxyz"
@@ -6,13 +6,19 @@
 
 #include "bspan.h"
 #include "charset.h"
+#include "simdscan.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 
 
 
 namespace svg2b2d
 {
-	static charset wspChars(" \r\n\t\f\v");		// a set of typical whitespace chars
+	static constexpr charset wspChars(" \r\n\t\f\v");		// a set of typical whitespace chars
 	
 	static inline size_t copy_to_cstr(char* str, size_t len, const ByteSpan& a) noexcept;
 	static inline ByteSpan chunk_ltrim(const ByteSpan& a, const charset& skippable) noexcept;
@@ -53,11 +59,7 @@ namespace svg2b2d
 	// Trim the left side of skippable characters
 	static inline ByteSpan chunk_ltrim(const ByteSpan& a, const charset& skippable) noexcept
 	{
-		const uint8_t* start = a.fStart;
-		const uint8_t* end = a.fEnd;
-		while (start < end && skippable(*start))
-			++start;
-		return { start, end };
+		return { scan_skip_set(a.fStart, a.fEnd, skippable), a.fEnd };
 	}
 
 	// trim the right side of skippable characters
@@ -74,22 +76,18 @@ namespace svg2b2d
 	// trim the left and right side of skippable characters
 	static inline ByteSpan chunk_trim(const ByteSpan& a, const charset& skippable) noexcept
 	{
-		const uint8_t* starting = a.fStart;
+		const uint8_t* starting = scan_skip_set(a.fStart, a.fEnd, skippable);
 		const uint8_t* ending = a.fEnd;
-		while (starting < ending && skippable(*starting))
-			++starting;
 		while (starting < ending && skippable(*(ending - 1)))
 			--ending;
 		return { starting, ending };
 	}
 
+	// Skip leading whitespace (the wspChars set)
+	// This is the vectorized equivalent of chunk_ltrim(a, wspChars)
 	static inline ByteSpan chunk_skip_wsp(const ByteSpan& a) noexcept
 	{
-		const uint8_t* start = a.fStart;
-		const uint8_t* end = a.fEnd;
-		while (start < end && wspChars(*start))
-			++start;
-		return { start, end };
+		return { scan_skip_wsp(a.fStart, a.fEnd), a.fEnd };
 	}
 
 	static inline ByteSpan chunk_subchunk(const ByteSpan& a, const size_t startAt, const size_t sz) noexcept
@@ -152,11 +150,9 @@ namespace svg2b2d
 	{
 		const uint8_t* start = a.fStart;
 		const uint8_t* end = a.fEnd;
-		const uint8_t* tokenEnd = start;
-		while (tokenEnd < end && !delims(*tokenEnd))
-			++tokenEnd;
+		const uint8_t* tokenEnd = scan_find_set(start, end, delims);
 
-		if (delims(*tokenEnd))
+		if (tokenEnd < end)
 		{
 			a.fStart = tokenEnd + 1;
 		}
@@ -175,12 +171,43 @@ namespace svg2b2d
 	// or a blank chunk if the character is not found
 	static inline ByteSpan chunk_find_char(const ByteSpan& a, char c) noexcept
 	{
-		const uint8_t* start = a.fStart;
-		const uint8_t* end = a.fEnd;
-		while (start < end && *start != c)
-			++start;
+		return { scan_find_char(a.fStart, a.fEnd, (uint8_t)c), a.fEnd };
+	}
 
-		return { start, end };
+	// A quick estimate of how many numbers there are in a chunk
+	// It counts the places where a number begins: a digit, '.', or sign
+	// that follows something that is not part of a number, or a sign that
+	// is not the sign of an exponent.  Runs like "1.5.5" count as one, so
+	// it can come up short, but it's a single pass, with no conversions.
+	static inline size_t chunk_count_numbers(const ByteSpan& a) noexcept
+	{
+		size_t count = 0;
+		bool inNumber = false;
+		uint8_t prev = 0;
+
+		for (const uint8_t* p = a.fStart; p < a.fEnd; p++)
+		{
+			uint8_t c = *p;
+			if ((uint8_t)(c - '0') <= 9 || c == '.')
+			{
+				if (!inNumber)
+					count++;
+				inNumber = true;
+			}
+			else if (c == '-' || c == '+')
+			{
+				if (!inNumber || (prev != 'e' && prev != 'E'))
+					count++;
+				inNumber = true;
+			}
+			else if (!(inNumber && (c == 'e' || c == 'E')))
+			{
+				inNumber = false;
+			}
+			prev = c;
+		}
+
+		return count;
 	}
 
 	// Take a chunk containing a series of digits and turn
@@ -189,7 +216,7 @@ namespace svg2b2d
 	// or the end of the chunk
 	static inline uint64_t chunk_to_u64(ByteSpan& s)
 	{
-		static charset digitChars("0123456789");
+		static constexpr charset digitChars("0123456789");
 
 		uint64_t v = 0;
 
@@ -204,7 +231,7 @@ namespace svg2b2d
 
 	static inline int64_t chunk_to_i64(ByteSpan& s)
 	{
-		static charset digitChars("0123456789");
+		static constexpr charset digitChars("0123456789");
 
 		int64_t v = 0;
 
@@ -244,7 +271,7 @@ namespace svg2b2d
 
 	static ByteSpan scanNumber(const ByteSpan& inChunk, ByteSpan& numchunk)
 	{
-		static charset digitChars("0123456789");                   // only digits
+		static constexpr charset digitChars("0123456789");                   // only digits
 
 		ByteSpan s = inChunk;
 		numchunk = inChunk;
@@ -298,79 +325,141 @@ namespace svg2b2d
 		return s;
 	}
 
+	// Powers of ten that are exactly representable as a double
+	static constexpr double kExactPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
 	// parse floating point number
 	// includes sign, exponent, and decimal point
 	// The input chunk is altered, with the fStart pointer moved to the end of the number
-	//std::from_chars((const char*)numChunk.fStart, (const char*)numChunk.fEnd, afloat);
+	//
+	// The digits are gathered into a 64-bit mantissa, and a power of ten.
+	// When the mantissa fits in the 53 bits of a double, and the power of
+	// ten is one of the exactly representable ones, the answer is a single
+	// multiply or divide of two exact values, which is correctly rounded
+	// (Clinger's fast path).  That covers nearly every number found in 
+	// path data.  Anything else (very long mantissas, large exponents) 
+	// is handed to std::from_chars, which is also correctly rounded.
 	static inline double chunk_to_double(ByteSpan& s) noexcept
 	{
-		static charset digitChars("0123456789");
-
-		double sign = 1.0;
+		const uint8_t* p = s.fStart;
+		const uint8_t* end = s.fEnd;
 
-		double res = 0.0;
-		long long intPart = 0, fracPart = 0;
-		bool hasIntPart = false;
-		bool hasFracPart = false;
-
-		// Parse optional sign
-		if (*s == '+') {
-			s++;
-		}
-		else if (*s == '-') {
-			sign = -1;
-			s++;
+		bool negative = false;
+		if (p < end && (*p == '+' || *p == '-'))
+		{
+			negative = (*p == '-');
+			p++;
 		}
 
-		// Parse integer part
-		if (digitChars[*s]) {
+		const uint8_t* numStart = p;	// from_chars does not want to see a '+'
 
-			intPart = chunk_to_u64(s);
+		uint64_t mantissa = 0;
+		int significant = 0;			// digits in mantissa, not counting leading zeros
+		int64_t exponent = 0;
+		bool truncated = false;			// more than 19 significant digits
+		bool hasDigits = false;
 
-			res = (double)intPart;
-			hasIntPart = true;
+		// Parse integer part
+		while (p < end && (uint8_t)(*p - '0') <= 9)
+		{
+			uint8_t digit = *p - '0';
+			if (significant < 19)
+			{
+				mantissa = mantissa * 10 + digit;
+				if (mantissa != 0)
+					significant++;
+			}
+			else
+			{
+				exponent++;
+				truncated |= (digit != 0);
+			}
+			p++;
+			hasDigits = true;
 		}
 
 		// Parse fractional part.
-		if (*s == '.') {
-			s++; // Skip '.'
-			auto sentinel = s.fStart;
-
-			if (digitChars(*s)) {
-				fracPart = chunk_to_u64(s);
-				auto ending = s.fStart;
-
-				res += (double)fracPart / pow(10.0, (double)(ending - sentinel));
-				hasFracPart = true;
+		if (p < end && *p == '.')
+		{
+			p++;	// Skip '.'
+			while (p < end && (uint8_t)(*p - '0') <= 9)
+			{
+				uint8_t digit = *p - '0';
+				if (significant < 19)
+				{
+					mantissa = mantissa * 10 + digit;
+					if (mantissa != 0)
+						significant++;
+					exponent--;
+				}
+				else
+				{
+					truncated |= (digit != 0);
+				}
+				p++;
+				hasDigits = true;
 			}
 		}
 
 		// A valid number should have integer or fractional part.
-		if (!hasIntPart && !hasFracPart)
+		if (!hasDigits)
+		{
+			s.fStart = p;
 			return 0.0;
-
+		}
 
 		// Parse optional exponent
-		if (*s == 'e' || *s == 'E') {
-			long long expPart = 0;
-			s++; // skip 'E'
-
-			double expSign = 1.0;
-			if (*s == '+') {
-				s++;
-			}
-			else if (*s == '-') {
-				expSign = -1.0;
-				s++;
+		// It only counts as an exponent if there are digits after it
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const uint8_t* e = p + 1;
+			bool expNegative = false;
+			if (e < end && (*e == '+' || *e == '-'))
+			{
+				expNegative = (*e == '-');
+				e++;
 			}
 
-			if (digitChars[*s]) {
-				expPart = chunk_to_u64(s);
-				res *= pow(10.0, expSign * (double)expPart);
+			if (e < end && (uint8_t)(*e - '0') <= 9)
+			{
+				int64_t expPart = 0;
+				while (e < end && (uint8_t)(*e - '0') <= 9)
+				{
+					if (expPart < 100000)
+						expPart = expPart * 10 + (*e - '0');
+					e++;
+				}
+				exponent += expNegative ? -expPart : expPart;
+				p = e;
 			}
 		}
 
-		return res * sign;
+		s.fStart = p;
+
+		double res = 0.0;
+		if (mantissa == 0)
+		{
+			res = 0.0;
+		}
+		else if (!truncated && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22)
+		{
+			res = (double)mantissa;
+			if (exponent < 0)
+				res /= kExactPowersOfTen[-exponent];
+			else
+				res *= kExactPowersOfTen[exponent];
+		}
+		else
+		{
+			auto result = std::from_chars((const char*)numStart, (const char*)p, res);
+			if (result.ec == std::errc::result_out_of_range)
+				res = exponent > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+		}
+
+		return negative ? -res : res;
 	}
 
 
@@ -412,7 +501,7 @@ namespace svg2b2d {
 // Return true if we found a number, false otherwise
 	static inline bool parseNextNumber(ByteSpan& s, double& outNumber)
 	{
-		static charset whitespaceChars(",\t\n\f\r ");          // whitespace found in paths
+		static constexpr charset whitespaceChars(",\t\n\f\r ");          // whitespace found in paths
 
 		// clear up leading whitespace, including ','
 		s = chunk_ltrim(s, whitespaceChars);
@@ -447,6 +536,84 @@ namespace svg2b2d {
 		return std::string(inChunk.fStart, inChunk.fEnd);
 	}
 
+	// xxHash64, of a span of bytes
+	// Used to find things in caches, quickly, not for security
+	static inline uint64_t svg_hash64(const ByteSpan& inChunk, uint64_t seed = 0) noexcept
+	{
+		static constexpr uint64_t P1 = 11400714785074694791ULL;
+		static constexpr uint64_t P2 = 14029467366897019727ULL;
+		static constexpr uint64_t P3 = 1609587929392839161ULL;
+		static constexpr uint64_t P4 = 9650029242287828579ULL;
+		static constexpr uint64_t P5 = 2870177450012600261ULL;
+
+		auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+		auto read64 = [](const unsigned char* p) { uint64_t v; memcpy(&v, p, 8); return v; };
+		auto read32 = [](const unsigned char* p) { uint32_t v; memcpy(&v, p, 4); return v; };
+		auto round = [&](uint64_t acc, uint64_t input) { return rotl(acc + input * P2, 31) * P1; };
+		auto merge = [&](uint64_t acc, uint64_t val) { return (acc ^ round(0, val)) * P1 + P4; };
+
+		const unsigned char* p = inChunk.fStart;
+		const unsigned char* end = inChunk.fEnd;
+		const size_t len = inChunk.size();
+		uint64_t h{};
+
+		if (len >= 32)
+		{
+			uint64_t v1 = seed + P1 + P2;
+			uint64_t v2 = seed + P2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - P1;
+
+			const unsigned char* limit = end - 32;
+			do {
+				v1 = round(v1, read64(p)); p += 8;
+				v2 = round(v2, read64(p)); p += 8;
+				v3 = round(v3, read64(p)); p += 8;
+				v4 = round(v4, read64(p)); p += 8;
+			} while (p <= limit);
+
+			h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			h = merge(h, v1);
+			h = merge(h, v2);
+			h = merge(h, v3);
+			h = merge(h, v4);
+		}
+		else {
+			h = seed + P5;
+		}
+
+		h += (uint64_t)len;
+
+		while (p + 8 <= end)
+		{
+			h ^= round(0, read64(p));
+			h = rotl(h, 27) * P1 + P4;
+			p += 8;
+		}
+
+		if (p + 4 <= end)
+		{
+			h ^= (uint64_t)read32(p) * P1;
+			h = rotl(h, 23) * P2 + P3;
+			p += 4;
+		}
+
+		while (p < end)
+		{
+			h ^= (*p) * P5;
+			h = rotl(h, 11) * P1;
+			p++;
+		}
+
+		h ^= h >> 33;
+		h *= P2;
+		h ^= h >> 29;
+		h *= P3;
+		h ^= h >> 32;
+
+		return h;
+	}
+
 }
 
 namespace svg2b2d {
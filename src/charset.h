@@ -1,7 +1,7 @@
 #pragma once
 
-#include <bitset>
 #include <cstdint>
+#include <cstddef>
 
 namespace svg2b2d {
 	// Represent a set of characters as a bitset
@@ -23,51 +23,78 @@ namespace svg2b2d {
 	//  and it will no doubt be tied to particular version of the compiler.  Use that
 	//  if it suits your needs.  Meanwhile, at least you can see how such a thing can
 	//  be implemented.
+	//
+	//  The set is a plain table, 256 bits in four 64-bit words, and it can
+	//  be built at compile time:
+	//
+	//   static constexpr charset digitChars("0123456789");
+	//
+	//  A constexpr set, even a function local one, is initialized by the 
+	//  compiler, so there is no static initialization guard to check 
+	//  every time the function is called.
+	//
+	//  Alongside the bits, the set keeps the same information arranged as
+	//  two 16 entry nibble tables, so a whole vector of bytes can be tested
+	//  at once with a pair of byte shuffles (see scan_charset_mask16()).
+	//  For byte 'c', with lo = c & 0x0f, and hi = c >> 4
+	//    hi < 8   -> bit 'hi' of nibbleLo[lo]
+	//    hi >= 8  -> bit 'hi-8' of nibbleHi[lo]
 	struct charset {
-		std::bitset<256> bits;
+		uint64_t bits[4]{};
+		uint8_t nibbleLo[16]{};
+		uint8_t nibbleHi[16]{};
 
-		explicit charset(const char achar) noexcept { addChar(achar); }
-		charset(const char* chars) noexcept { addChars(chars); }
+		constexpr charset() noexcept = default;
+		explicit constexpr charset(const char achar) noexcept { addChar(achar); }
+		constexpr charset(const char* chars) noexcept { addChars(chars); }
 
 
 		// add a single character to the set
-		charset& addChar(const char achar) noexcept
+		constexpr charset& addChar(const char achar) noexcept
 		{
-			bits.set(achar);
+			const uint8_t c = (uint8_t)achar;
+			const uint8_t lo = c & 0x0f;
+			const uint8_t hi = c >> 4;
+
+			bits[c >> 6] |= (uint64_t)1 << (c & 63);
+			if (hi < 8)
+				nibbleLo[lo] |= (uint8_t)(1 << hi);
+			else
+				nibbleHi[lo] |= (uint8_t)(1 << (hi - 8));
+
 			return *this;
 		}
 
-		charset& addChars(const char* chars) noexcept
+		constexpr charset& addChars(const char* chars) noexcept
 		{
-			size_t len = strlen(chars);
-			for (size_t i = 0; i < len; i++)
-				bits.set(chars[i]);
+			for (size_t i = 0; chars[i] != 0; i++)
+				addChar(chars[i]);
 
 			return *this;
 		}
 
-		charset& operator+=(const char achar) noexcept { return addChar(achar); }
-		charset& operator+=(const char* chars) noexcept { return addChars(chars); }
+		constexpr charset& operator+=(const char achar) noexcept { return addChar(achar); }
+		constexpr charset& operator+=(const char* chars) noexcept { return addChars(chars); }
 
-		charset operator+(const char achar) const noexcept
+		constexpr charset operator+(const char achar) const noexcept
 		{
 			charset result(*this);
 			return result.addChar(achar);
 		}
 
-		charset operator+(const char* chars) const noexcept
+		constexpr charset operator+(const char* chars) const noexcept
 		{
 			charset result(*this);
 			return result.addChars(chars);
 		}
 
 		// This one makes it look like an array
-		bool operator [](const uint8_t idx) const noexcept { return bits[idx]; }
+		constexpr bool operator [](const uint8_t idx) const noexcept { return contains(idx); }
 
 		// This way makes it look like a function
-		bool operator ()(const uint8_t idx) const noexcept { return bits[idx]; }
+		constexpr bool operator ()(const uint8_t idx) const noexcept { return contains(idx); }
 
-		bool contains(const uint8_t idx) const noexcept { return bits[idx]; }
+		constexpr bool contains(const uint8_t idx) const noexcept { return ((bits[idx >> 6] >> (idx & 63)) & 1) != 0; }
 
 	};
 
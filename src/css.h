@@ -79,23 +79,34 @@ namespace svg2b2d
         CSSInlineStyleIterator(const ByteSpan& inChunk) : fChunk(inChunk) {}
 
 
+        // Empty declarations (";;", or a trailing ';') are skipped
+        // over, rather than ending the iteration
         bool next()
         {
-            fChunk = chunk_skip_wsp(fChunk);
+            static constexpr charset semiChars(";");
+            static constexpr charset colonChars(":");
+
             fCurrentName = {};
             fCurrentValue = {};
 
-            if (fChunk)
+            while (fChunk)
             {
+                fChunk = chunk_skip_wsp(fChunk);
+                if (!fChunk)
+                    break;
 
-                ByteSpan nextValue = chunk_token(fChunk, svg2b2d::charset(";"));
-                fCurrentName = chunk_trim(chunk_token(nextValue, svg2b2d::charset(":")), wspChars);
+                ByteSpan nextValue = chunk_token(fChunk, semiChars);
+                fCurrentName = chunk_trim(chunk_token(nextValue, colonChars), wspChars);
                 fCurrentValue = chunk_trim(nextValue, wspChars);
 
-                return (bool)fCurrentName && (bool)fCurrentValue;
+                if (fCurrentName && fCurrentValue)
+                    return true;
             }
-            else
-                return false;
+
+            fCurrentName = {};
+            fCurrentValue = {};
+
+            return false;
         }
 
 
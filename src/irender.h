@@ -1,10 +1,230 @@
 #pragma once
 
 #include "blend2d.h"
+#include "svgbox.h"
+#include "svgstats.h"
+
+#include <vector>
+
+// Reasons the current fill, or stroke, would not draw anything
+// Bits in IRender::fHidden
+enum SVGPaintHidden : uint8_t
+{
+	SVG_HIDDEN_NONE			= 0x00,
+	SVG_HIDDEN_FILL			= 0x01,		// fill paint is none, or fully transparent
+	SVG_HIDDEN_FILL_ALPHA	= 0x02,		// opacity is 0
+	SVG_HIDDEN_STROKE		= 0x04,		// stroke paint is none, or fully transparent
+	SVG_HIDDEN_STROKE_WIDTH	= 0x08,		// stroke width is 0
+};
+
+// How many fills, and strokes, were drawn, and how many were
+// skipped because they would not have drawn anything
+// Only counted when SVG_ENABLE_STATS is defined.
+struct SVGDrawStats
+{
+	size_t fFills{ 0 };
+	size_t fStrokes{ 0 };
+	size_t fSkippedFills{ 0 };
+	size_t fSkippedStrokes{ 0 };
+};
+
+// The font text is drawn with, which, like the paints, is inherited
+// fTextAnchor is how much of its advance text is moved back by,
+// 0 for start, 0.5 for middle, 1 for end.  An empty face is the
+// default face of SVGFontCache.
+struct SVGTextState
+{
+	BLFontFace fFontFace{};
+	double fFontSize{ 16 };
+	double fTextAnchor{ 0 };
+};
 
 struct IRender : BLContext
 {
+	// Culling
+	// Nodes check their bounds against the cull box before they 
+	// draw, and skip themselves entirely when they can't be seen.
+	// The cull box is in device space.  Unless it is set, it is 
+	// the size of the target.
+	BLBox fCullBox{};
+	bool fHasCullBox{ false };
+	bool fCulling{ true };
+
+	// Instancing
+	// A <use> that draws the same target over and over draws it from
+	// a cached sprite, or display list, rather than the node tree.
+	bool fInstancing{ true };
+
+	// Layers
+	// A group with an opacity less than 1 is drawn into an offscreen
+	// layer, which is then drawn at that opacity.  Without layers, the
+	// opacity is applied to each fill within the group instead.
+	bool fLayers{ true };
+
+	// Level of detail
+	// Paths with a lot of geometry are drawn from a copy simplified to
+	// within this many device pixels, so detail that can't be seen at
+	// the size it's drawn isn't rasterized.  0 draws everything.
+	double fLevelOfDetail{ 0 };
+
+	// Invisible paint
+	// The styles mark the fill, or stroke, hidden when what they set it to
+	// can't draw anything, so shapes can skip calling fillPath(), or
+	// strokePath(), for nothing.  This is saved and restored along with
+	// the rest of the context state.
+	uint8_t fHidden{ SVG_HIDDEN_NONE };
+	SVGDrawStats fDrawStats{};
+
+	// Text
+	// Also saved and restored along with the rest of the state, but only
+	// copied aside the first time it's changed after a save(), as most
+	// saves never touch it.  Change it through the setters so that
+	// happens.
+	SVGTextState fText{};
+
+	struct SavedState
+	{
+		uint8_t fHidden{ SVG_HIDDEN_NONE };
+		bool fTextSaved{ false };		// fText was pushed on fTextStack
+	};
+	std::vector<SavedState> fStateStack{};
+	std::vector<SVGTextState> fTextStack{};
+
+	IRender() = default;
 	IRender(BLImage& img) : BLContext(img) {}
+	IRender(BLImage& img, const BLContextCreateInfo& createInfo) : BLContext(img, createInfo) {}
+
+	bool culling() const { return fCulling; }
+	void setCulling(bool enabled) { fCulling = enabled; }
+
+	bool instancing() const { return fInstancing; }
+	void setInstancing(bool enabled) { fInstancing = enabled; }
+
+	bool layers() const { return fLayers; }
+	void setLayers(bool enabled) { fLayers = enabled; }
+
+	double levelOfDetail() const { return fLevelOfDetail; }
+	void setLevelOfDetail(double tolerance) { fLevelOfDetail = tolerance; }
+
+	// Only these two, the cookie ones would save, and restore, the
+	// context without the state kept here
+	BLResult save(BLContextCookie&) = delete;
+	BLResult restore(const BLContextCookie&) = delete;
+
+	BLResult save()
+	{
+		fStateStack.push_back(SavedState{ fHidden, false });
+		return BLContext::save();
+	}
+
+	BLResult restore()
+	{
+		if (!fStateStack.empty())
+		{
+			fHidden = fStateStack.back().fHidden;
+			if (fStateStack.back().fTextSaved)
+			{
+				fText = std::move(fTextStack.back());
+				fTextStack.pop_back();
+			}
+			fStateStack.pop_back();
+		}
+		return BLContext::restore();
+	}
+
+	const SVGTextState& textState() const { return fText; }
+	void setTextState(const SVGTextState& text) { saveText(); fText = text; }
+	void setFontFace(const BLFontFace& face) { if (!fText.fFontFace.equals(face)) { saveText(); fText.fFontFace = face; } }
+	void setFontSize(double size) { if (fText.fFontSize != size) { saveText(); fText.fFontSize = size; } }
+	void setTextAnchor(double anchor) { if (fText.fTextAnchor != anchor) { saveText(); fText.fTextAnchor = anchor; } }
+
+	// Keep the text as it was at the last save(), before it's changed
+	void saveText()
+	{
+		if (!fStateStack.empty() && !fStateStack.back().fTextSaved)
+		{
+			fTextStack.push_back(fText);
+			fStateStack.back().fTextSaved = true;
+		}
+	}
+
+	void setPaintHidden(uint8_t reason, bool hidden)
+	{
+		if (hidden)
+			fHidden |= reason;
+		else
+			fHidden &= ~reason;
+	}
+
+	bool fillVisible() const { return (fHidden & (SVG_HIDDEN_FILL | SVG_HIDDEN_FILL_ALPHA)) == 0; }
+	bool strokeVisible() const { return (fHidden & (SVG_HIDDEN_STROKE | SVG_HIDDEN_STROKE_WIDTH)) == 0; }
+
+	const SVGDrawStats& drawStats() const { return fDrawStats; }
+	void resetDrawStats() { fDrawStats = SVGDrawStats{}; }
+
+	// Whether a paint could draw anything at all
+	// none, and colors with an alpha of 0, can't.
+	static bool paintVisible(const BLVar& paint)
+	{
+		if (paint.isNull())
+			return false;
+
+		BLRgba32 color{};
+		if (paint.toRgba32(&color) == BL_SUCCESS)
+			return color.a() != 0;
+
+		return true;
+	}
+
+	void setCullBox(const BLBox& box) { fCullBox = box; fHasCullBox = true; }
+	void resetCullBox() { fHasCullBox = false; }
+	BLBox cullBox() const
+	{
+		if (fHasCullBox)
+			return fCullBox;
+
+		BLSize sz = targetSize();
+		return BLBox(0, 0, sz.w, sz.h);
+	}
+
+	// Could anything drawn within the box, which is in 
+	// user space, end up within the cull box
+	bool isBoxVisible(const BLBox& userBox) const
+	{
+		if (!fCulling || svg2b2d::svgBoxIsUnbounded(userBox))
+			return true;
+
+		BLBox deviceBox = svg2b2d::svgBoxTransform(svg2b2d::svgBoxTransform(userBox, userMatrix()), metaMatrix());
+		return svg2b2d::svgBoxIntersects(deviceBox, cullBox());
+	}
+
+	// How many device pixels one user space unit covers, along x, and along y
+	BLPoint deviceScale() const
+	{
+		BLPoint vx = metaMatrix().mapVector(userMatrix().mapVector(1, 0));
+		BLPoint vy = metaMatrix().mapVector(userMatrix().mapVector(0, 1));
+
+		return BLPoint(std::sqrt(vx.x * vx.x + vx.y * vx.y), std::sqrt(vy.x * vy.x + vy.y * vy.y));
+	}
+
+	// The user, and meta, matrices combined, from user space to device pixels
+	BLMatrix2D deviceMatrix() const
+	{
+		const BLMatrix2D& user = userMatrix();
+		const BLMatrix2D& meta = metaMatrix();
+
+		BLPoint o = meta.mapPoint(user.mapPoint(0, 0));
+		BLPoint vx = meta.mapVector(user.mapVector(1, 0));
+		BLPoint vy = meta.mapVector(user.mapVector(0, 1));
+
+		return BLMatrix2D(vx.x, vx.y, vy.x, vy.y, o.x, o.y);
+	}
+
+	// How far, in user space, the current stroke can reach beyond the geometry
+	double strokeReach() const
+	{
+		return svg2b2d::svgStrokeReach(strokeWidth(), strokeJoin(), strokeMiterLimit());
+	}
 };
 
 // IDrawable
@@ -20,5 +240,7 @@ struct IDrawable
 
 struct SVGRenderer : public IRender
 {
+	SVGRenderer() = default;
 	SVGRenderer(BLImage& img) : IRender(img) {}
+	SVGRenderer(BLImage& img, const BLContextCreateInfo& createInfo) : IRender(img, createInfo) {}
 };
\ No newline at end of file
@@ -2,18 +2,31 @@
 
 /*
 	mmap is the rough equivalent of the mmap() function on Linux
-	This basically allows you to memory map a file, which means you 
-	can access a pointer to the file's contents without having to 
+	This basically allows you to memory map a file, which means you
+	can access a pointer to the file's contents without having to
 	go through IO routines.
 
+	On Windows, this is a file mapping, everywhere else it is
+	mmap() itself, with the pages marked for sequential reading,
+	since that's how the parsers go through them.
+
 	Usage:
-	local m = mmap(filename)
+	auto m = mmap::createShared(filename);
 
-	local bs = binstream(m:getPointer(), #m)
+	ByteSpan s(m->data(), m->size());
 */
+
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <cstdio>
 #include <string>
 #include <cstdint>
@@ -23,14 +36,15 @@
 
 namespace filemapper
 {
+#if defined(_WIN32)
     class mmap
     {
         void* fData{};
         size_t fSize{};
         bool fIsValid{};
 
-        HANDLE fFileHandle{};
-        HANDLE fMapHandle{};
+        HANDLE fFileHandle{ INVALID_HANDLE_VALUE };
+        HANDLE fMapHandle{ INVALID_HANDLE_VALUE };
 
     public:
         mmap(HANDLE filehandle, HANDLE maphandle, void* data, size_t length)
@@ -47,15 +61,18 @@ namespace filemapper
             : fData(nullptr)
             , fSize(0)
             , fIsValid(false)
-            , fFileHandle(nullptr)
-            , fMapHandle(nullptr)
+            , fFileHandle(INVALID_HANDLE_VALUE)
+            , fMapHandle(INVALID_HANDLE_VALUE)
         {}
 
+        mmap(const mmap&) = delete;
+        mmap& operator=(const mmap&) = delete;
+
         virtual ~mmap() { close(); }
 
-        bool isValid() { return fIsValid; }
-        void* data() { return fData; }
-        size_t size() { return fSize; }
+        bool isValid() const { return fIsValid; }
+        void* data() const { return fData; }
+        size_t size() const { return fSize; }
 
         bool close()
         {
@@ -74,6 +91,9 @@ namespace filemapper
                 fFileHandle = INVALID_HANDLE_VALUE;
             }
 
+            fSize = 0;
+            fIsValid = false;
+
             return true;
         }
 
@@ -87,7 +107,7 @@ namespace filemapper
             uint32_t shareMode = FILE_SHARE_READ,
             uint32_t disposition = OPEN_EXISTING)
         {
-            uint32_t flagsAndAttributes = (FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS);
+            uint32_t flagsAndAttributes = (FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN);
 
             HANDLE filehandle = CreateFileA(filename,
                 desiredAccess,
@@ -107,11 +127,15 @@ namespace filemapper
 
             // BUGBUG
             // Need to check whether we're opening for writing or not
-            // if we're opening for writing, then we don't want to 
+            // if we're opening for writing, then we don't want to
             // limit the size in CreateFileMappingA
             LARGE_INTEGER psize;
             BOOL bResult = GetFileSizeEx(filehandle, &psize);
-            int64_t size = psize.QuadPart;
+            int64_t size = bResult ? psize.QuadPart : 0;
+
+            // An empty file can't be mapped, but it's still a file
+            if (size <= 0)
+                return std::make_shared<mmap>(filehandle, INVALID_HANDLE_VALUE, nullptr, 0);
 
             // Open mapping
             HANDLE maphandle = CreateFileMappingA(filehandle, nullptr, PAGE_READONLY, psize.HighPart, psize.LowPart, nullptr);
@@ -140,7 +164,90 @@ namespace filemapper
                 return {};
             }
 
-            return std::make_shared<mmap>(filehandle, maphandle, data, size);
+            return std::make_shared<mmap>(filehandle, maphandle, data, (size_t)size);
+        }
+    };
+#else
+    class mmap
+    {
+        void* fData{};
+        size_t fSize{};
+        bool fIsValid{};
+
+        int fFileHandle{ -1 };
+
+    public:
+        mmap(int filehandle, void* data, size_t length)
+            :fData(data)
+            , fSize(length)
+            , fFileHandle(filehandle)
+        {
+            fIsValid = true;
+        }
+
+        mmap() = default;
+
+        mmap(const mmap&) = delete;
+        mmap& operator=(const mmap&) = delete;
+
+        virtual ~mmap() { close(); }
+
+        bool isValid() const { return fIsValid; }
+        void* data() const { return fData; }
+        size_t size() const { return fSize; }
+
+        bool close()
+        {
+            if (fData != nullptr) {
+                ::munmap(fData, fSize);
+                fData = nullptr;
+            }
+
+            if (fFileHandle != -1) {
+                ::close(fFileHandle);
+                fFileHandle = -1;
+            }
+
+            fSize = 0;
+            fIsValid = false;
+
+            return true;
+        }
+
+        // factory method
+        // The file is mapped read only
+        static std::shared_ptr<mmap> createShared(const char* filename)
+        {
+            int filehandle = ::open(filename, O_RDONLY);
+            if (filehandle == -1)
+                return {};
+
+            struct stat st {};
+            if (::fstat(filehandle, &st) != 0) {
+                ::close(filehandle);
+                return {};
+            }
+
+            size_t size = (size_t)st.st_size;
+
+            // An empty file can't be mapped, but it's still a file
+            if (size == 0)
+                return std::make_shared<mmap>(filehandle, nullptr, 0);
+
+            void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, filehandle, 0);
+            if (data == MAP_FAILED) {
+                ::close(filehandle);
+                return {};
+            }
+
+            // The parsers go through the file front to back, once,
+            // so let the system read ahead aggressively
+#if defined(MADV_SEQUENTIAL)
+            ::madvise(data, size, MADV_SEQUENTIAL);
+#endif
+
+            return std::make_shared<mmap>(filehandle, data, size);
         }
     };
-}
\ No newline at end of file
+#endif
+}
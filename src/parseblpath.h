@@ -5,8 +5,7 @@
 #include "bspanutil.h"
 
 
-#include <map>
-#include <functional>
+#include <array>
 
 
 	//
@@ -16,11 +15,11 @@
 	// Aside from parsing SVG element structure, this is one 
 	// of the most complex functions in the library
 namespace svg2b2d {
-		static charset whitespaceChars(",\t\n\f\r ");          // whitespace found in paths
-		static charset commandChars("mMlLhHvVcCqQsStTaAzZ");   // set of characters used for commands
-		static charset numberChars("0123456789.+-eE");         // digits, symbols, and letters found in numbers
-		static charset leadingChars("0123456789.+-");          // digits, symbols, and letters found in numbers
-		static charset digitChars("0123456789");                   // only digits
+		static constexpr charset whitespaceChars(",\t\n\f\r ");          // whitespace found in paths
+		static constexpr charset commandChars("mMlLhHvVcCqQsStTaAzZ");   // set of characters used for commands
+		static constexpr charset numberChars("0123456789.+-eE");         // digits, symbols, and letters found in numbers
+		static constexpr charset leadingChars("0123456789.+-");          // digits, symbols, and letters found in numbers
+		static constexpr charset digitChars("0123456789");                   // only digits
 
 
 		    // Shaper contour Commands
@@ -514,32 +513,60 @@ namespace svg2b2d {
 		}
 
 
-		// A dispatch std::map that matches the command character to the
-		// appropriate parse function
-		static std::map<SegmentCommand, std::function<bool(ByteSpan&, BLPath&, int&)>> parseMap = {
-			{SegmentCommand::MoveTo, parseMoveTo},
-			{SegmentCommand::MoveBy, parseMoveBy},
-			{SegmentCommand::LineTo, parseLineTo},
-			{SegmentCommand::LineBy, parseLineBy},
-			{SegmentCommand::HLineTo, parseHLineTo},
-			{SegmentCommand::HLineBy, parseHLineBy},
-			{SegmentCommand::VLineTo, parseVLineTo},
-			{SegmentCommand::VLineBy, parseVLineBy},
-			{SegmentCommand::CubicTo, parseCubicTo},
-			{SegmentCommand::CubicBy, parseCubicBy},
-			{SegmentCommand::SCubicTo, parseSmoothCubicTo},
-			{SegmentCommand::SCubicBy, parseSmoothCubicBy},
-			{SegmentCommand::QuadTo, parseQuadTo},
-			{SegmentCommand::QuadBy, parseQuadBy},
-			{SegmentCommand::SQuadTo, parseSmoothQuadTo},
-			{SegmentCommand::SQuadBy, parseSmoothQuadBy},
-			{SegmentCommand::ArcTo, parseArcTo},
-			{SegmentCommand::ArcBy, parseArcBy},
-			{SegmentCommand::CloseTo, parseClose},
-			{SegmentCommand::CloseBy, parseClose}
-		};
+		// The signature shared by all the segment parsers
+		using SegmentParser = bool (*)(ByteSpan&, BLPath&, int&);
+
+		// A flat dispatch table, indexed by the command character, 
+		// that matches it to the appropriate parse function.
+		// Characters that are not commands have no entry.
+		static constexpr std::array<SegmentParser, 128> segmentParsers = []() {
+			std::array<SegmentParser, 128> table{};
+
+			table[(uint8_t)SegmentCommand::MoveTo] = parseMoveTo;
+			table[(uint8_t)SegmentCommand::MoveBy] = parseMoveBy;
+			table[(uint8_t)SegmentCommand::LineTo] = parseLineTo;
+			table[(uint8_t)SegmentCommand::LineBy] = parseLineBy;
+			table[(uint8_t)SegmentCommand::HLineTo] = parseHLineTo;
+			table[(uint8_t)SegmentCommand::HLineBy] = parseHLineBy;
+			table[(uint8_t)SegmentCommand::VLineTo] = parseVLineTo;
+			table[(uint8_t)SegmentCommand::VLineBy] = parseVLineBy;
+			table[(uint8_t)SegmentCommand::CubicTo] = parseCubicTo;
+			table[(uint8_t)SegmentCommand::CubicBy] = parseCubicBy;
+			table[(uint8_t)SegmentCommand::SCubicTo] = parseSmoothCubicTo;
+			table[(uint8_t)SegmentCommand::SCubicBy] = parseSmoothCubicBy;
+			table[(uint8_t)SegmentCommand::QuadTo] = parseQuadTo;
+			table[(uint8_t)SegmentCommand::QuadBy] = parseQuadBy;
+			table[(uint8_t)SegmentCommand::SQuadTo] = parseSmoothQuadTo;
+			table[(uint8_t)SegmentCommand::SQuadBy] = parseSmoothQuadBy;
+			table[(uint8_t)SegmentCommand::ArcTo] = parseArcTo;
+			table[(uint8_t)SegmentCommand::ArcBy] = parseArcBy;
+			table[(uint8_t)SegmentCommand::CloseTo] = parseClose;
+			table[(uint8_t)SegmentCommand::CloseBy] = parseClose;
+
+			return table;
+		}();
+
+
+
+		// Estimate how many vertices parsing the path data will produce
+		// Most segments produce one vertex per pair of numbers.  An arc
+		// can turn into as many as four cubics, so each arc command is
+		// given that many extra, and each close adds one more.
+		static size_t estimatePathVertices(const ByteSpan& inSpan)
+		{
+			static constexpr charset extraChars("AaZz");
+
+			size_t vertices = chunk_count_numbers(inSpan) / 2;
 
+			const uint8_t* p = inSpan.fStart;
+			while ((p = scan_find_set(p, inSpan.fEnd, extraChars)) < inSpan.fEnd)
+			{
+				vertices += (*p == 'Z' || *p == 'z') ? 1 : 12;
+				p++;
+			}
 
+			return vertices;
+		}
 
 		static bool parsePath(const ByteSpan& inSpan, BLPath& apath)
 		{
@@ -566,12 +593,23 @@ namespace svg2b2d {
 					s++;
 				}
 
-				// Use parseMap to dispatch to the appropriate
-				// parse function
-				if (!parseMap[currentCommand](s, apath, iteration))
+				SegmentParser parser = segmentParsers[(uint8_t)currentCommand & 0x7f];
+				if (parser == nullptr)
 					return false;
 
+				// Consume the first set of coordinates, and then as many
+				// implicit repeats of the command as follow it, before
+				// going back to look for the next command
+				do {
+					if (!parser(s, apath, iteration))
+						return false;
+
+					s = chunk_ltrim(s, whitespaceChars);
+				} while (s && iteration > 0 && leadingChars[*s]);
 
+				// Nothing may follow a close, other than a new command
+				if (currentCommand == SegmentCommand::CloseTo || currentCommand == SegmentCommand::CloseBy)
+					currentCommand = SegmentCommand::INVALID;
 			}
 
 			return true;
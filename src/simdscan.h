@@ -0,0 +1,309 @@
+#pragma once
+
+//
+// Byte scanning kernels
+// The scanner spends most of its time looking for the next delimiter
+// ('<', '>', a quote, '&'), or for the first character that is not whitespace.
+// These routines do that 16 or 32 bytes at a time, when the compiler
+// is targeting an instruction set that can do it, and fall back to
+// a simple byte loop otherwise.
+//
+//   AVX2    - 32 bytes per step
+//   SSE2    - 16 bytes per step (always available on x64)
+//   NEON    - 16 bytes per step (always available on arm64)
+//
+// Only whole blocks that lie within [start, end) are ever loaded, the
+// remaining tail is handled a byte at a time, so there is no reading
+// past the end of the span.
+//
+// Arbitrary sets of characters (charset) are tested 16 bytes at a time
+// using byte shuffles, which needs SSSE3 on x86, or NEON.
+//
+// Define SVG_SIMD_DISABLE to force the scalar versions.
+//
+
+#include "charset.h"
+
+#include <cstdint>
+#include <bit>
+
+#if !defined(SVG_SIMD_DISABLE)
+	#if defined(__AVX2__)
+		#define SVG_SIMD_AVX2 1
+		#include <immintrin.h>
+	#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+		#define SVG_SIMD_SSE2 1
+		#include <emmintrin.h>
+	#elif defined(__ARM_NEON) || defined(_M_ARM64)
+		#define SVG_SIMD_NEON 1
+		#include <arm_neon.h>
+	#endif
+
+	#if defined(SVG_SIMD_AVX2) || defined(__SSSE3__) || defined(__AVX__)
+		#define SVG_SIMD_SSSE3 1
+		#include <tmmintrin.h>
+	#endif
+#endif
+
+namespace svg2b2d
+{
+	// Whitespace, as the scanner sees it: ' ', and '\t' '\n' '\v' '\f' '\r'
+	// The last five are the contiguous range 9..13
+	static inline bool scan_is_wsp(uint8_t c) noexcept
+	{
+		return (c == ' ') || ((uint8_t)(c - 9) <= 4);
+	}
+
+#if defined(SVG_SIMD_NEON)
+	// NEON has no movemask.  Narrowing each 16-bit lane by 4 leaves
+	// a nibble per byte, so the first match is at countr_zero() / 4
+	static inline uint64_t scan_neon_mask(uint8x16_t eq) noexcept
+	{
+		uint8x8_t res = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+		return vget_lane_u64(vreinterpret_u64_u8(res), 0);
+	}
+#endif
+
+	// Return a pointer to the first byte in [start, end) that is
+	// equal to any of c0..c3, or 'end' if there is none.
+	// To look for fewer characters, repeat one of them.
+	static inline const uint8_t* scan_find_any(const uint8_t* start, const uint8_t* end, uint8_t c0, uint8_t c1, uint8_t c2, uint8_t c3) noexcept
+	{
+		const uint8_t* p = start;
+
+#if defined(SVG_SIMD_AVX2)
+		const __m256i v0 = _mm256_set1_epi8((char)c0);
+		const __m256i v1 = _mm256_set1_epi8((char)c1);
+		const __m256i v2 = _mm256_set1_epi8((char)c2);
+		const __m256i v3 = _mm256_set1_epi8((char)c3);
+
+		while (end - p >= 32)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i*)p);
+			__m256i eq = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, v0), _mm256_cmpeq_epi8(v, v1)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, v2), _mm256_cmpeq_epi8(v, v3)));
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+			if (mask != 0)
+				return p + std::countr_zero(mask);
+			p += 32;
+		}
+#elif defined(SVG_SIMD_SSE2)
+		const __m128i v0 = _mm_set1_epi8((char)c0);
+		const __m128i v1 = _mm_set1_epi8((char)c1);
+		const __m128i v2 = _mm_set1_epi8((char)c2);
+		const __m128i v3 = _mm_set1_epi8((char)c3);
+
+		while (end - p >= 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)p);
+			__m128i eq = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v, v0), _mm_cmpeq_epi8(v, v1)),
+				_mm_or_si128(_mm_cmpeq_epi8(v, v2), _mm_cmpeq_epi8(v, v3)));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(eq);
+			if (mask != 0)
+				return p + std::countr_zero(mask);
+			p += 16;
+		}
+#elif defined(SVG_SIMD_NEON)
+		const uint8x16_t v0 = vdupq_n_u8(c0);
+		const uint8x16_t v1 = vdupq_n_u8(c1);
+		const uint8x16_t v2 = vdupq_n_u8(c2);
+		const uint8x16_t v3 = vdupq_n_u8(c3);
+
+		while (end - p >= 16)
+		{
+			uint8x16_t v = vld1q_u8(p);
+			uint8x16_t eq = vorrq_u8(
+				vorrq_u8(vceqq_u8(v, v0), vceqq_u8(v, v1)),
+				vorrq_u8(vceqq_u8(v, v2), vceqq_u8(v, v3)));
+			uint64_t mask = scan_neon_mask(eq);
+			if (mask != 0)
+				return p + (std::countr_zero(mask) >> 2);
+			p += 16;
+		}
+#endif
+
+		while (p < end && *p != c0 && *p != c1 && *p != c2 && *p != c3)
+			++p;
+
+		return p;
+	}
+
+	static inline const uint8_t* scan_find_char(const uint8_t* start, const uint8_t* end, uint8_t c) noexcept
+	{
+		return scan_find_any(start, end, c, c, c, c);
+	}
+
+	// Return a pointer to the first byte in [start, end) that
+	// is not whitespace, or 'end' if there is none.
+	static inline const uint8_t* scan_skip_wsp(const uint8_t* start, const uint8_t* end) noexcept
+	{
+		const uint8_t* p = start;
+
+		// Most of the time there is little or no whitespace, so
+		// don't bother setting up a vector unless there is a run of it
+		if (p < end && !scan_is_wsp(*p))
+			return p;
+
+#if defined(SVG_SIMD_AVX2)
+		const __m256i space = _mm256_set1_epi8(' ');
+		const __m256i nine = _mm256_set1_epi8(9);
+		const __m256i four = _mm256_set1_epi8(4);
+
+		while (end - p >= 32)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i*)p);
+			__m256i d = _mm256_sub_epi8(v, nine);		// 9..13 become 0..4
+			__m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+				_mm256_cmpeq_epi8(_mm256_min_epu8(d, four), d));
+			uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(ws);
+			if (mask != 0)
+				return p + std::countr_zero(mask);
+			p += 32;
+		}
+#elif defined(SVG_SIMD_SSE2)
+		const __m128i space = _mm_set1_epi8(' ');
+		const __m128i nine = _mm_set1_epi8(9);
+		const __m128i four = _mm_set1_epi8(4);
+
+		while (end - p >= 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)p);
+			__m128i d = _mm_sub_epi8(v, nine);		// 9..13 become 0..4
+			__m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+				_mm_cmpeq_epi8(_mm_min_epu8(d, four), d));
+			uint32_t mask = ~(uint32_t)_mm_movemask_epi8(ws) & 0xffff;
+			if (mask != 0)
+				return p + std::countr_zero(mask);
+			p += 16;
+		}
+#elif defined(SVG_SIMD_NEON)
+		const uint8x16_t space = vdupq_n_u8(' ');
+		const uint8x16_t nine = vdupq_n_u8(9);
+		const uint8x16_t four = vdupq_n_u8(4);
+
+		while (end - p >= 16)
+		{
+			uint8x16_t v = vld1q_u8(p);
+			uint8x16_t ws = vorrq_u8(vceqq_u8(v, space), vcleq_u8(vsubq_u8(v, nine), four));
+			uint64_t mask = scan_neon_mask(vmvnq_u8(ws));
+			if (mask != 0)
+				return p + (std::countr_zero(mask) >> 2);
+			p += 16;
+		}
+#endif
+
+		while (p < end && scan_is_wsp(*p))
+			++p;
+
+		return p;
+	}
+
+	// Test 16 bytes, starting at 'p', for membership in a charset
+	// Bit 'i' of the returned mask is set if p[i] is in the set.
+	// The caller makes sure there are 16 bytes to read.
+	static inline uint32_t scan_charset_mask16(const charset& cs, const uint8_t* p) noexcept
+	{
+#if defined(SVG_SIMD_SSSE3)
+		const __m128i tableLo = _mm_loadu_si128((const __m128i*)cs.nibbleLo);
+		const __m128i tableHi = _mm_loadu_si128((const __m128i*)cs.nibbleHi);
+		const __m128i bitTable = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+		const __m128i lowMask = _mm_set1_epi8(0x0f);
+
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i lo = _mm_and_si128(v, lowMask);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), lowMask);
+
+		// Pick the row for the low nibble, from one table or the other
+		// depending on the high nibble, then the bit for the high nibble
+		__m128i useLo = _mm_cmplt_epi8(hi, _mm_set1_epi8(8));
+		__m128i row = _mm_or_si128(
+			_mm_and_si128(useLo, _mm_shuffle_epi8(tableLo, lo)),
+			_mm_andnot_si128(useLo, _mm_shuffle_epi8(tableHi, lo)));
+		__m128i bit = _mm_shuffle_epi8(bitTable, hi);
+		__m128i hit = _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+
+		return (uint32_t)_mm_movemask_epi8(hit);
+#elif defined(SVG_SIMD_NEON)
+		static const uint8_t bitBytes[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+		const uint8x16_t tableLo = vld1q_u8(cs.nibbleLo);
+		const uint8x16_t tableHi = vld1q_u8(cs.nibbleHi);
+		const uint8x16_t bitTable = vld1q_u8(bitBytes);
+
+		uint8x16_t v = vld1q_u8(p);
+		uint8x16_t lo = vandq_u8(v, vdupq_n_u8(0x0f));
+		uint8x16_t hi = vshrq_n_u8(v, 4);
+
+		uint8x16_t useLo = vcltq_u8(hi, vdupq_n_u8(8));
+		uint8x16_t row = vbslq_u8(useLo, vqtbl1q_u8(tableLo, lo), vqtbl1q_u8(tableHi, lo));
+		uint8x16_t bit = vqtbl1q_u8(bitTable, hi);
+		uint8x16_t hit = vtstq_u8(row, bit);
+
+		// Collapse to one bit per lane, 8 lanes to a byte
+		// The bit table doubles as the lane weights
+		uint8x16_t lanes = vandq_u8(hit, bitTable);
+		uint32_t low = vaddv_u8(vget_low_u8(lanes));
+		uint32_t high = vaddv_u8(vget_high_u8(lanes));
+
+		return low | (high << 8);
+#else
+		uint32_t mask = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			if (cs.contains(p[i]))
+				mask |= (uint32_t)1 << i;
+		}
+
+		return mask;
+#endif
+	}
+
+	// Return a pointer to the first byte in [start, end) that
+	// is not in the set, or 'end' if there is none.
+	static inline const uint8_t* scan_skip_set(const uint8_t* start, const uint8_t* end, const charset& cs) noexcept
+	{
+		const uint8_t* p = start;
+
+		// Trims are usually short, or empty, so check one byte first
+		if (p < end && !cs.contains(*p))
+			return p;
+
+#if defined(SVG_SIMD_SSSE3) || defined(SVG_SIMD_NEON)
+		while (end - p >= 16)
+		{
+			uint32_t mask = ~scan_charset_mask16(cs, p) & 0xffff;
+			if (mask != 0)
+				return p + std::countr_zero(mask);
+			p += 16;
+		}
+#endif
+
+		while (p < end && cs.contains(*p))
+			++p;
+
+		return p;
+	}
+
+	// Return a pointer to the first byte in [start, end) that
+	// is in the set, or 'end' if there is none.
+	static inline const uint8_t* scan_find_set(const uint8_t* start, const uint8_t* end, const charset& cs) noexcept
+	{
+		const uint8_t* p = start;
+
+#if defined(SVG_SIMD_SSSE3) || defined(SVG_SIMD_NEON)
+		while (end - p >= 16)
+		{
+			uint32_t mask = scan_charset_mask16(cs, p);
+			if (mask != 0)
+				return p + std::countr_zero(mask);
+			p += 16;
+		}
+#endif
+
+		while (p < end && !cs.contains(*p))
+			++p;
+
+		return p;
+	}
+}
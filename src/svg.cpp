@@ -3,8 +3,10 @@
 
 #include "svgshapes.h"
 #include "bspanutil.h"
+#include "svgthreadpool.h"
 
 
+#include <atomic>
 #include <vector>
 #include <memory>
 
@@ -12,22 +14,102 @@
 
 
 
-bool parseSVG(const void* bytes, const size_t sz, BLImage& outImage)
+bool parseSVG(const void* bytes, const size_t sz, BLImage& outImage, const SVGRenderOptions& options)
 {
     svg2b2d::ByteSpan inChunk(bytes, sz);   // = svg2b2d::chunk_from_data_size(bytes, sz);
     
     // Create a new document
-    svg2b2d::SVGDocument doc;
+    // A mask only needs to know what's covered
+    bool coverageOnly = (options.fFormat == BL_FORMAT_A8);
+    svg2b2d::SVGLoadOptions loadOptions{};
+    loadOptions.fCoverageOnly = coverageOnly;
+    svg2b2d::SVGDocument doc(loadOptions);
 
     // Load the document from the data
     doc.readFromData(inChunk);
     
     
     // Draw the document into a IRender
-    outImage.create(doc.width(), doc.height(), BL_FORMAT_PRGB32);
-    SVGRenderer ctx(outImage);
+    outImage.create(doc.width(), doc.height(), coverageOnly ? BL_FORMAT_A8 : BL_FORMAT_PRGB32);
+
+    BLContextCreateInfo createInfo{};
+    createInfo.threadCount = options.fThreadCount;
+
+    SVGRenderer ctx(outImage, createInfo);
+    ctx.setLevelOfDetail(options.fLevelOfDetail);
     doc.draw(ctx);
+
+    // With asynchronous rendering, the drawing commands are
+    // only queued at this point, so wait for all of them to be
+    // rasterized before the context lets go of the image.
+    ctx.flush(BL_CONTEXT_FLUSH_SYNC);
     ctx.end();
+
+    if (options.fStats != nullptr)
+        *options.fStats = doc.stats().report();
     
     return true;
-}
\ No newline at end of file
+}
+
+bool parseSVG(const void* bytes, const size_t sz, BLImage& outImage)
+{
+    return parseSVG(bytes, sz, outImage, SVGRenderOptions{});
+}
+
+
+// Parse and render a single item of a batch, using 
+// the context that belongs to the worker doing the work
+static SVGBatchStatus renderBatchItem(SVGBatchItem& item, SVGRenderer& ctx)
+{
+    if (item.fData == nullptr || item.fSize == 0 || item.fImage == nullptr)
+        return SVG_BATCH_INVALID_INPUT;
+
+    svg2b2d::ByteSpan inChunk(item.fData, item.fSize);
+
+    svg2b2d::SVGDocument doc;
+    doc.readFromData(inChunk);
+
+    if (doc.fRootNode == nullptr)
+        return SVG_BATCH_NO_DOCUMENT;
+
+    if (item.fImage->create(doc.width(), doc.height(), BL_FORMAT_PRGB32) != BL_SUCCESS)
+        return SVG_BATCH_IMAGE_FAILED;
+
+    if (ctx.begin(*item.fImage) != BL_SUCCESS)
+        return SVG_BATCH_FAILED;
+
+    doc.draw(ctx);
+    ctx.end();
+
+    return SVG_BATCH_OK;
+}
+
+size_t parseSVGBatch(SVGBatchItem* items, const size_t count, const uint32_t threadCount)
+{
+    if (items == nullptr || count == 0)
+        return 0;
+
+    svg2b2d::SVGThreadPool pool(threadCount);
+
+    // One context per worker slot, reused for every item that worker renders
+    std::vector<SVGRenderer> contexts(pool.size());
+    std::atomic<size_t> succeeded{ 0 };
+
+    pool.parallelFor(count, [&](size_t idx, size_t slot) {
+        SVGBatchItem& item = items[idx];
+
+        // Don't let one bad document take down the whole batch
+        try {
+            item.fStatus = renderBatchItem(item, contexts[slot]);
+        }
+        catch (...) {
+            contexts[slot].end();
+            item.fStatus = SVG_BATCH_FAILED;
+        }
+
+        if (item.fStatus == SVG_BATCH_OK)
+            succeeded.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    return succeeded.load();
+}
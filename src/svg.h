@@ -13,6 +13,67 @@ bool parseSVG(const void *bytes, const size_t sz, BLImage &outImage);
 }
 #endif
 
+#ifdef __cplusplus
+namespace svg2b2d { struct SVGStatsReport; }
+
+// Options controlling how parseSVG() renders the document
+struct SVGRenderOptions
+{
+    // Number of threads Blend2D uses to rasterize
+    //   0 - synchronous rendering on the calling thread (default)
+    //   1 - asynchronous rendering, done by the calling thread on flush
+    //   N - the calling thread, plus N-1 worker threads
+    uint32_t fThreadCount{ 0 };
+
+    // The format of the image
+    //   BL_FORMAT_PRGB32 - full color (default)
+    //   BL_FORMAT_A8     - coverage only, for masks and glyph atlases.  The
+    //                      geometry, and opacities, are drawn, but not the
+    //                      colors, gradients, or patterns.
+    BLFormat fFormat{ BL_FORMAT_PRGB32 };
+
+    // Simplify detailed paths to within this many pixels, for
+    // small renderings (thumbnails).  0 draws at full detail.
+    double fLevelOfDetail{ 0 };
+
+    // If set, filled in with the counts of loading, and drawing,
+    // the document.  All zero unless built with SVG_ENABLE_STATS.
+    svg2b2d::SVGStatsReport* fStats{ nullptr };
+};
+
+bool parseSVG(const void* bytes, const size_t sz, BLImage& outImage, const SVGRenderOptions& options);
+
+// Status of a single item in a batch
+enum SVGBatchStatus
+{
+    SVG_BATCH_PENDING = 0,          // not processed yet
+    SVG_BATCH_OK,                   // parsed and rendered into the target
+    SVG_BATCH_INVALID_INPUT,        // no data, or no target image
+    SVG_BATCH_NO_DOCUMENT,          // the data did not contain an <svg> element
+    SVG_BATCH_IMAGE_FAILED,         // the target image could not be created
+    SVG_BATCH_FAILED,               // something went wrong while parsing or rendering
+};
+
+// One document in a batch, the data to parse, and the 
+// image to render into.  The image is (re)created to the size
+// of the document, same as parseSVG()
+struct SVGBatchItem
+{
+    const void* fData{ nullptr };
+    size_t fSize{ 0 };
+    BLImage* fImage{ nullptr };
+
+    SVGBatchStatus fStatus{ SVG_BATCH_PENDING };
+};
+
+// Parse and render a batch of documents, spread across
+// threadCount workers (0 == one per hardware thread).
+// Each worker keeps its own rendering context for the whole batch.
+// Returns the number of items that were rendered successfully,
+// the status of each individual item is left in fStatus.
+size_t parseSVGBatch(SVGBatchItem* items, const size_t count, const uint32_t threadCount = 0);
+#endif
+
 
 
 
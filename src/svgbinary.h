@@ -0,0 +1,713 @@
+#pragma once
+
+#include "blend2d.h"
+#include "bspan.h"
+#include "mmap.h"
+#include "svgdisplaylist.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+//
+// Precompiled documents
+// A display list, written out as a binary blob, so a document that's
+// loaded over and over (an asset library, at startup) only has to be
+// parsed once.  Loading the blob back is a matter of checking the
+// header, and copying arrays out of it: the path commands and vertices,
+// the drawing states, the gradient stops, and image pixels all go
+// straight into their Blend2D objects.  There is no XML, and no
+// number parsing.
+//
+// The blob is a header, followed by sections of fixed size records,
+// each starting on an 8 byte boundary, so it can be used straight out
+// of a mapped file, or any other 8 byte aligned memory.  It's written
+// in the byte order of the machine, which the header records, along
+// with a version.  A blob of another version, or byte order, is
+// refused, and has to be made again from the source.
+//
+// Usage:
+//   std::vector<uint8_t> blob;
+//   doc.writeCompiled(blob);
+//   svgWriteBinaryFile("icons.svgdl", blob);
+//   ...
+//   SVGCompiledDocument compiled;
+//   compiled.readFromFile("icons.svgdl");
+//   compiled.draw(ctx);
+//
+namespace svg2b2d {
+
+	enum SVGBinarySection : uint32_t
+	{
+		SVG_BINARY_STATES = 0,
+		SVG_BINARY_COMMANDS,
+		SVG_BINARY_PATHS,
+		SVG_BINARY_PATH_COMMANDS,
+		SVG_BINARY_PATH_VERTICES,
+		SVG_BINARY_DRAW_IMAGES,
+		SVG_BINARY_PAINTS,
+		SVG_BINARY_STOPS,
+		SVG_BINARY_IMAGES,
+		SVG_BINARY_PIXELS,
+
+		SVG_BINARY_SECTION_COUNT
+	};
+
+	// How a state refers to its fill, or stroke
+	enum SVGBinaryPaintKind : uint32_t
+	{
+		SVG_BINARY_PAINT_NONE = 0,
+		SVG_BINARY_PAINT_RGBA32,		// the value is the color
+		SVG_BINARY_PAINT_GRADIENT,		// the value is an index into the paints
+		SVG_BINARY_PAINT_PATTERN,
+	};
+
+	struct SVGBinaryHeader
+	{
+		static constexpr uint32_t kMagic = 0x4c445653;		// "SVDL"
+		static constexpr uint32_t kVersion = 1;
+		static constexpr uint32_t kByteOrder = 0x01020304;
+
+		uint32_t fMagic{ kMagic };
+		uint32_t fVersion{ kVersion };
+		uint32_t fByteOrder{ kByteOrder };
+		uint32_t fReserved{ 0 };
+
+		double fWidth{ 0 };
+		double fHeight{ 0 };
+
+		// Where each section is, in bytes, from the start of the blob
+		uint64_t fOffset[SVG_BINARY_SECTION_COUNT]{};
+		uint64_t fSize[SVG_BINARY_SECTION_COUNT]{};
+	};
+
+	struct SVGBinaryState
+	{
+		double fTransform[6];
+		double fFillAlpha;
+		double fStrokeWidth;
+		double fStrokeMiterLimit;
+		uint32_t fFillKind;
+		uint32_t fFillValue;
+		uint32_t fStrokeKind;
+		uint32_t fStrokeValue;
+		uint8_t fFillRule;
+		uint8_t fStrokeJoin;
+		uint8_t fStrokeCap;
+		uint8_t fFillVisible;
+		uint8_t fStrokeVisible;
+		uint8_t fTransformType;		// not trusted, the reader works it out again
+		uint8_t fReserved[2];
+	};
+
+	struct SVGBinaryCommand
+	{
+		uint32_t fOp;
+		uint32_t fState;
+		uint32_t fIndex;
+		uint32_t fReserved;
+	};
+
+	// Where a path is in the path commands and vertices
+	struct SVGBinaryPath
+	{
+		uint64_t fFirst;
+		uint64_t fSize;
+	};
+
+	struct SVGBinaryDrawImage
+	{
+		uint32_t fImage;
+		int32_t fSrc[4];
+		uint32_t fReserved;
+		double fDst[4];
+	};
+
+	// A gradient, or a pattern
+	struct SVGBinaryPaint
+	{
+		uint32_t fKind;
+		uint32_t fType;				// BLGradientType
+		uint32_t fExtendMode;
+		uint32_t fImage;			// of a pattern
+		int32_t fArea[4];			// of the pattern image
+		uint64_t fFirstStop;
+		uint64_t fStopCount;
+		double fValues[BL_GRADIENT_VALUE_MAX_VALUE + 1];
+		double fMatrix[6];
+	};
+
+	// Pixels are packed, without any padding at the end of rows
+	struct SVGBinaryImage
+	{
+		uint32_t fWidth;
+		uint32_t fHeight;
+		uint32_t fFormat;
+		uint32_t fReserved;
+		uint64_t fPixels;			// offset into the pixels
+	};
+
+	//
+	// SVGBinaryWriter
+	// Gathers the sections of a display list, sharing the gradients,
+	// patterns, and images that the states share.
+	//
+	struct SVGBinaryWriter
+	{
+		std::vector<uint8_t> fSections[SVG_BINARY_SECTION_COUNT]{};
+		std::unordered_map<const void*, uint32_t> fPaintIndex{};
+		std::unordered_map<const void*, uint32_t> fImageIndex{};
+
+		template <typename T>
+		void append(SVGBinarySection section, const T* items, size_t count)
+		{
+			const uint8_t* p = (const uint8_t*)items;
+			fSections[section].insert(fSections[section].end(), p, p + sizeof(T) * count);
+		}
+
+		template <typename T>
+		size_t count(SVGBinarySection section) const { return fSections[section].size() / sizeof(T); }
+
+		static void toDoubles(const BLMatrix2D& m, double* out)
+		{
+			out[0] = m.m00; out[1] = m.m01;
+			out[2] = m.m10; out[3] = m.m11;
+			out[4] = m.m20; out[5] = m.m21;
+		}
+
+		uint32_t addImage(const BLImage& img)
+		{
+			auto it = fImageIndex.find(img._d.impl);
+			if (it != fImageIndex.end())
+				return it->second;
+
+			BLImageData data{};
+			img.getData(&data);
+
+			size_t bpp = (data.format == BL_FORMAT_A8) ? 1 : 4;
+			size_t rowBytes = (size_t)data.size.w * bpp;
+
+			SVGBinaryImage rec{};
+			rec.fWidth = (uint32_t)data.size.w;
+			rec.fHeight = (uint32_t)data.size.h;
+			rec.fFormat = data.format;
+			rec.fPixels = fSections[SVG_BINARY_PIXELS].size();
+
+			std::vector<uint8_t>& pixels = fSections[SVG_BINARY_PIXELS];
+			for (int y = 0; y < data.size.h; y++)
+			{
+				const uint8_t* row = (const uint8_t*)data.pixelData + y * data.stride;
+				pixels.insert(pixels.end(), row, row + rowBytes);
+			}
+
+			// Keep the next image aligned
+			pixels.resize((pixels.size() + 7) & ~size_t(7));
+
+			uint32_t index = (uint32_t)count<SVGBinaryImage>(SVG_BINARY_IMAGES);
+			append(SVG_BINARY_IMAGES, &rec, 1);
+			fImageIndex[img._d.impl] = index;
+
+			return index;
+		}
+
+		// The kind of paint, and the value recorded for it
+		void addPaint(const BLVar& paint, uint32_t& kind, uint32_t& value)
+		{
+			kind = SVG_BINARY_PAINT_NONE;
+			value = 0;
+
+			BLRgba32 color{};
+			if (paint.isNull())
+				return;
+
+			if (!paint.isGradient() && !paint.isPattern())
+			{
+				if (paint.toRgba32(&color) == BL_SUCCESS)
+				{
+					kind = SVG_BINARY_PAINT_RGBA32;
+					value = color.value;
+				}
+				return;
+			}
+
+			kind = paint.isGradient() ? SVG_BINARY_PAINT_GRADIENT : SVG_BINARY_PAINT_PATTERN;
+
+			auto it = fPaintIndex.find(paint._d.impl);
+			if (it != fPaintIndex.end())
+			{
+				value = it->second;
+				return;
+			}
+
+			SVGBinaryPaint rec{};
+			rec.fKind = kind;
+
+			if (paint.isGradient())
+			{
+				const BLGradient& g = paint.as<BLGradient>();
+				rec.fType = g.type();
+				rec.fExtendMode = g.extendMode();
+				rec.fFirstStop = count<BLGradientStop>(SVG_BINARY_STOPS);
+				rec.fStopCount = g.size();
+				for (size_t i = 0; i <= BL_GRADIENT_VALUE_MAX_VALUE; i++)
+					rec.fValues[i] = g.value(i);
+				toDoubles(g.matrix(), rec.fMatrix);
+
+				append(SVG_BINARY_STOPS, g.stops(), g.size());
+			}
+			else
+			{
+				const BLPattern& pat = paint.as<BLPattern>();
+				BLRectI area = pat.area();
+				rec.fExtendMode = pat.extendMode();
+				rec.fImage = addImage(pat.getImage());
+				rec.fArea[0] = area.x; rec.fArea[1] = area.y;
+				rec.fArea[2] = area.w; rec.fArea[3] = area.h;
+				toDoubles(pat.matrix(), rec.fMatrix);
+			}
+
+			value = (uint32_t)count<SVGBinaryPaint>(SVG_BINARY_PAINTS);
+			append(SVG_BINARY_PAINTS, &rec, 1);
+			fPaintIndex[paint._d.impl] = value;
+		}
+
+		void addList(const SVGDisplayList& dl)
+		{
+			for (const auto& s : dl.fStates)
+			{
+				SVGBinaryState rec{};
+				toDoubles(s.fTransform, rec.fTransform);
+				rec.fFillAlpha = s.fFillAlpha;
+				rec.fStrokeWidth = s.fStrokeWidth;
+				rec.fStrokeMiterLimit = s.fStrokeMiterLimit;
+				addPaint(s.fFill, rec.fFillKind, rec.fFillValue);
+				addPaint(s.fStroke, rec.fStrokeKind, rec.fStrokeValue);
+				rec.fFillRule = (uint8_t)s.fFillRule;
+				rec.fStrokeJoin = (uint8_t)s.fStrokeJoin;
+				rec.fStrokeCap = (uint8_t)s.fStrokeCap;
+				rec.fFillVisible = s.fFillVisible;
+				rec.fStrokeVisible = s.fStrokeVisible;
+				rec.fTransformType = s.fTransformType;
+				append(SVG_BINARY_STATES, &rec, 1);
+			}
+
+			for (const auto& cmd : dl.fCommands)
+			{
+				SVGBinaryCommand rec{ (uint32_t)cmd.fOp, cmd.fState, cmd.fIndex, 0 };
+				append(SVG_BINARY_COMMANDS, &rec, 1);
+			}
+
+			for (const auto& path : dl.fPaths)
+			{
+				SVGBinaryPath rec{ count<uint8_t>(SVG_BINARY_PATH_COMMANDS), path.size() };
+				append(SVG_BINARY_PATHS, &rec, 1);
+				append(SVG_BINARY_PATH_COMMANDS, path.commandData(), path.size());
+				append(SVG_BINARY_PATH_VERTICES, path.vertexData(), path.size());
+			}
+
+			for (const auto& img : dl.fImages)
+			{
+				SVGBinaryDrawImage rec{};
+				rec.fImage = addImage(img.fImage);
+				rec.fSrc[0] = img.fSrc.x; rec.fSrc[1] = img.fSrc.y;
+				rec.fSrc[2] = img.fSrc.w; rec.fSrc[3] = img.fSrc.h;
+				rec.fDst[0] = img.fDst.x; rec.fDst[1] = img.fDst.y;
+				rec.fDst[2] = img.fDst.w; rec.fDst[3] = img.fDst.h;
+				append(SVG_BINARY_DRAW_IMAGES, &rec, 1);
+			}
+		}
+
+		// The header, then the sections, each 8 byte aligned
+		void write(double width, double height, std::vector<uint8_t>& out)
+		{
+			SVGBinaryHeader header{};
+			header.fWidth = width;
+			header.fHeight = height;
+
+			uint64_t offset = (sizeof(SVGBinaryHeader) + 7) & ~uint64_t(7);
+			for (uint32_t i = 0; i < SVG_BINARY_SECTION_COUNT; i++)
+			{
+				header.fOffset[i] = offset;
+				header.fSize[i] = fSections[i].size();
+				offset = (offset + fSections[i].size() + 7) & ~uint64_t(7);
+			}
+
+			out.assign(offset, 0);
+			memcpy(out.data(), &header, sizeof(header));
+			for (uint32_t i = 0; i < SVG_BINARY_SECTION_COUNT; i++)
+			{
+				if (!fSections[i].empty())
+					memcpy(out.data() + header.fOffset[i], fSections[i].data(), fSections[i].size());
+			}
+		}
+	};
+
+	// Write a display list out as a blob
+	static inline void svgWriteDisplayList(const SVGDisplayList& dl, double width, double height, std::vector<uint8_t>& out)
+	{
+		SVGBinaryWriter writer{};
+		writer.addList(dl);
+		writer.write(width, height, out);
+	}
+
+	//
+	// SVGBinaryReader
+	// Checks a blob, and hands out its sections as arrays.  Nothing
+	// in the blob is trusted: every section, and every index into one,
+	// is checked against what's actually there.
+	//
+	struct SVGBinaryReader
+	{
+		ByteSpan fBlob{};
+		SVGBinaryHeader fHeader{};
+
+		bool open(const ByteSpan& blob)
+		{
+			fBlob = blob;
+			if (blob.size() < sizeof(SVGBinaryHeader) || ((uintptr_t)blob.fStart & 7) != 0)
+				return false;
+
+			memcpy(&fHeader, blob.fStart, sizeof(fHeader));
+			if (fHeader.fMagic != SVGBinaryHeader::kMagic ||
+				fHeader.fVersion != SVGBinaryHeader::kVersion ||
+				fHeader.fByteOrder != SVGBinaryHeader::kByteOrder)
+				return false;
+
+			for (uint32_t i = 0; i < SVG_BINARY_SECTION_COUNT; i++)
+			{
+				if ((fHeader.fOffset[i] & 7) != 0 ||
+					fHeader.fOffset[i] > blob.size() ||
+					fHeader.fSize[i] > blob.size() - fHeader.fOffset[i])
+					return false;
+			}
+
+			return true;
+		}
+
+		// The records of a section, and how many there are
+		template <typename T>
+		const T* records(SVGBinarySection section, size_t& n) const
+		{
+			n = fHeader.fSize[section] / sizeof(T);
+			return (const T*)(fBlob.fStart + fHeader.fOffset[section]);
+		}
+
+		static BLMatrix2D toMatrix(const double* m)
+		{
+			return BLMatrix2D(m[0], m[1], m[2], m[3], m[4], m[5]);
+		}
+
+		// Whether the commands are laid out the way a BLPath's are: each
+		// figure starts with a move, a quad is followed by its end point,
+		// a cubic by its second control point and end point, and every
+		// point that isn't a close is finite
+		static bool validPath(const uint8_t* cmds, const BLPoint* verts, size_t n)
+		{
+			bool inFigure = false;
+			size_t i = 0;
+			while (i < n)
+			{
+				uint8_t cmd = cmds[i];
+				if (cmd != BL_PATH_CMD_CLOSE && !(std::isfinite(verts[i].x) && std::isfinite(verts[i].y)))
+					return false;
+
+				switch (cmd)
+				{
+				case BL_PATH_CMD_MOVE:
+					inFigure = true;
+					i++;
+				break;
+
+				case BL_PATH_CMD_ON:
+					if (!inFigure)
+						return false;
+					i++;
+				break;
+
+				case BL_PATH_CMD_QUAD:
+					if (!inFigure || i + 1 >= n || cmds[i + 1] != BL_PATH_CMD_ON)
+						return false;
+					i++;		// the end point is checked as an ON
+				break;
+
+				case BL_PATH_CMD_CUBIC:
+					if (!inFigure || i + 2 >= n || cmds[i + 1] != BL_PATH_CMD_CUBIC || cmds[i + 2] != BL_PATH_CMD_ON)
+						return false;
+					if (!(std::isfinite(verts[i + 1].x) && std::isfinite(verts[i + 1].y)))
+						return false;
+					i += 2;
+				break;
+
+				case BL_PATH_CMD_CLOSE:
+					if (!inFigure)
+						return false;
+					i++;
+				break;
+
+				default:
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		// Make each image once, everything that refers to the same
+		// one shares it, as it was written
+		bool readImages(std::vector<BLImage>& images) const
+		{
+			size_t nImages = 0;
+			const SVGBinaryImage* recs = records<SVGBinaryImage>(SVG_BINARY_IMAGES, nImages);
+
+			images.resize(nImages);
+			for (size_t i = 0; i < nImages; i++)
+			{
+				if (!readImage(recs[i], images[i]))
+					return false;
+			}
+
+			return true;
+		}
+
+		bool readImage(const SVGBinaryImage& rec, BLImage& img) const
+		{
+			size_t bpp = (rec.fFormat == BL_FORMAT_A8) ? 1 : 4;
+			size_t rowBytes = (size_t)rec.fWidth * bpp;
+			uint64_t bytes = (uint64_t)rowBytes * rec.fHeight;
+			if (rec.fPixels > fHeader.fSize[SVG_BINARY_PIXELS] || bytes > fHeader.fSize[SVG_BINARY_PIXELS] - rec.fPixels)
+				return false;
+
+			if (img.create((int)rec.fWidth, (int)rec.fHeight, (BLFormat)rec.fFormat) != BL_SUCCESS)
+				return false;
+
+			BLImageData data{};
+			if (img.makeMutable(&data) != BL_SUCCESS)
+				return false;
+
+			const uint8_t* src = fBlob.fStart + fHeader.fOffset[SVG_BINARY_PIXELS] + rec.fPixels;
+			for (uint32_t y = 0; y < rec.fHeight; y++)
+				memcpy((uint8_t*)data.pixelData + y * data.stride, src + y * rowBytes, rowBytes);
+
+			return true;
+		}
+
+		bool readPaint(uint32_t kind, uint32_t value, std::vector<BLVar>& paints, BLVar& out) const
+		{
+			switch (kind)
+			{
+			case SVG_BINARY_PAINT_NONE:
+				blVarAssignNull(&out);
+			return true;
+
+			case SVG_BINARY_PAINT_RGBA32:
+				blVarAssignRgba32(&out, value);
+			return true;
+
+			case SVG_BINARY_PAINT_GRADIENT:
+			case SVG_BINARY_PAINT_PATTERN:
+				if (value >= paints.size())
+					return false;
+				blVarAssignWeak(&out, &paints[value]);
+			return true;
+			}
+
+			return false;
+		}
+
+		// Make the gradients, and patterns, the states share
+		bool readPaints(const std::vector<BLImage>& images, std::vector<BLVar>& paints) const
+		{
+			size_t nPaints = 0, nStops = 0;
+			const SVGBinaryPaint* recs = records<SVGBinaryPaint>(SVG_BINARY_PAINTS, nPaints);
+			const BLGradientStop* stops = records<BLGradientStop>(SVG_BINARY_STOPS, nStops);
+
+			paints.resize(nPaints);
+			for (size_t i = 0; i < nPaints; i++)
+			{
+				const SVGBinaryPaint& rec = recs[i];
+				if (rec.fKind == SVG_BINARY_PAINT_GRADIENT)
+				{
+					if (rec.fFirstStop > nStops || rec.fStopCount > nStops - rec.fFirstStop || rec.fType >= BL_GRADIENT_TYPE_MAX_VALUE + 1)
+						return false;
+
+					BLGradient g((BLGradientType)rec.fType, rec.fValues);
+					g.setExtendMode((BLExtendMode)rec.fExtendMode);
+					g.assignStops(stops + rec.fFirstStop, (size_t)rec.fStopCount);
+					g.setMatrix(toMatrix(rec.fMatrix));
+					blVarAssignWeak(&paints[i], &g);
+				}
+				else if (rec.fKind == SVG_BINARY_PAINT_PATTERN)
+				{
+					if (rec.fImage >= images.size())
+						return false;
+
+					BLPattern pat(images[rec.fImage], BLRectI(rec.fArea[0], rec.fArea[1], rec.fArea[2], rec.fArea[3]), (BLExtendMode)rec.fExtendMode, toMatrix(rec.fMatrix));
+					blVarAssignWeak(&paints[i], &pat);
+				}
+				else
+					return false;
+			}
+
+			return true;
+		}
+
+		// Replace the contents of the list with what's in the blob
+		bool readList(SVGDisplayList& dl) const
+		{
+			dl.clear();
+
+			std::vector<BLImage> sharedImages{};
+			if (!readImages(sharedImages))
+				return false;
+
+			std::vector<BLVar> paints{};
+			if (!readPaints(sharedImages, paints))
+				return false;
+
+			size_t n = 0;
+			const SVGBinaryState* states = records<SVGBinaryState>(SVG_BINARY_STATES, n);
+			dl.fStates.resize(n);
+			for (size_t i = 0; i < n; i++)
+			{
+				const SVGBinaryState& rec = states[i];
+				SVGDrawState& s = dl.fStates[i];
+				s.fTransform = toMatrix(rec.fTransform);
+				s.fFillAlpha = rec.fFillAlpha;
+				s.fStrokeWidth = rec.fStrokeWidth;
+				s.fStrokeMiterLimit = rec.fStrokeMiterLimit;
+				if (!readPaint(rec.fFillKind, rec.fFillValue, paints, s.fFill) ||
+					!readPaint(rec.fStrokeKind, rec.fStrokeValue, paints, s.fStroke))
+					return false;
+				s.fFillRule = (BLFillRule)rec.fFillRule;
+				s.fStrokeJoin = (BLStrokeJoin)rec.fStrokeJoin;
+				s.fStrokeCap = (BLStrokeCap)rec.fStrokeCap;
+				s.fFillVisible = rec.fFillVisible != 0;
+				s.fStrokeVisible = rec.fStrokeVisible != 0;
+				s.fTransformType = (uint8_t)s.fTransform.type();
+			}
+
+			size_t nCmds = 0, nVerts = 0, nPaths = 0;
+			const uint8_t* cmds = records<uint8_t>(SVG_BINARY_PATH_COMMANDS, nCmds);
+			const BLPoint* verts = records<BLPoint>(SVG_BINARY_PATH_VERTICES, nVerts);
+			const SVGBinaryPath* paths = records<SVGBinaryPath>(SVG_BINARY_PATHS, nPaths);
+			if (nCmds != nVerts)
+				return false;
+
+			dl.fPaths.resize(nPaths);
+			for (size_t i = 0; i < nPaths; i++)
+			{
+				const SVGBinaryPath& rec = paths[i];
+				if (rec.fFirst > nCmds || rec.fSize > nCmds - rec.fFirst)
+					return false;
+				if (!validPath(cmds + rec.fFirst, verts + rec.fFirst, (size_t)rec.fSize))
+					return false;
+
+				uint8_t* cmdOut = nullptr;
+				BLPoint* vtxOut = nullptr;
+				if (dl.fPaths[i].modifyOp(BL_MODIFY_OP_ASSIGN_FIT, (size_t)rec.fSize, &cmdOut, &vtxOut) != BL_SUCCESS)
+					return false;
+
+				memcpy(cmdOut, cmds + rec.fFirst, (size_t)rec.fSize);
+				memcpy(vtxOut, verts + rec.fFirst, (size_t)rec.fSize * sizeof(BLPoint));
+			}
+
+			const SVGBinaryDrawImage* images = records<SVGBinaryDrawImage>(SVG_BINARY_DRAW_IMAGES, n);
+			dl.fImages.resize(n);
+			for (size_t i = 0; i < n; i++)
+			{
+				const SVGBinaryDrawImage& rec = images[i];
+				SVGDrawImage& img = dl.fImages[i];
+				if (rec.fImage >= sharedImages.size())
+					return false;
+				img.fImage = sharedImages[rec.fImage];
+				img.fSrc = BLRectI(rec.fSrc[0], rec.fSrc[1], rec.fSrc[2], rec.fSrc[3]);
+				img.fDst = BLRect(rec.fDst[0], rec.fDst[1], rec.fDst[2], rec.fDst[3]);
+			}
+
+			const SVGBinaryCommand* commands = records<SVGBinaryCommand>(SVG_BINARY_COMMANDS, n);
+			dl.fCommands.resize(n);
+			for (size_t i = 0; i < n; i++)
+			{
+				const SVGBinaryCommand& rec = commands[i];
+				size_t limit = (rec.fOp == SVG_DRAW_OP_PATH) ? dl.fPaths.size() : dl.fImages.size();
+				if (rec.fOp > SVG_DRAW_OP_IMAGE || rec.fState >= dl.fStates.size() || rec.fIndex >= limit)
+					return false;
+
+				dl.fCommands[i] = SVGDrawCommand{ (SVGDrawOp)rec.fOp, rec.fState, rec.fIndex };
+			}
+
+			return true;
+		}
+	};
+
+	//
+	// SVGCompiledDocument
+	// A document loaded from a blob, rather than parsed.  It draws the
+	// same as the SVGDocument it was written from.
+	//
+	struct SVGCompiledDocument : public IDrawable
+	{
+		SVGDisplayList fList{};
+		double fWidth{ 0 };
+		double fHeight{ 0 };
+
+		double width() const { return fWidth; }
+		double height() const { return fHeight; }
+
+		void clear()
+		{
+			fList.clear();
+			fWidth = 0;
+			fHeight = 0;
+		}
+
+		// Returns false if the blob isn't one that can be read
+		bool readFromData(const ByteSpan& blob)
+		{
+			clear();
+
+			SVGBinaryReader reader{};
+			if (!reader.open(blob) || !reader.readList(fList))
+			{
+				fList.clear();
+				return false;
+			}
+
+			fWidth = reader.fHeader.fWidth;
+			fHeight = reader.fHeader.fHeight;
+
+			return true;
+		}
+
+		// Everything is copied out of the mapping, so it's
+		// only mapped while loading
+		bool readFromFile(const char* filename)
+		{
+			auto mapped = filemapper::mmap::createShared(filename);
+			if (mapped == nullptr)
+				return false;
+
+			return readFromData(ByteSpan(mapped->data(), mapped->size()));
+		}
+
+		void draw(IRender& ctx) override
+		{
+			fList.draw(ctx);
+		}
+	};
+
+	static inline bool svgWriteBinaryFile(const char* filename, const std::vector<uint8_t>& blob)
+	{
+		FILE* f = fopen(filename, "wb");
+		if (f == nullptr)
+			return false;
+
+		bool success = fwrite(blob.data(), 1, blob.size(), f) == blob.size();
+		success = (fclose(f) == 0) && success;
+
+		return success;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "blend2d.h"
+
+#include <cmath>
+
+//
+// Bounding box helpers
+// Used for working out what a node covers, and whether
+// any of it can be seen by a context.
+//
+// Two special boxes are used:
+//   empty      - covers nothing, the union of no boxes
+//   unbounded  - could cover anything, never culled
+//
+namespace svg2b2d {
+
+	static constexpr double kSVGBoxLimit = 1e30;
+
+	static inline BLBox svgBoxEmpty() noexcept { return BLBox(kSVGBoxLimit, kSVGBoxLimit, -kSVGBoxLimit, -kSVGBoxLimit); }
+	static inline BLBox svgBoxUnbounded() noexcept { return BLBox(-kSVGBoxLimit, -kSVGBoxLimit, kSVGBoxLimit, kSVGBoxLimit); }
+
+	static inline bool svgBoxIsEmpty(const BLBox& b) noexcept { return (b.x0 > b.x1) || (b.y0 > b.y1); }
+	static inline bool svgBoxIsUnbounded(const BLBox& b) noexcept
+	{
+		return (b.x0 <= -kSVGBoxLimit) || (b.y0 <= -kSVGBoxLimit) || (b.x1 >= kSVGBoxLimit) || (b.y1 >= kSVGBoxLimit);
+	}
+
+	static inline BLBox svgBoxUnion(const BLBox& a, const BLBox& b) noexcept
+	{
+		if (svgBoxIsEmpty(a))
+			return b;
+		if (svgBoxIsEmpty(b))
+			return a;
+
+		return BLBox(a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+			a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1);
+	}
+
+	static inline bool svgBoxIntersects(const BLBox& a, const BLBox& b) noexcept
+	{
+		if (svgBoxIsEmpty(a) || svgBoxIsEmpty(b))
+			return false;
+
+		return (a.x0 < b.x1) && (b.x0 < a.x1) && (a.y0 < b.y1) && (b.y0 < a.y1);
+	}
+
+	// Grow the box by 'd' on all sides
+	static inline BLBox svgBoxInflate(const BLBox& b, double d) noexcept
+	{
+		if (d <= 0 || svgBoxIsEmpty(b) || svgBoxIsUnbounded(b))
+			return b;
+
+		return BLBox(b.x0 - d, b.y0 - d, b.x1 + d, b.y1 + d);
+	}
+
+	// The axis aligned box that holds the transformed corners of the box
+	static inline BLBox svgBoxTransform(const BLBox& b, const BLMatrix2D& m) noexcept
+	{
+		if (svgBoxIsEmpty(b) || svgBoxIsUnbounded(b))
+			return b;
+
+		// Only a translation, the box just moves
+		if (m.m00 == 1.0 && m.m01 == 0.0 && m.m10 == 0.0 && m.m11 == 1.0)
+			return BLBox(b.x0 + m.m20, b.y0 + m.m21, b.x1 + m.m20, b.y1 + m.m21);
+
+		BLPoint pts[4] = { m.mapPoint(b.x0, b.y0), m.mapPoint(b.x1, b.y0), m.mapPoint(b.x1, b.y1), m.mapPoint(b.x0, b.y1) };
+
+		BLBox res(pts[0].x, pts[0].y, pts[0].x, pts[0].y);
+		for (int i = 1; i < 4; i++)
+		{
+			res.x0 = pts[i].x < res.x0 ? pts[i].x : res.x0;
+			res.y0 = pts[i].y < res.y0 ? pts[i].y : res.y0;
+			res.x1 = pts[i].x > res.x1 ? pts[i].x : res.x1;
+			res.y1 = pts[i].y > res.y1 ? pts[i].y : res.y1;
+		}
+
+		return res;
+	}
+
+	// An upper bound on how much the matrix can stretch a distance
+	static inline double svgMatrixMaxScale(const BLMatrix2D& m) noexcept
+	{
+		return std::sqrt(m.m00 * m.m00 + m.m01 * m.m01 + m.m10 * m.m10 + m.m11 * m.m11);
+	}
+
+	// How far beyond the geometry a stroke can reach
+	// Half the width, stretched by how far a miter join,
+	// or a square cap, can stick out.
+	static inline double svgStrokeReach(double width, BLStrokeJoin join, double miterLimit) noexcept
+	{
+		double factor = 1.4142135623730951;		// square cap, at 45 degrees
+		bool isMiter = (join == BL_STROKE_JOIN_MITER_CLIP) || (join == BL_STROKE_JOIN_MITER_BEVEL) || (join == BL_STROKE_JOIN_MITER_ROUND);
+		if (isMiter && miterLimit > factor)
+			factor = miterLimit;
+
+		return width * 0.5 * factor;
+	}
+}
@@ -0,0 +1,478 @@
+#pragma once
+
+#include "svgshapes.h"
+#include "svgdisplaylist.h"
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//
+// SVGDocumentCache
+// When the same documents get rendered over and over, there's
+// no need to parse them every time.  Documents are looked up by
+// a hash of their content, and the parsed, compiled, form is handed
+// back, shared by whoever asks for it.
+//
+// A cached document is immutable.  It has already been prepared, and
+// compiled into a display list, so any number of threads can draw the
+// same one at the same time, each with its own context.
+//
+// The cache holds onto documents up to a configured number of bytes,
+// and lets go of the least recently used ones to stay under that.
+//
+// SVGRasterCache
+// The level after that, for when the same document is rendered
+// at the same size, over and over (thumbnails).  The rendered images
+// are kept, keyed by the document, and how it was rendered, with
+// the same kind of byte budget, and least recently used eviction.
+//
+namespace svg2b2d {
+
+	// A parsed, prepared, and compiled document
+	// It keeps its own copy of the source, so the caller's
+	// data does not need to stay around.
+	struct SVGCachedDocument
+	{
+		uint64_t fHash{ 0 };
+		std::vector<uint8_t> fSource{};		// the document's spans point in here, so it comes first
+		SVGDocument fDocument;
+		SVGDisplayList fDisplayList{};
+		size_t fBytes{ 0 };					// roughly, how much memory this is holding onto
+
+		SVGCachedDocument(const SVGLoadOptions& options)
+			: fDocument(options)
+		{}
+
+		SVGCachedDocument(const SVGCachedDocument&) = delete;
+		SVGCachedDocument& operator=(const SVGCachedDocument&) = delete;
+
+		double width() const { return fDocument.width(); }
+		double height() const { return fDocument.height(); }
+
+		bool sameSource(const ByteSpan& inChunk) const
+		{
+			return (fSource.size() == inChunk.size()) &&
+				((inChunk.size() == 0) || (memcmp(fSource.data(), inChunk.fStart, inChunk.size()) == 0));
+		}
+
+		// Draw the compiled form, which doesn't change
+		// anything in the document, so it's safe from any thread
+		void draw(IRender& ctx)
+		{
+			fDisplayList.draw(ctx);
+		}
+
+		// Parse a copy of the data
+		// Returns nullptr if the data does not contain a document
+		static std::shared_ptr<SVGCachedDocument> createFromData(const ByteSpan& inChunk, const SVGLoadOptions& options = SVGLoadOptions{})
+		{
+			auto entry = std::make_shared<SVGCachedDocument>(options);
+			entry->fHash = svg_hash64(inChunk);
+			entry->fSource.assign(inChunk.fStart, inChunk.fEnd);
+
+			entry->fDocument.readFromData(ByteSpan(entry->fSource.data(), entry->fSource.size()));
+			if (entry->fDocument.fRootNode == nullptr)
+				return nullptr;
+
+			// After this, nothing in the document changes when it's drawn
+			entry->fDocument.prepare();
+			entry->fDocument.shrink();
+			entry->fDocument.compile(entry->fDisplayList);
+
+			entry->fBytes = entry->estimateBytes();
+
+			return entry;
+		}
+
+	private:
+		// The source, the document, and the compiled states, and
+		// commands.  The paths, and images, of the display list share
+		// their data with the nodes of the document, so only what
+		// isn't shared is added to what the document holds.
+		size_t estimateBytes() const
+		{
+			SVGMemoryUsage usage = fDocument.memoryUsage();
+			size_t bytes = sizeof(*this) + fSource.capacity();
+
+			bytes += fDisplayList.fStates.capacity() * sizeof(SVGDrawState);
+			bytes += fDisplayList.fCommands.capacity() * sizeof(SVGDrawCommand);
+			bytes += fDisplayList.fPaths.capacity() * sizeof(BLPath);
+			bytes += fDisplayList.fImages.capacity() * sizeof(SVGDrawImage);
+
+			for (const auto& path : fDisplayList.fPaths)
+				usage.addPath(path);
+			for (const auto& img : fDisplayList.fImages)
+				usage.addImage(img.fImage);
+
+			return bytes + usage.total();
+		}
+	};
+
+	struct SVGDocumentCache
+	{
+		using Entry = std::shared_ptr<SVGCachedDocument>;
+
+		SVGDocumentCache(size_t maxBytes = 64 * 1024 * 1024, const SVGLoadOptions& options = SVGLoadOptions{})
+			: fMaxBytes(maxBytes)
+			, fOptions(options)
+		{}
+
+		SVGDocumentCache(const SVGDocumentCache&) = delete;
+		SVGDocumentCache& operator=(const SVGDocumentCache&) = delete;
+
+		// Return the parsed form of the data, parsing it only
+		// if it's not already in the cache.
+		// Returns nullptr if the data does not contain a document
+		Entry get(const ByteSpan& inChunk)
+		{
+			uint64_t hash = svg_hash64(inChunk);
+
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+				Entry found = lookup(hash, inChunk);
+				if (found != nullptr)
+				{
+					fHits++;
+					return found;
+				}
+				fMisses++;
+			}
+
+			// Parse outside the lock, so other lookups don't wait on it
+			Entry entry = SVGCachedDocument::createFromData(inChunk, fOptions);
+			if (entry == nullptr)
+				return nullptr;
+
+			std::lock_guard<std::mutex> lock(fMutex);
+
+			// Someone else might have parsed the same thing in the meantime
+			Entry found = lookup(hash, inChunk);
+			if (found != nullptr)
+				return found;
+
+			insert(entry);
+
+			return entry;
+		}
+
+		Entry get(const void* bytes, const size_t sz)
+		{
+			return get(ByteSpan(bytes, sz));
+		}
+
+		// Only look, don't parse
+		Entry find(const ByteSpan& inChunk)
+		{
+			uint64_t hash = svg_hash64(inChunk);
+
+			std::lock_guard<std::mutex> lock(fMutex);
+			return lookup(hash, inChunk);
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fEntries.clear();
+			fIndex.clear();
+			fBytes = 0;
+		}
+
+		// Changing the limit evicts right away, if needed
+		void setMaxBytes(size_t maxBytes)
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fMaxBytes = maxBytes;
+			evict();
+		}
+
+		size_t maxBytes() const { return fMaxBytes; }
+		size_t bytes() { std::lock_guard<std::mutex> lock(fMutex); return fBytes; }
+		size_t size() { std::lock_guard<std::mutex> lock(fMutex); return fEntries.size(); }
+		size_t hits() { std::lock_guard<std::mutex> lock(fMutex); return fHits; }
+		size_t misses() { std::lock_guard<std::mutex> lock(fMutex); return fMisses; }
+
+	private:
+		// Most recently used at the front
+		std::list<Entry> fEntries{};
+		std::unordered_map<uint64_t, std::list<Entry>::iterator> fIndex{};
+		std::mutex fMutex{};
+
+		size_t fMaxBytes{ 0 };
+		size_t fBytes{ 0 };
+		size_t fHits{ 0 };
+		size_t fMisses{ 0 };
+		SVGLoadOptions fOptions{};
+
+		// Must be called with the lock held
+		// A hash that matches, with different content, is treated as a miss
+		Entry lookup(uint64_t hash, const ByteSpan& inChunk)
+		{
+			auto it = fIndex.find(hash);
+			if (it == fIndex.end())
+				return nullptr;
+
+			if (!(*it->second)->sameSource(inChunk))
+				return nullptr;
+
+			// Move it to the front
+			fEntries.splice(fEntries.begin(), fEntries, it->second);
+
+			return *it->second;
+		}
+
+		// Must be called with the lock held
+		void insert(const Entry& entry)
+		{
+			// Documents bigger than the whole cache are
+			// handed out, but not kept
+			if (entry->fBytes > fMaxBytes)
+				return;
+
+			// Replace whatever had the same hash
+			auto it = fIndex.find(entry->fHash);
+			if (it != fIndex.end())
+			{
+				fBytes -= (*it->second)->fBytes;
+				fEntries.erase(it->second);
+				fIndex.erase(it);
+			}
+
+			fEntries.push_front(entry);
+			fIndex[entry->fHash] = fEntries.begin();
+			fBytes += entry->fBytes;
+
+			evict();
+		}
+
+		// Must be called with the lock held
+		// Drop the least recently used, until it's all under the limit.
+		// Anyone still holding one of these keeps it alive.
+		void evict()
+		{
+			while (fBytes > fMaxBytes && !fEntries.empty())
+			{
+				Entry& last = fEntries.back();
+				fBytes -= last->fBytes;
+				fIndex.erase(last->fHash);
+				fEntries.pop_back();
+			}
+		}
+	};
+
+	// How a document is to be rendered
+	// A width, or height, of 0 means the document's size, times the scale
+	struct SVGRasterParams
+	{
+		int fWidth{ 0 };
+		int fHeight{ 0 };
+		double fScale{ 1.0 };				// output pixels per document unit
+		uint32_t fBackground{ 0 };			// 0xAARRGGBB, 0 leaves it transparent
+		uint32_t fThreadCount{ 0 };			// not part of the key, only how it's rendered
+
+		bool operator==(const SVGRasterParams& other) const
+		{
+			return fWidth == other.fWidth && fHeight == other.fHeight &&
+				fScale == other.fScale && fBackground == other.fBackground;
+		}
+	};
+
+	struct SVGRasterCache
+	{
+		using Image = std::shared_ptr<const BLImage>;
+
+		SVGRasterCache(size_t maxBytes = 64 * 1024 * 1024)
+			: fMaxBytes(maxBytes)
+		{}
+
+		SVGRasterCache(const SVGRasterCache&) = delete;
+		SVGRasterCache& operator=(const SVGRasterCache&) = delete;
+
+		// Return the rendered image, rendering it only if 
+		// it's not already in the cache.
+		// The image is shared, and must not be drawn into.
+		// Returns nullptr if it could not be rendered
+		Image get(const SVGDocumentCache::Entry& doc, const SVGRasterParams& params = SVGRasterParams{})
+		{
+			if (doc == nullptr || params.fScale <= 0)
+				return nullptr;
+
+			Key key{ doc->fHash, params };
+
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+				Image found = lookup(key);
+				if (found != nullptr)
+				{
+					fHits++;
+					return found;
+				}
+				fMisses++;
+			}
+
+			// Render outside the lock
+			Image img = renderImage(*doc, params);
+			if (img == nullptr)
+				return nullptr;
+
+			std::lock_guard<std::mutex> lock(fMutex);
+			Image found = lookup(key);
+			if (found != nullptr)
+				return found;
+
+			insert(key, img);
+
+			return img;
+		}
+
+		// Same as get(), into an image of the caller's
+		// With 'shared', outImage refers to the cached pixels, and
+		// the first write to it makes a copy.  Otherwise the pixels 
+		// are copied right away.
+		bool render(const SVGDocumentCache::Entry& doc, BLImage& outImage, const SVGRasterParams& params = SVGRasterParams{}, bool shared = true)
+		{
+			Image img = get(doc, params);
+			if (img == nullptr)
+				return false;
+
+			if (shared)
+				return outImage.assign(*img) == BL_SUCCESS;
+
+			return outImage.assignDeep(*img) == BL_SUCCESS;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fEntries.clear();
+			fIndex.clear();
+			fBytes = 0;
+		}
+
+		void setMaxBytes(size_t maxBytes)
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fMaxBytes = maxBytes;
+			evict();
+		}
+
+		size_t maxBytes() const { return fMaxBytes; }
+		size_t bytes() { std::lock_guard<std::mutex> lock(fMutex); return fBytes; }
+		size_t size() { std::lock_guard<std::mutex> lock(fMutex); return fEntries.size(); }
+		size_t hits() { std::lock_guard<std::mutex> lock(fMutex); return fHits; }
+		size_t misses() { std::lock_guard<std::mutex> lock(fMutex); return fMisses; }
+
+	private:
+		struct Key
+		{
+			uint64_t fHash{ 0 };
+			SVGRasterParams fParams{};
+
+			bool operator==(const Key& other) const { return fHash == other.fHash && fParams == other.fParams; }
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const Key& k) const noexcept
+			{
+				uint64_t h = k.fHash;
+				h = (h ^ (uint64_t)(uint32_t)k.fParams.fWidth) * 1099511628211ULL;
+				h = (h ^ (uint64_t)(uint32_t)k.fParams.fHeight) * 1099511628211ULL;
+				h = (h ^ std::hash<double>{}(k.fParams.fScale)) * 1099511628211ULL;
+				h = (h ^ (uint64_t)k.fParams.fBackground) * 1099511628211ULL;
+				return (size_t)h;
+			}
+		};
+
+		struct Item
+		{
+			Key fKey{};
+			Image fImage{};
+			size_t fBytes{ 0 };
+		};
+
+		// Most recently used at the front
+		std::list<Item> fEntries{};
+		std::unordered_map<Key, std::list<Item>::iterator, KeyHash> fIndex{};
+		std::mutex fMutex{};
+
+		size_t fMaxBytes{ 0 };
+		size_t fBytes{ 0 };
+		size_t fHits{ 0 };
+		size_t fMisses{ 0 };
+
+		static Image renderImage(SVGCachedDocument& doc, const SVGRasterParams& params)
+		{
+			int width = params.fWidth > 0 ? params.fWidth : (int)(doc.width() * params.fScale);
+			int height = params.fHeight > 0 ? params.fHeight : (int)(doc.height() * params.fScale);
+			if (width <= 0 || height <= 0)
+				return nullptr;
+
+			auto img = std::make_shared<BLImage>();
+			if (img->create(width, height, BL_FORMAT_PRGB32) != BL_SUCCESS)
+				return nullptr;
+
+			BLContextCreateInfo createInfo{};
+			createInfo.threadCount = params.fThreadCount;
+
+			SVGRenderer ctx(*img, createInfo);
+			if (params.fBackground != 0)
+			{
+				ctx.setFillStyle(BLRgba32(params.fBackground));
+				ctx.fillAll();
+			}
+			else
+				ctx.clearAll();
+
+			ctx.scale(params.fScale);
+			doc.draw(ctx);
+
+			ctx.flush(BL_CONTEXT_FLUSH_SYNC);
+			ctx.end();
+
+			return img;
+		}
+
+		// Must be called with the lock held
+		Image lookup(const Key& key)
+		{
+			auto it = fIndex.find(key);
+			if (it == fIndex.end())
+				return nullptr;
+
+			fEntries.splice(fEntries.begin(), fEntries, it->second);
+
+			return it->second->fImage;
+		}
+
+		// Must be called with the lock held
+		void insert(const Key& key, const Image& img)
+		{
+			size_t bytes = sizeof(Item) + sizeof(BLImage) + (size_t)img->width() * img->height() * 4;
+			if (bytes > fMaxBytes)
+				return;
+
+			fEntries.push_front(Item{ key, img, bytes });
+			fIndex[key] = fEntries.begin();
+			fBytes += bytes;
+
+			evict();
+		}
+
+		// Must be called with the lock held
+		void evict()
+		{
+			while (fBytes > fMaxBytes && !fEntries.empty())
+			{
+				Item& last = fEntries.back();
+				fBytes -= last.fBytes;
+				fIndex.erase(last.fKey);
+				fEntries.pop_back();
+			}
+		}
+	};
+}
@@ -1,161 +1,254 @@
 #pragma once
 
-
-
 #include "blend2d.h"
+#include "bspan.h"
 
-#include <map>
-#include <string>
+#include <array>
+#include <cstdint>
+#include <string_view>
 
-namespace svg
+//
+// Named colors
+// The 147 SVG color keywords, and 'transparent'
+// https://www.w3.org/TR/SVG11/types.html#ColorKeywords
+//
+// Like the interned names, the lookup table is an open addressing
+// hash table built entirely at compile time, so there's no static
+// initialization, and looking up a name, straight out of a ByteSpan,
+// costs one hash, and typically one compare.  Names are matched 
+// without regard to case, as CSS does.
+//
+namespace svg2b2d
 {
-    // Database of SVG colors
-    // BUGBUG - it might be better if these used float instead of byte values
-    // Then they can be converted to various forms as needed
-    // https://www.w3.org/TR/SVG11/types.html#ColorKeywords
-    //
-    std::map<std::string, BLRgba32> colors =
+    struct SVGNamedColor
+    {
+        std::string_view fName;
+        BLRgba32 fColor;
+    };
+
+    static constexpr SVGNamedColor gSVGNamedColors[] =
     {
-        {"white",  BLRgba32(255, 255, 255)},
-        {"ivory", BLRgba32(255, 255, 240)},
-        {"lightyellow", BLRgba32(255, 255, 224)},
-        {"mintcream", BLRgba32(245, 255, 250)},
-        {"azure", BLRgba32(240, 255, 255)},
-        {"snow", BLRgba32(255, 250, 250)},
-        {"honeydew", BLRgba32(240, 255, 240)},
-        {"floralwhite", BLRgba32(255, 250, 240)},
-        {"ghostwhite", BLRgba32(248, 248, 255)},
-        {"lightcyan", BLRgba32(224, 255, 255)},
-        {"lemonchiffon", BLRgba32(255, 250, 205)},
-        {"cornsilk", BLRgba32(255, 248, 220)},
-        {"lightgoldenrodyellow", BLRgba32(250, 250, 210)},
-        {"aliceblue", BLRgba32(240, 248, 255)},
-        {"seashell", BLRgba32(255, 245, 238)},
-        {"oldlace", BLRgba32(253, 245, 230)},
-        {"whitesmoke", BLRgba32(245, 245, 245)},
-        {"lavenderblush", BLRgba32(255, 240, 245)},
-        {"beige", BLRgba32(245, 245, 220)},
-        {"linen", BLRgba32(250, 240, 230)},
-        {"papayawhip", BLRgba32(255, 239, 213)},
-        {"blanchedalmond", BLRgba32(255, 235, 205)},
-        {"antiquewhite", BLRgba32(250, 235, 215)},
-        {"yellow", BLRgba32(255, 255, 0)},
-        {"mistyrose", BLRgba32(255, 228, 225)},
-        {"lavender", BLRgba32(230, 230, 250)},
-        {"bisque", BLRgba32(255, 228, 196)},
-        {"moccasin", BLRgba32(255, 228, 181)},
-        {"palegoldenrod", BLRgba32(238, 232, 170)},
-        {"khaki", BLRgba32(240, 230, 140)},
-        {"navajowhite", BLRgba32(255, 222, 173)},
-        {"aquamarine", BLRgba32(127, 255, 212)},
-        {"paleturquoise", BLRgba32(175, 238, 238)},
-        {"wheat", BLRgba32(245, 222, 179)},
-        {"peachpuff", BLRgba32(255, 218, 185)},
-        {"palegreen", BLRgba32(152, 251, 152)},
-        {"greenyellow", BLRgba32(173, 255, 47)},
-        {"gainsboro", BLRgba32(220, 220, 220)},
-        {"powderblue", BLRgba32(176, 224, 230)},
-        {"lightgreen", BLRgba32(144, 238, 144)},
-        {"lightgray", BLRgba32(211, 211, 211)},
-        {"chartreuse", BLRgba32(127, 255, 0)},
-        {"gold", BLRgba32(255, 215, 0)},
-        {"lightblue", BLRgba32(173, 216, 230)},
-        {"lawngreen", BLRgba32(124, 252, 0)},
-        {"pink", BLRgba32(255, 192, 203)},
-        {"aqua", BLRgba32(0, 255, 255)},
-        {"cyan", BLRgba32(0, 255, 255)},
-        {"lightpink", BLRgba32(255, 182, 193)},
-        {"thistle", BLRgba32(216, 191, 216)},
-        {"lightskyblue", BLRgba32(135, 206, 250)},
-        {"lightsteelblue", BLRgba32(176, 196, 222)},
-        {"skyblue", BLRgba32(135, 206, 235)},
-        {"silver", BLRgba32(192, 192, 192)},
-        {"springgreen", BLRgba32(0, 255, 127)},
-        {"mediumspringgreen", BLRgba32(0, 250, 154)},
-        {"turquoise", BLRgba32(64, 224, 208)},
-        {"burlywood", BLRgba32(222, 184, 135)},
-        {"tan", BLRgba32(210, 180, 140)},
-        {"yellowgreen", BLRgba32(154, 205, 50)},
-        {"lime", BLRgba32(0, 255, 0)},
-        {"mediumaquamarine", BLRgba32(102, 205, 170)},
-        {"mediumturquoise", BLRgba32(72, 209, 204)},
-        {"darkkhaki", BLRgba32(189, 183, 107)},
-        {"lightsalmon", BLRgba32(255, 160, 122)},
-        {"plum", BLRgba32(221, 160, 221)},
-        {"sandybrown", BLRgba32(244, 164, 96)},
-        {"darkseagreen", BLRgba32(143, 188, 143)},
-        {"orange", BLRgba32(255, 165, 0)},
-        {"darkgray", BLRgba32(169, 169, 169)},
-        {"goldenrod", BLRgba32(218, 165, 32)},
-        {"darksalmon", BLRgba32(233, 150, 122)},
-        {"darkturquoise", BLRgba32(0, 206, 209)},
-        {"limegreen", BLRgba32(50, 205, 50)},
-        {"violet", BLRgba32(238, 130, 238)},
-        {"deepskyblue", BLRgba32(0, 191, 255)},
-        {"darkorange", BLRgba32(255, 140, 0)},
-        {"salmon", BLRgba32(250, 128, 114)},
-        {"rosybrown", BLRgba32(188, 143, 143)},
-        {"lightcoral", BLRgba32(240, 128, 128)},
-        {"coral", BLRgba32(255, 127, 80)},
-        {"mediumseagreen", BLRgba32(60, 179, 113)},
-        {"lightseagreen", BLRgba32(32, 178, 170)},
-        {"cornflowerblue", BLRgba32(100, 149, 237)},
-        {"cadetblue", BLRgba32(95, 158, 160)},
-        {"peru", BLRgba32(205, 133, 63)},
-        {"hotpink", BLRgba32(255, 105, 180)},
-        {"orchid", BLRgba32(218, 112, 214)},
-        {"palevioletred", BLRgba32(219, 112, 147)},
-        {"darkgoldenrod", BLRgba32(184, 134, 11)},
-        {"lightslategray", BLRgba32(119, 136, 153)},
-        {"tomato", BLRgba32(255, 99, 71)},
-        {"gray", BLRgba32(128, 128, 128)},
-        {"dodgerblue", BLRgba32(30, 144, 255)},
-        {"mediumpurple", BLRgba32(147, 112, 219)},
-        {"olivedrab", BLRgba32(107, 142, 35)},
-        {"slategray", BLRgba32(112, 128, 144)},
-        {"chocolate", BLRgba32(210, 105, 30)},
-        {"steelblue", BLRgba32(70, 130, 180)},
-        {"olive", BLRgba32(128, 128, 0)},
-        {"mediumslateblue", BLRgba32(123, 104, 238)},
-        {"indianred", BLRgba32(205, 92, 92)},
-        {"mediumorchid", BLRgba32(186, 85, 211)},
-        {"seagreen", BLRgba32(46, 139, 87)},
-        {"darkcyan", BLRgba32(0, 139, 139)},
-        {"forestgreen", BLRgba32(34, 139, 34)},
-        {"royalblue", BLRgba32(65, 105, 225)},
-        {"dimgray", BLRgba32(105, 105, 105)},
-        {"orangered", BLRgba32(255, 69, 0)},
-        {"slateblue", BLRgba32(106, 90, 205)},
-        {"teal", BLRgba32(0, 128, 128)},
-        {"darkolivegreen", BLRgba32(85, 107, 47)},
-        {"sienna", BLRgba32(160, 82, 45)},
-        {"green", BLRgba32(0, 128, 0)},
-        {"darkorchid", BLRgba32(153, 50, 204)},
-        {"saddlebrown", BLRgba32(139, 69, 19)},
-        {"deeppink", BLRgba32(255, 20, 147)},
-        {"blueviolet", BLRgba32(138, 43, 226)},
-        {"magenta", BLRgba32(255, 0, 255)},
-        {"fuchsia", BLRgba32(255, 0, 255)},
-        {"darkslategray", BLRgba32(47, 79, 79)},
-        {"darkgreen", BLRgba32(0, 100, 0)},
-        {"darkslateblue", BLRgba32(72, 61, 139)},
-        {"brown", BLRgba32(165, 42, 42)},
-        {"mediumvioletred", BLRgba32(199, 21, 133)},
-        {"crimson", BLRgba32(220, 20, 60)},
-        {"firebrick", BLRgba32(178, 34, 34)},
-        {"red", BLRgba32(255, 0, 0)},
-        {"darkviolet", BLRgba32(148, 0, 211)},
-        {"darkmagenta", BLRgba32(139, 0, 139)},
-        {"purple", BLRgba32(128, 0, 128)},
-        {"midnightblue", BLRgba32(25, 25, 112)},
-        {"darkred", BLRgba32(139, 0, 0)},
-        {"maroon", BLRgba32(128, 0, 0)},
-        {"indigo", BLRgba32(75, 0, 130)},
-        {"blue", BLRgba32(0, 0, 255)},
-        {"mediumblue", BLRgba32(0, 0, 205)},
-        {"darkblue", BLRgba32(0, 0, 139)},
-        {"navy", BLRgba32(0, 0, 128)},
-        {"black", BLRgba32(0, 0, 0)},
+        { "aliceblue", BLRgba32(240, 248, 255) },
+        { "antiquewhite", BLRgba32(250, 235, 215) },
+        { "aqua", BLRgba32(0, 255, 255) },
+        { "aquamarine", BLRgba32(127, 255, 212) },
+        { "azure", BLRgba32(240, 255, 255) },
+        { "beige", BLRgba32(245, 245, 220) },
+        { "bisque", BLRgba32(255, 228, 196) },
+        { "black", BLRgba32(0, 0, 0) },
+        { "blanchedalmond", BLRgba32(255, 235, 205) },
+        { "blue", BLRgba32(0, 0, 255) },
+        { "blueviolet", BLRgba32(138, 43, 226) },
+        { "brown", BLRgba32(165, 42, 42) },
+        { "burlywood", BLRgba32(222, 184, 135) },
+        { "cadetblue", BLRgba32(95, 158, 160) },
+        { "chartreuse", BLRgba32(127, 255, 0) },
+        { "chocolate", BLRgba32(210, 105, 30) },
+        { "coral", BLRgba32(255, 127, 80) },
+        { "cornflowerblue", BLRgba32(100, 149, 237) },
+        { "cornsilk", BLRgba32(255, 248, 220) },
+        { "crimson", BLRgba32(220, 20, 60) },
+        { "cyan", BLRgba32(0, 255, 255) },
+        { "darkblue", BLRgba32(0, 0, 139) },
+        { "darkcyan", BLRgba32(0, 139, 139) },
+        { "darkgoldenrod", BLRgba32(184, 134, 11) },
+        { "darkgray", BLRgba32(169, 169, 169) },
+        { "darkgreen", BLRgba32(0, 100, 0) },
+        { "darkgrey", BLRgba32(169, 169, 169) },
+        { "darkkhaki", BLRgba32(189, 183, 107) },
+        { "darkmagenta", BLRgba32(139, 0, 139) },
+        { "darkolivegreen", BLRgba32(85, 107, 47) },
+        { "darkorange", BLRgba32(255, 140, 0) },
+        { "darkorchid", BLRgba32(153, 50, 204) },
+        { "darkred", BLRgba32(139, 0, 0) },
+        { "darksalmon", BLRgba32(233, 150, 122) },
+        { "darkseagreen", BLRgba32(143, 188, 143) },
+        { "darkslateblue", BLRgba32(72, 61, 139) },
+        { "darkslategray", BLRgba32(47, 79, 79) },
+        { "darkslategrey", BLRgba32(47, 79, 79) },
+        { "darkturquoise", BLRgba32(0, 206, 209) },
+        { "darkviolet", BLRgba32(148, 0, 211) },
+        { "deeppink", BLRgba32(255, 20, 147) },
+        { "deepskyblue", BLRgba32(0, 191, 255) },
+        { "dimgray", BLRgba32(105, 105, 105) },
+        { "dimgrey", BLRgba32(105, 105, 105) },
+        { "dodgerblue", BLRgba32(30, 144, 255) },
+        { "firebrick", BLRgba32(178, 34, 34) },
+        { "floralwhite", BLRgba32(255, 250, 240) },
+        { "forestgreen", BLRgba32(34, 139, 34) },
+        { "fuchsia", BLRgba32(255, 0, 255) },
+        { "gainsboro", BLRgba32(220, 220, 220) },
+        { "ghostwhite", BLRgba32(248, 248, 255) },
+        { "gold", BLRgba32(255, 215, 0) },
+        { "goldenrod", BLRgba32(218, 165, 32) },
+        { "gray", BLRgba32(128, 128, 128) },
+        { "green", BLRgba32(0, 128, 0) },
+        { "greenyellow", BLRgba32(173, 255, 47) },
+        { "grey", BLRgba32(128, 128, 128) },
+        { "honeydew", BLRgba32(240, 255, 240) },
+        { "hotpink", BLRgba32(255, 105, 180) },
+        { "indianred", BLRgba32(205, 92, 92) },
+        { "indigo", BLRgba32(75, 0, 130) },
+        { "ivory", BLRgba32(255, 255, 240) },
+        { "khaki", BLRgba32(240, 230, 140) },
+        { "lavender", BLRgba32(230, 230, 250) },
+        { "lavenderblush", BLRgba32(255, 240, 245) },
+        { "lawngreen", BLRgba32(124, 252, 0) },
+        { "lemonchiffon", BLRgba32(255, 250, 205) },
+        { "lightblue", BLRgba32(173, 216, 230) },
+        { "lightcoral", BLRgba32(240, 128, 128) },
+        { "lightcyan", BLRgba32(224, 255, 255) },
+        { "lightgoldenrodyellow", BLRgba32(250, 250, 210) },
+        { "lightgray", BLRgba32(211, 211, 211) },
+        { "lightgreen", BLRgba32(144, 238, 144) },
+        { "lightgrey", BLRgba32(211, 211, 211) },
+        { "lightpink", BLRgba32(255, 182, 193) },
+        { "lightsalmon", BLRgba32(255, 160, 122) },
+        { "lightseagreen", BLRgba32(32, 178, 170) },
+        { "lightskyblue", BLRgba32(135, 206, 250) },
+        { "lightslategray", BLRgba32(119, 136, 153) },
+        { "lightslategrey", BLRgba32(119, 136, 153) },
+        { "lightsteelblue", BLRgba32(176, 196, 222) },
+        { "lightyellow", BLRgba32(255, 255, 224) },
+        { "lime", BLRgba32(0, 255, 0) },
+        { "limegreen", BLRgba32(50, 205, 50) },
+        { "linen", BLRgba32(250, 240, 230) },
+        { "magenta", BLRgba32(255, 0, 255) },
+        { "maroon", BLRgba32(128, 0, 0) },
+        { "mediumaquamarine", BLRgba32(102, 205, 170) },
+        { "mediumblue", BLRgba32(0, 0, 205) },
+        { "mediumorchid", BLRgba32(186, 85, 211) },
+        { "mediumpurple", BLRgba32(147, 112, 219) },
+        { "mediumseagreen", BLRgba32(60, 179, 113) },
+        { "mediumslateblue", BLRgba32(123, 104, 238) },
+        { "mediumspringgreen", BLRgba32(0, 250, 154) },
+        { "mediumturquoise", BLRgba32(72, 209, 204) },
+        { "mediumvioletred", BLRgba32(199, 21, 133) },
+        { "midnightblue", BLRgba32(25, 25, 112) },
+        { "mintcream", BLRgba32(245, 255, 250) },
+        { "mistyrose", BLRgba32(255, 228, 225) },
+        { "moccasin", BLRgba32(255, 228, 181) },
+        { "navajowhite", BLRgba32(255, 222, 173) },
+        { "navy", BLRgba32(0, 0, 128) },
+        { "oldlace", BLRgba32(253, 245, 230) },
+        { "olive", BLRgba32(128, 128, 0) },
+        { "olivedrab", BLRgba32(107, 142, 35) },
+        { "orange", BLRgba32(255, 165, 0) },
+        { "orangered", BLRgba32(255, 69, 0) },
+        { "orchid", BLRgba32(218, 112, 214) },
+        { "palegoldenrod", BLRgba32(238, 232, 170) },
+        { "palegreen", BLRgba32(152, 251, 152) },
+        { "paleturquoise", BLRgba32(175, 238, 238) },
+        { "palevioletred", BLRgba32(219, 112, 147) },
+        { "papayawhip", BLRgba32(255, 239, 213) },
+        { "peachpuff", BLRgba32(255, 218, 185) },
+        { "peru", BLRgba32(205, 133, 63) },
+        { "pink", BLRgba32(255, 192, 203) },
+        { "plum", BLRgba32(221, 160, 221) },
+        { "powderblue", BLRgba32(176, 224, 230) },
+        { "purple", BLRgba32(128, 0, 128) },
+        { "red", BLRgba32(255, 0, 0) },
+        { "rosybrown", BLRgba32(188, 143, 143) },
+        { "royalblue", BLRgba32(65, 105, 225) },
+        { "saddlebrown", BLRgba32(139, 69, 19) },
+        { "salmon", BLRgba32(250, 128, 114) },
+        { "sandybrown", BLRgba32(244, 164, 96) },
+        { "seagreen", BLRgba32(46, 139, 87) },
+        { "seashell", BLRgba32(255, 245, 238) },
+        { "sienna", BLRgba32(160, 82, 45) },
+        { "silver", BLRgba32(192, 192, 192) },
+        { "skyblue", BLRgba32(135, 206, 235) },
+        { "slateblue", BLRgba32(106, 90, 205) },
+        { "slategray", BLRgba32(112, 128, 144) },
+        { "slategrey", BLRgba32(112, 128, 144) },
+        { "snow", BLRgba32(255, 250, 250) },
+        { "springgreen", BLRgba32(0, 255, 127) },
+        { "steelblue", BLRgba32(70, 130, 180) },
+        { "tan", BLRgba32(210, 180, 140) },
+        { "teal", BLRgba32(0, 128, 128) },
+        { "thistle", BLRgba32(216, 191, 216) },
+        { "tomato", BLRgba32(255, 99, 71) },
+        { "turquoise", BLRgba32(64, 224, 208) },
+        { "violet", BLRgba32(238, 130, 238) },
+        { "wheat", BLRgba32(245, 222, 179) },
+        { "white", BLRgba32(255, 255, 255) },
+        { "whitesmoke", BLRgba32(245, 245, 245) },
+        { "yellow", BLRgba32(255, 255, 0) },
+        { "yellowgreen", BLRgba32(154, 205, 50) },
+        { "transparent", BLRgba32(0, 0, 0, 0) },
     };
 
+    static constexpr size_t kSVGNamedColorCount = sizeof(gSVGNamedColors) / sizeof(gSVGNamedColors[0]);
+    static constexpr size_t kSVGColorTableSize = 512;     // must be a power of 2
+    static_assert(kSVGNamedColorCount * 2 <= kSVGColorTableSize, "SVG color table is too full, make it bigger");
+
+    static constexpr uint8_t svg_color_lower(uint8_t c) noexcept
+    {
+        return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + ('a' - 'A')) : c;
+    }
+
+    // FNV-1a, same as the names, of the lower case form
+    template <typename CharT>
+    static constexpr uint32_t svg_color_hash(const CharT* s, size_t len) noexcept
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++)
+        {
+            h ^= svg_color_lower((uint8_t)s[i]);
+            h *= 16777619u;
+        }
+
+        return h;
+    }
+
+    // Each slot holds 1 + the index of a color, 0 marks an empty slot
+    static constexpr std::array<uint8_t, kSVGColorTableSize> buildSVGColorTable() noexcept
+    {
+        std::array<uint8_t, kSVGColorTableSize> table{};
+
+        for (size_t i = 0; i < kSVGNamedColorCount; i++)
+        {
+            auto& name = gSVGNamedColors[i].fName;
+            size_t slot = svg_color_hash(name.data(), name.size()) & (kSVGColorTableSize - 1);
+            while (table[slot] != 0)
+                slot = (slot + 1) & (kSVGColorTableSize - 1);
+
+            table[slot] = (uint8_t)(i + 1);
+        }
+
+        return table;
+    }
+
+    static constexpr std::array<uint8_t, kSVGColorTableSize> gSVGColorTable = buildSVGColorTable();
+
+    // Look up a color keyword
+    // Returns false if it isn't one
+    static inline bool svgNamedColor(const ByteSpan& name, BLRgba32& outColor) noexcept
+    {
+        size_t len = name.size();
+        if (len == 0)
+            return false;
+
+        size_t slot = svg_color_hash(name.fStart, len) & (kSVGColorTableSize - 1);
+        while (gSVGColorTable[slot] != 0)
+        {
+            const SVGNamedColor& candidate = gSVGNamedColors[gSVGColorTable[slot] - 1];
+            if (candidate.fName.size() == len)
+            {
+                size_t i = 0;
+                while (i < len && (uint8_t)candidate.fName[i] == svg_color_lower(name.fStart[i]))
+                    i++;
+
+                if (i == len)
+                {
+                    outColor = candidate.fColor;
+                    return true;
+                }
+            }
+
+            slot = (slot + 1) & (kSVGColorTableSize - 1);
+        }
+
+        return false;
+    }
 }
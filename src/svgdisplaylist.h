@@ -0,0 +1,363 @@
+#pragma once
+
+#include "blend2d.h"
+#include "irender.h"
+
+#include <vector>
+#include <cstdint>
+
+//
+// SVGDisplayList
+// A flattened, retained form of a document.  The node tree is walked
+// once (compile), with all the transforms, paints, and stroke parameters
+// resolved along the way.  What comes out is a linear list of draw commands,
+// each referring to the complete drawing state it needs, and the geometry
+// it draws.  Replaying the list is a tight loop against the context, with
+// no virtual calls, no save()/restore() per node, and state only being
+// set when it actually changes from one command to the next.
+//
+// The list is meant to be drawn many times, at whatever transform is
+// on the context when draw() is called.
+//
+// Transforms are folded together while compiling, so a chain of nested
+// groups ends up as a single matrix per state, and each state is tagged
+// with what kind of matrix it is.  Plain translations, which is what
+// most transform attributes are, are applied as a translate, rather
+// than a full matrix multiply.
+//
+namespace svg2b2d {
+
+	// The complete drawing state in effect for a draw command
+	// This is the state a node would see after all of its
+	// ancestors, and itself, have applied their styles.
+	struct SVGDrawState
+	{
+		BLMatrix2D fTransform{ BLMatrix2D::makeIdentity() };
+		double fFillAlpha{ 1.0 };
+		BLVar fFill{};
+		BLVar fStroke{};
+		BLFillRule fFillRule{ BL_FILL_RULE_NON_ZERO };
+		double fStrokeWidth{ 1.0 };
+		BLStrokeJoin fStrokeJoin{ BL_STROKE_JOIN_MITER_CLIP };
+		BLStrokeCap fStrokeCap{ BL_STROKE_CAP_BUTT };
+		double fStrokeMiterLimit{ 4.0 };
+
+		// Whether anything can be seen of the fill, and stroke,
+		// and what kind of matrix the transform is (BLMatrix2DType).
+		// These follow from the rest, so they aren't compared.
+		bool fFillVisible{ true };
+		bool fStrokeVisible{ true };
+		uint8_t fTransformType{ BL_MATRIX2D_TYPE_IDENTITY };
+
+		// Start with the same paints a fresh context has
+		SVGDrawState()
+		{
+			blVarAssignRgba32(&fFill, BLRgba32(0, 0, 0).value);
+			blVarAssignRgba32(&fStroke, BLRgba32(0, 0, 0).value);
+		}
+		SVGDrawState(const SVGDrawState& other) { *this = other; }
+
+		SVGDrawState& operator=(const SVGDrawState& rhs)
+		{
+			fTransform = rhs.fTransform;
+			fFillAlpha = rhs.fFillAlpha;
+			blVarAssignWeak(&fFill, &rhs.fFill);
+			blVarAssignWeak(&fStroke, &rhs.fStroke);
+			fFillRule = rhs.fFillRule;
+			fStrokeWidth = rhs.fStrokeWidth;
+			fStrokeJoin = rhs.fStrokeJoin;
+			fStrokeCap = rhs.fStrokeCap;
+			fStrokeMiterLimit = rhs.fStrokeMiterLimit;
+			fFillVisible = rhs.fFillVisible;
+			fStrokeVisible = rhs.fStrokeVisible;
+			fTransformType = rhs.fTransformType;
+
+			return *this;
+		}
+
+		bool operator==(const SVGDrawState& rhs) const
+		{
+			return (fTransform == rhs.fTransform) &&
+				(fFillAlpha == rhs.fFillAlpha) &&
+				blVarEquals(&fFill, &rhs.fFill) &&
+				blVarEquals(&fStroke, &rhs.fStroke) &&
+				(fFillRule == rhs.fFillRule) &&
+				(fStrokeWidth == rhs.fStrokeWidth) &&
+				(fStrokeJoin == rhs.fStrokeJoin) &&
+				(fStrokeCap == rhs.fStrokeCap) &&
+				(fStrokeMiterLimit == rhs.fStrokeMiterLimit);
+		}
+		bool operator!=(const SVGDrawState& rhs) const { return !(*this == rhs); }
+	};
+
+	enum SVGDrawOp : uint8_t
+	{
+		SVG_DRAW_OP_PATH = 0,		// fill, then stroke, a path
+		SVG_DRAW_OP_IMAGE,			// blit an image into a destination rectangle
+	};
+
+	struct SVGDrawCommand
+	{
+		SVGDrawOp fOp{ SVG_DRAW_OP_PATH };
+		uint32_t fState{ 0 };		// index into the display list states
+		uint32_t fIndex{ 0 };		// index into the paths, or images, depending on fOp
+	};
+
+	struct SVGDrawImage
+	{
+		BLImage fImage{};
+		BLRect fDst{};
+		BLRectI fSrc{};
+	};
+
+	struct SVGDisplayList : public IDrawable
+	{
+		std::vector<SVGDrawState> fStates{};
+		std::vector<SVGDrawCommand> fCommands{};
+		std::vector<BLPath> fPaths{};
+		std::vector<SVGDrawImage> fImages{};
+
+		void clear()
+		{
+			fStates.clear();
+			fCommands.clear();
+			fPaths.clear();
+			fImages.clear();
+		}
+
+		bool empty() const { return fCommands.empty(); }
+		size_t size() const { return fCommands.size(); }
+
+		// Bring the context from the 'prev' state to the 's' state
+		// Only the fields that differ are set.  If there is no
+		// previous state, everything is set.
+		static void applyState(IRender& ctx, const BLMatrix2D& base, const SVGDrawState& s, const SVGDrawState* prev)
+		{
+			if (prev == nullptr || prev->fTransform != s.fTransform)
+			{
+				ctx.setMatrix(base);
+
+				switch (s.fTransformType)
+				{
+				case BL_MATRIX2D_TYPE_IDENTITY:
+				break;
+
+				case BL_MATRIX2D_TYPE_TRANSLATE:
+					ctx.translate(s.fTransform.m20, s.fTransform.m21);
+				break;
+
+				default:
+					ctx.transform(s.fTransform);
+				break;
+				}
+			}
+
+			if (prev == nullptr || prev->fFillAlpha != s.fFillAlpha)
+				ctx.setFillAlpha(s.fFillAlpha);
+			if (prev == nullptr || !blVarEquals(&prev->fFill, &s.fFill))
+				ctx.setFillStyle(s.fFill);
+			if (prev == nullptr || prev->fFillRule != s.fFillRule)
+				ctx.setFillRule(s.fFillRule);
+
+			if (prev == nullptr || !blVarEquals(&prev->fStroke, &s.fStroke))
+				ctx.setStrokeStyle(s.fStroke);
+			if (prev == nullptr || prev->fStrokeWidth != s.fStrokeWidth)
+				ctx.setStrokeWidth(s.fStrokeWidth);
+			if (prev == nullptr || prev->fStrokeJoin != s.fStrokeJoin)
+				ctx.setStrokeJoin(s.fStrokeJoin);
+			if (prev == nullptr || prev->fStrokeCap != s.fStrokeCap)
+				ctx.setStrokeCaps(s.fStrokeCap);
+			if (prev == nullptr || prev->fStrokeMiterLimit != s.fStrokeMiterLimit)
+				ctx.setStrokeMiterLimit(s.fStrokeMiterLimit);
+		}
+
+		void draw(IRender& ctx) override
+		{
+			if (empty())
+				return;
+
+			ctx.save();
+
+			// Everything in the list is relative to whatever
+			// transform the context had coming in
+			BLMatrix2D base = ctx.userMatrix();
+			const SVGDrawState* current = nullptr;
+
+			for (const auto& cmd : fCommands)
+			{
+				const SVGDrawState& state = fStates[cmd.fState];
+				if (&state != current)
+				{
+					applyState(ctx, base, state, current);
+					current = &state;
+				}
+
+				switch (cmd.fOp)
+				{
+				case SVG_DRAW_OP_PATH:
+					if (state.fFillVisible)
+					{
+						ctx.fillPath(fPaths[cmd.fIndex]);
+						SVG_STATS(ctx.fDrawStats.fFills++);
+					}
+					else
+					{
+						SVG_STATS(ctx.fDrawStats.fSkippedFills++);
+					}
+
+					if (state.fStrokeVisible)
+					{
+						ctx.strokePath(fPaths[cmd.fIndex]);
+						SVG_STATS(ctx.fDrawStats.fStrokes++);
+					}
+					else
+					{
+						SVG_STATS(ctx.fDrawStats.fSkippedStrokes++);
+					}
+				break;
+
+				case SVG_DRAW_OP_IMAGE: {
+					const SVGDrawImage& img = fImages[cmd.fIndex];
+					ctx.blitImage(img.fDst, img.fImage, img.fSrc);
+				}
+				break;
+				}
+			}
+
+			ctx.restore();
+		}
+	};
+
+	//
+	// SVGDisplayListBuilder
+	// Stands in for the rendering context while the node tree is
+	// being compiled.  It has the same state changing calls the nodes
+	// make on the context, but rather than rendering, it tracks
+	// the resolved state, and records draw commands into a display list.
+	//
+	struct SVGDisplayListBuilder
+	{
+		SVGDisplayList& fList;
+		SVGDrawState fState{};
+		std::vector<SVGDrawState> fStack{};
+		bool fDirty{ true };
+
+		// Text is recorded as the outlines of its glyphs, so the
+		// font only matters while building.  Like IRender, it's only
+		// copied aside when it changes after a save().
+		SVGTextState fText{};
+		std::vector<SVGTextState> fTextStack{};
+		std::vector<bool> fTextSaved{};
+
+		SVGDisplayListBuilder(SVGDisplayList& dl) : fList(dl) {}
+
+		void save() { fStack.push_back(fState); fTextSaved.push_back(false); }
+		void restore()
+		{
+			if (fStack.empty())
+				return;
+
+			fState = fStack.back();
+			fStack.pop_back();
+			if (fTextSaved.back())
+			{
+				fText = std::move(fTextStack.back());
+				fTextStack.pop_back();
+			}
+			fTextSaved.pop_back();
+			fDirty = true;
+		}
+
+		// Folded into the one transform, the state doesn't nest
+		void transform(const BLMatrix2D& m)
+		{
+			switch (m.type())
+			{
+			case BL_MATRIX2D_TYPE_IDENTITY:
+				return;
+
+			case BL_MATRIX2D_TYPE_TRANSLATE:
+				fState.fTransform.translate(m.m20, m.m21);
+			break;
+
+			default:
+				fState.fTransform.transform(m);
+			break;
+			}
+
+			fDirty = true;
+		}
+		void translate(double x, double y) { fState.fTransform.translate(x, y); fDirty = true; }
+		void scale(double x, double y) { fState.fTransform.scale(x, y); fDirty = true; }
+
+		void setFillAlpha(double alpha) { fState.fFillAlpha = alpha; fDirty = true; }
+		void setFillStyle(const BLVar& style) { blVarAssignWeak(&fState.fFill, &style); fDirty = true; }
+		void setFillStyle(const BLRgba32& color) { blVarAssignRgba32(&fState.fFill, color.value); fDirty = true; }
+		void setFillRule(BLFillRule rule) { fState.fFillRule = rule; fDirty = true; }
+
+		void setStrokeStyle(const BLVar& style) { blVarAssignWeak(&fState.fStroke, &style); fDirty = true; }
+		void setStrokeStyle(const BLRgba32& color) { blVarAssignRgba32(&fState.fStroke, color.value); fDirty = true; }
+		void setStrokeWidth(double width) { fState.fStrokeWidth = width; fDirty = true; }
+		void setStrokeJoin(BLStrokeJoin join) { fState.fStrokeJoin = join; fDirty = true; }
+		void setStrokeCaps(BLStrokeCap cap) { fState.fStrokeCap = cap; fDirty = true; }
+		void setStrokeMiterLimit(double limit) { fState.fStrokeMiterLimit = limit; fDirty = true; }
+
+		// The visibility of the state is worked out when it's recorded
+		void setPaintHidden(uint8_t, bool) {}
+
+		const SVGTextState& textState() const { return fText; }
+		void setTextState(const SVGTextState& text) { saveText(); fText = text; }
+		void setFontFace(const BLFontFace& face) { if (!fText.fFontFace.equals(face)) { saveText(); fText.fFontFace = face; } }
+		void setFontSize(double size) { if (fText.fFontSize != size) { saveText(); fText.fFontSize = size; } }
+		void setTextAnchor(double anchor) { if (fText.fTextAnchor != anchor) { saveText(); fText.fTextAnchor = anchor; } }
+
+		void saveText()
+		{
+			if (!fTextSaved.empty() && !fTextSaved.back())
+			{
+				fTextStack.push_back(fText);
+				fTextSaved.back() = true;
+			}
+		}
+
+		// Return the index of the state the next command should use
+		// A new state is only recorded if it's different from the last
+		// one, so runs of shapes sharing the same style share one state.
+		uint32_t currentState()
+		{
+			if (fDirty || fList.fStates.empty())
+			{
+				if (fList.fStates.empty() || fList.fStates.back() != fState)
+				{
+					fState.fFillVisible = (fState.fFillAlpha > 0) && IRender::paintVisible(fState.fFill);
+					fState.fStrokeVisible = (fState.fStrokeWidth > 0) && IRender::paintVisible(fState.fStroke);
+					fState.fTransformType = (uint8_t)fState.fTransform.type();
+					fList.fStates.push_back(fState);
+				}
+				fDirty = false;
+			}
+
+			return (uint32_t)(fList.fStates.size() - 1);
+		}
+
+		void addPath(const BLPath& path)
+		{
+			if (path.empty())
+				return;
+
+			SVGDrawCommand cmd{ SVG_DRAW_OP_PATH, currentState(), (uint32_t)fList.fPaths.size() };
+			fList.fPaths.push_back(path);
+			fList.fCommands.push_back(cmd);
+		}
+
+		void addImage(const BLImage& img, const BLRect& dst, const BLRectI& src)
+		{
+			if (img.empty())
+				return;
+
+			SVGDrawCommand cmd{ SVG_DRAW_OP_IMAGE, currentState(), (uint32_t)fList.fImages.size() };
+			fList.fImages.push_back(SVGDrawImage{ img, dst, src });
+			fList.fCommands.push_back(cmd);
+		}
+	};
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "blend2d.h"
+#include "bspanutil.h"
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Fonts
+// Blend2D doesn't look for fonts on its own, the application adds the
+// faces it wants text drawn with, see SVGFontCache::addFile().  A
+// font-family, like "'Open Sans', Arial, sans-serif", is looked up in
+// those, in order, and ends up at the first face added when none of them
+// are there.  What a family list turns into is remembered, so documents
+// that say the same thing on every element only look it up once.
+//
+// One cache is shared by all documents in the process, see shared().
+// It only remembers so many family lists, and fonts, letting go of the
+// least recently used ones, so a long running process that loads all
+// kinds of documents doesn't keep growing it.
+//
+namespace svg2b2d {
+
+	struct SVGFontCache
+	{
+		static constexpr size_t kMaxFamilies = 256;
+		static constexpr size_t kMaxFonts = 256;
+
+		SVGFontCache()
+		{
+			fManager.create();
+		}
+
+		SVGFontCache(const SVGFontCache&) = delete;
+		SVGFontCache& operator=(const SVGFontCache&) = delete;
+
+		// The cache used when loading, and drawing, documents
+		static SVGFontCache& shared()
+		{
+			static SVGFontCache gCache{};
+			return gCache;
+		}
+
+		// Make a face available to documents, by its family name
+		// The first one added is used when nothing else matches.
+		bool addFace(const BLFontFace& face)
+		{
+			if (face.empty())
+				return false;
+
+			std::lock_guard<std::mutex> lock(fMutex);
+			if (fManager.addFace(face) != BL_SUCCESS)
+				return false;
+
+			if (fDefaultFace.empty())
+				fDefaultFace = face;
+
+			// Lists that ended up at the default might match it now
+			fFamilies.clear();
+
+			return true;
+		}
+
+		bool addFile(const char* filename)
+		{
+			BLFontFace face{};
+			if (face.createFromFile(filename) != BL_SUCCESS)
+				return false;
+
+			return addFace(face);
+		}
+
+		void setDefaultFace(const BLFontFace& face)
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fDefaultFace = face;
+			fFamilies.clear();
+		}
+
+		BLFontFace defaultFace()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			return fDefaultFace;
+		}
+
+		// The face for a font-family list
+		// Empty if no faces have been added at all.
+		BLFontFace face(const ByteSpan& families)
+		{
+			uint64_t key = svg_hash64(families);
+
+			// A hash that matches, with a different list, is a miss
+			std::lock_guard<std::mutex> lock(fMutex);
+			Family* known = fFamilies.find(key);
+			if (known != nullptr && known->fNames.size() == families.size() &&
+				memcmp(known->fNames.data(), families.fStart, families.size()) == 0)
+				return known->fFace;
+
+			Family found{ std::string((const char*)families.fStart, families.size()), queryFamilies(families) };
+			BLFontFace face = found.fFace;
+			fFamilies.insert(key, std::move(found));
+
+			return face;
+		}
+
+		// A font of the face at a size, made once, and shared by
+		// everything that draws with it
+		BLFont font(const BLFontFace& face, float size)
+		{
+			BLFont f{};
+			if (face.empty() || !(size > 0))
+				return f;
+
+			uint32_t sizeBits{};
+			memcpy(&sizeBits, &size, sizeof(sizeBits));
+			FontKey key{ face.uniqueId(), sizeBits };
+
+			std::lock_guard<std::mutex> lock(fMutex);
+			BLFont* known = fFonts.find(key);
+			if (known != nullptr)
+				return *known;
+
+			if (f.createFromFace(face, size) == BL_SUCCESS)
+				fFonts.insert(key, f);
+
+			return f;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fManager.reset();
+			fManager.create();
+			fDefaultFace.reset();
+			fFamilies.clear();
+			fFonts.clear();
+		}
+
+	private:
+		struct FontKey
+		{
+			BLUniqueId fFaceId{ 0 };
+			uint32_t fSize{ 0 };
+
+			bool operator==(const FontKey& other) const { return fFaceId == other.fFaceId && fSize == other.fSize; }
+		};
+
+		struct FontKeyHash
+		{
+			size_t operator()(const FontKey& k) const noexcept { return (size_t)(k.fFaceId ^ (k.fSize * 0x9E3779B97F4A7C15ULL)); }
+		};
+
+		struct Family
+		{
+			std::string fNames{};
+			BLFontFace fFace{};
+		};
+
+		// A map that holds onto at most so many of what it's been
+		// given, the most recently used at the front
+		template <typename K, typename V, typename H = std::hash<K>>
+		struct RecentMap
+		{
+			using Entries = std::list<std::pair<K, V>>;
+
+			size_t fMaxEntries{ 0 };
+			Entries fEntries{};
+			std::unordered_map<K, typename Entries::iterator, H> fIndex{};
+
+			RecentMap(size_t maxEntries) : fMaxEntries(maxEntries) {}
+
+			V* find(const K& key)
+			{
+				auto it = fIndex.find(key);
+				if (it == fIndex.end())
+					return nullptr;
+
+				fEntries.splice(fEntries.begin(), fEntries, it->second);
+				return &it->second->second;
+			}
+
+			void insert(const K& key, V value)
+			{
+				auto it = fIndex.find(key);
+				if (it != fIndex.end())
+				{
+					fEntries.erase(it->second);
+					fIndex.erase(it);
+				}
+
+				fEntries.emplace_front(key, std::move(value));
+				fIndex[key] = fEntries.begin();
+
+				while (fEntries.size() > fMaxEntries)
+				{
+					fIndex.erase(fEntries.back().first);
+					fEntries.pop_back();
+				}
+			}
+
+			void clear()
+			{
+				fEntries.clear();
+				fIndex.clear();
+			}
+		};
+
+		BLFontManager fManager{};
+		BLFontFace fDefaultFace{};
+		RecentMap<uint64_t, Family> fFamilies{ kMaxFamilies };
+		RecentMap<FontKey, BLFont, FontKeyHash> fFonts{ kMaxFonts };
+		std::mutex fMutex{};
+
+		// The first family of the list that's been added
+		// Generic families (serif, sans-serif) are whatever the default is.
+		// Must be called with the lock held
+		BLFontFace queryFamilies(const ByteSpan& families)
+		{
+			static constexpr charset commaChars(",");
+			static constexpr charset trimChars(" \r\n\t\f\v'\"");
+
+			ByteSpan s = families;
+			while (s)
+			{
+				ByteSpan name = chunk_trim(chunk_token(s, commaChars), trimChars);
+				if (!name)
+					continue;
+
+				BLStringView view{};
+				view.reset((const char*)name.fStart, name.size());
+
+				BLFontFace face{};
+				if (fManager.queryFace(view, face) == BL_SUCCESS && !face.empty())
+					return face;
+			}
+
+			return fDefaultFace;
+		}
+	};
+
+	//
+	// SVGGlyphRun
+	// A piece of text shaped with a font, ready to be drawn
+	//
+	struct SVGGlyphRun
+	{
+		BLFont fFont{};
+		BLGlyphBuffer fGlyphs{};
+		BLTextMetrics fMetrics{};
+		BLUniqueId fFaceId{ 0 };
+		float fSize{ 0 };
+
+		const BLGlyphRun& glyphRun() const { return fGlyphs.glyphRun(); }
+		double advance() const { return fMetrics.advance.x; }
+	};
+
+	//
+	// SVGGlyphRunCache
+	// The shaped runs of one piece of text, one for each face, and size,
+	// it's been drawn with, so drawing it again doesn't shape it again.
+	// Runs are handed out shared, so one being replaced isn't pulled out
+	// from under another thread that's still drawing it.
+	//
+	struct SVGGlyphRunCache
+	{
+		static constexpr size_t kMaxEntries = 4;
+
+		std::mutex fMutex{};
+		std::vector<std::shared_ptr<const SVGGlyphRun>> fEntries{};
+		size_t fNext{ 0 };		// the entry to replace next, once full
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fEntries.clear();
+			fNext = 0;
+		}
+
+		// nullptr if the text can't be shaped with the face
+		std::shared_ptr<const SVGGlyphRun> run(const BLFontFace& face, float size, const std::string& text)
+		{
+			if (face.empty() || text.empty() || !(size > 0))
+				return nullptr;
+
+			BLUniqueId faceId = face.uniqueId();
+
+			std::lock_guard<std::mutex> lock(fMutex);
+			for (const auto& e : fEntries)
+			{
+				if (e->fFaceId == faceId && e->fSize == size)
+					return e;
+			}
+
+			auto entry = std::make_shared<SVGGlyphRun>();
+			entry->fFaceId = faceId;
+			entry->fSize = size;
+			entry->fFont = SVGFontCache::shared().font(face, size);
+			if (entry->fFont.empty())
+				return nullptr;
+
+			if (entry->fGlyphs.setUtf8Text(text.data(), text.size()) != BL_SUCCESS ||
+				entry->fFont.shape(entry->fGlyphs) != BL_SUCCESS ||
+				entry->fFont.getTextMetrics(entry->fGlyphs, entry->fMetrics) != BL_SUCCESS)
+				return nullptr;
+
+			if (fEntries.size() < kMaxEntries)
+				fEntries.push_back(entry);
+			else
+			{
+				fEntries[fNext] = entry;
+				fNext = (fNext + 1) % kMaxEntries;
+			}
+
+			return entry;
+		}
+	};
+}
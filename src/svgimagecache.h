@@ -0,0 +1,151 @@
+#pragma once
+
+#include "blend2d.h"
+#include "bspanutil.h"
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+//
+// SVGImageCache
+// Decoded <image> data, keyed by a hash of the encoded data.
+// The same embedded image, whether it shows up several times in
+// one document, or in many documents, is only decoded the first time.
+// Anyone asking after that gets a reference to the same pixels.
+//
+// The key is the 64-bit hash, plus the length of the encoded data.
+// A 'variant' goes into the hash as well, for when the same data
+// is decoded in different ways (reduced to a maximum size).
+// The encoded data itself isn't kept, it's as big as the image it
+// came from, so two different images that hash the same would be
+// mistaken for each other.  At 64 bits, that's not going to happen.
+//
+// Images are held up to a byte budget, least recently used go first.
+// One cache is shared by all documents in the process, see shared().
+//
+namespace svg2b2d {
+
+	struct SVGImageCache
+	{
+		SVGImageCache(size_t maxBytes = 64 * 1024 * 1024)
+			: fMaxBytes(maxBytes)
+		{}
+
+		SVGImageCache(const SVGImageCache&) = delete;
+		SVGImageCache& operator=(const SVGImageCache&) = delete;
+
+		// The cache used when loading documents
+		static SVGImageCache& shared()
+		{
+			static SVGImageCache gCache{};
+			return gCache;
+		}
+
+		// If the encoded data has been decoded before,
+		// outImage refers to the decoded pixels, and true is returned.
+		bool find(const ByteSpan& encoded, BLImage& outImage, uint64_t variant = 0)
+		{
+			Key key{ svg_hash64(encoded, variant), encoded.size() };
+
+			std::lock_guard<std::mutex> lock(fMutex);
+			auto it = fIndex.find(key);
+			if (it == fIndex.end())
+			{
+				fMisses++;
+				return false;
+			}
+
+			fEntries.splice(fEntries.begin(), fEntries, it->second);
+			outImage.assign(it->second->fImage);
+			fHits++;
+
+			return true;
+		}
+
+		// Remember what the encoded data decoded to
+		void add(const ByteSpan& encoded, const BLImage& img, uint64_t variant = 0)
+		{
+			if (img.empty())
+				return;
+
+			Key key{ svg_hash64(encoded, variant), encoded.size() };
+			size_t bytes = sizeof(Item) + (size_t)img.width() * img.height() * 4;
+
+			std::lock_guard<std::mutex> lock(fMutex);
+			if (bytes > fMaxBytes || fIndex.find(key) != fIndex.end())
+				return;
+
+			fEntries.push_front(Item{ key, img, bytes });
+			fIndex[key] = fEntries.begin();
+			fBytes += bytes;
+
+			evict();
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fEntries.clear();
+			fIndex.clear();
+			fBytes = 0;
+		}
+
+		void setMaxBytes(size_t maxBytes)
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fMaxBytes = maxBytes;
+			evict();
+		}
+
+		size_t maxBytes() const { return fMaxBytes; }
+		size_t bytes() { std::lock_guard<std::mutex> lock(fMutex); return fBytes; }
+		size_t size() { std::lock_guard<std::mutex> lock(fMutex); return fEntries.size(); }
+		size_t hits() { std::lock_guard<std::mutex> lock(fMutex); return fHits; }
+		size_t misses() { std::lock_guard<std::mutex> lock(fMutex); return fMisses; }
+
+	private:
+		struct Key
+		{
+			uint64_t fHash{ 0 };
+			size_t fSize{ 0 };
+
+			bool operator==(const Key& other) const { return fHash == other.fHash && fSize == other.fSize; }
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const Key& k) const noexcept { return (size_t)(k.fHash ^ (k.fSize * 0x9E3779B97F4A7C15ULL)); }
+		};
+
+		struct Item
+		{
+			Key fKey{};
+			BLImage fImage{};
+			size_t fBytes{ 0 };
+		};
+
+		// Most recently used at the front
+		std::list<Item> fEntries{};
+		std::unordered_map<Key, std::list<Item>::iterator, KeyHash> fIndex{};
+		std::mutex fMutex{};
+
+		size_t fMaxBytes{ 0 };
+		size_t fBytes{ 0 };
+		size_t fHits{ 0 };
+		size_t fMisses{ 0 };
+
+		// Must be called with the lock held
+		void evict()
+		{
+			while (fBytes > fMaxBytes && !fEntries.empty())
+			{
+				Item& last = fEntries.back();
+				fBytes -= last.fBytes;
+				fIndex.erase(last.fKey);
+				fEntries.pop_back();
+			}
+		}
+	};
+}
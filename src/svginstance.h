@@ -0,0 +1,273 @@
+#pragma once
+
+#include "blend2d.h"
+#include "irender.h"
+#include "svgtypes.h"
+#include "svgdisplaylist.h"
+
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//
+// SVGInstanceCache
+// What a <use> needs to draw its target again, without walking the
+// target's node tree, and re-applying all of its properties, every time.
+// One cache belongs to each node that is the target of a <use>, and is
+// shared by all the <use> elements that refer to it.
+//
+// There are two ways an instance is drawn from the cache:
+//   - Sprite: small targets are rasterized once, and blitted after that.
+//     A sprite is only good for one linear transform (rotation, scale),
+//     so it is used for the instances that only differ by a translation.
+//     The sub-pixel part of the translation is rounded to 1/8 of a pixel.
+//   - Geometry: the target compiled into a display list, so all of its
+//     nested transforms, paints, and paths are already resolved, and it's
+//     replayed at whatever transform is on the context.  A display list
+//     applies a group's opacity to each of its fills, so targets with
+//     translucent groups aren't drawn this way when layers are on.
+//
+// Either one depends on the paints, stroke, and text, inherited from where
+// the <use> is, so that's part of what they're looked up by.  Nothing is cached
+// until the target has been drawn a second time, one-off uses draw normally.
+//
+namespace svg2b2d {
+
+	// The drawing state every draw of 'ctx' starts from, what
+	// the target of a <use> would inherit.  The transform is not
+	// filled in, it's up to the caller what it should be.
+	static inline SVGDrawState svgInheritedState(IRender& ctx)
+	{
+		SVGDrawState s{};
+
+		ctx.getFillStyle(s.fFill);
+		ctx.getStrokeStyle(s.fStroke);
+		s.fFillAlpha = ctx.fillAlpha();
+		s.fFillRule = ctx.fillRule();
+
+		const BLStrokeOptions& stroke = ctx.strokeOptions();
+		s.fStrokeWidth = stroke.width;
+		s.fStrokeJoin = (BLStrokeJoin)stroke.join;
+		s.fStrokeCap = (BLStrokeCap)stroke.startCap;
+		s.fStrokeMiterLimit = stroke.miterLimit;
+
+		return s;
+	}
+
+	struct SVGInstanceCache
+	{
+		static constexpr int kMaxSpriteSize = 128;		// device pixels, in either direction
+		static constexpr size_t kMaxSprites = 16;
+		static constexpr size_t kMaxGeometry = 4;
+		static constexpr size_t kMinDraws = 2;
+
+		// The part of the inherited text state that changes what's drawn
+		struct TextKey
+		{
+			BLUniqueId fFaceId{ 0 };
+			double fFontSize{ 0 };
+			double fTextAnchor{ 0 };
+
+			TextKey() = default;
+			TextKey(const SVGTextState& text)
+				: fFaceId(text.fFontFace.empty() ? 0 : text.fFontFace.uniqueId())
+				, fFontSize(text.fFontSize)
+				, fTextAnchor(text.fTextAnchor) {}
+
+			bool operator==(const TextKey& other) const
+			{
+				return fFaceId == other.fFaceId && fFontSize == other.fFontSize && fTextAnchor == other.fTextAnchor;
+			}
+		};
+
+		struct Sprite
+		{
+			SVGDrawState fKey{};
+			TextKey fTextKey{};
+			BLImage fImage{};
+			BLPointI fOffset{};		// of the image, from the whole pixel the instance is placed at
+		};
+
+		struct Geometry
+		{
+			SVGDrawState fKey{};
+			TextKey fTextKey{};
+			std::shared_ptr<SVGDisplayList> fList{};
+		};
+
+		std::mutex fMutex{};
+		std::vector<Sprite> fSprites{};
+		std::vector<Geometry> fGeometry{};
+		size_t fDraws{ 0 };
+		int fDrawsLayers{ -1 };		// the target's drawsLayers(), once it's been asked
+
+		// Draw 'node' into the context, from the cache if possible
+		// Returns false if the node should be drawn the regular way.
+		bool draw(IRender& ctx, SVGObject& node)
+		{
+			if (!ctx.instancing())
+				return false;
+
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+				if (++fDraws < kMinDraws)
+					return false;
+			}
+
+			SVGDrawState inherited = svgInheritedState(ctx);
+
+			if (drawSprite(ctx, node, inherited))
+				return true;
+
+			if (ctx.layers())
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+				if (fDrawsLayers < 0)
+					fDrawsLayers = node.drawsLayers() ? 1 : 0;
+				if (fDrawsLayers)
+					return false;
+			}
+
+			return drawGeometry(ctx, node, inherited);
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fSprites.clear();
+			fGeometry.clear();
+			fDraws = 0;
+			fDrawsLayers = -1;
+		}
+
+	private:
+		bool drawSprite(IRender& ctx, SVGObject& node, SVGDrawState& key)
+		{
+			// A sprite drawn on top of what's there is the same as drawing
+			// each of its shapes on top of what's there, only when they are
+			// composited normally, with nothing applied to them as a whole.
+			// It's blitted in device space, which the meta matrix is in the way of.
+			if (ctx.compOp() != BL_COMP_OP_SRC_OVER || ctx.globalAlpha() != 1.0)
+				return false;
+			if (ctx.metaMatrix().type() != BL_MATRIX2D_TYPE_IDENTITY)
+				return false;
+
+			BLBox box = node.extent();
+			if (svgBoxIsUnbounded(box) || svgBoxIsEmpty(box))
+				return false;
+			box = svgBoxInflate(box, ctx.strokeReach() * node.fExtentStrokeScale);
+
+			// Split the translation into whole pixels, and the sub-pixel
+			// part that the sprite is rasterized at
+			BLMatrix2D m = ctx.deviceMatrix();
+			double px = std::floor(m.m20);
+			double py = std::floor(m.m21);
+			m.m20 = std::round((m.m20 - px) * 8.0) / 8.0;
+			m.m21 = std::round((m.m21 - py) * 8.0) / 8.0;
+			key.fTransform = m;
+			key.fTransformType = (uint8_t)m.type();
+
+			// Anti-aliasing can reach a pixel past the bounds
+			BLBox dbox = svgBoxTransform(box, m);
+			int x0 = (int)std::floor(dbox.x0) - 1;
+			int y0 = (int)std::floor(dbox.y0) - 1;
+			int x1 = (int)std::ceil(dbox.x1) + 1;
+			int y1 = (int)std::ceil(dbox.y1) + 1;
+			if ((x1 - x0) > kMaxSpriteSize || (y1 - y0) > kMaxSpriteSize)
+				return false;
+
+			BLImage img{};
+			BLPointI offset{};
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+
+				TextKey textKey(ctx.textState());
+				const Sprite* sprite = nullptr;
+				for (const auto& s : fSprites)
+				{
+					if (s.fKey == key && s.fTextKey == textKey)
+					{
+						sprite = &s;
+						break;
+					}
+				}
+
+				if (sprite == nullptr)
+				{
+					if (fSprites.size() >= kMaxSprites)
+						return false;
+
+					Sprite s{};
+					s.fKey = key;
+					s.fTextKey = textKey;
+					s.fOffset = BLPointI(x0, y0);
+					if (s.fImage.create(x1 - x0, y1 - y0, BL_FORMAT_PRGB32) != BL_SUCCESS)
+						return false;
+
+					IRender sctx(s.fImage);
+					sctx.clearAll();
+					SVGDisplayList::applyState(sctx, BLMatrix2D::makeTranslation(-x0, -y0), key, nullptr);
+					sctx.fHidden = ctx.fHidden;
+					sctx.setLayers(ctx.layers());
+					sctx.setTextState(ctx.textState());
+					node.draw(sctx);
+					sctx.end();
+
+					fSprites.push_back(std::move(s));
+					sprite = &fSprites.back();
+				}
+
+				img.assign(sprite->fImage);
+				offset = sprite->fOffset;
+			}
+
+			ctx.save();
+			ctx.resetMatrix();
+			ctx.blitImage(BLPointI((int)px + offset.x, (int)py + offset.y), img);
+			ctx.restore();
+
+			return true;
+		}
+
+		bool drawGeometry(IRender& ctx, SVGObject& node, SVGDrawState& key)
+		{
+			// The display list is relative to the transform it's drawn at
+			key.fTransform = BLMatrix2D::makeIdentity();
+			key.fTransformType = BL_MATRIX2D_TYPE_IDENTITY;
+
+			std::shared_ptr<SVGDisplayList> list{};
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+
+				TextKey textKey(ctx.textState());
+				for (const auto& g : fGeometry)
+				{
+					if (g.fKey == key && g.fTextKey == textKey)
+					{
+						list = g.fList;
+						break;
+					}
+				}
+
+				if (list == nullptr)
+				{
+					if (fGeometry.size() >= kMaxGeometry)
+						return false;
+
+					list = std::make_shared<SVGDisplayList>();
+					SVGDisplayListBuilder builder(*list);
+					builder.fState = key;
+					builder.fText = ctx.textState();
+					node.compile(builder);
+
+					fGeometry.push_back(Geometry{ key, textKey, list });
+				}
+			}
+
+			list->draw(ctx);
+
+			return true;
+		}
+	};
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "blend2d.h"
+#include "irender.h"
+#include "svgbox.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+//
+// Offscreen layers
+// A group with an opacity is supposed to be drawn as a whole, and the
+// result made translucent, rather than each of its shapes being made
+// translucent on their own (where they overlap, they'd show through each
+// other).  So the group is drawn into a layer, an offscreen image the
+// size of the group's bounds on the device, which is then blitted at
+// the group's opacity.
+//
+// Layers come and go with every translucent group, on every draw, and
+// nest.  Rather than allocating them each time, the images are taken
+// from, and given back to, an SVGLayerPool.  Sizes are rounded up, so
+// groups of roughly the same size share the same images.
+//
+namespace svg2b2d {
+
+	struct SVGLayerPool
+	{
+		static constexpr int kGranularity = 64;		// pixels, sizes are rounded up to this
+
+		SVGLayerPool(size_t maxBytes = 32 * 1024 * 1024)
+			: fMaxBytes(maxBytes)
+		{}
+
+		SVGLayerPool(const SVGLayerPool&) = delete;
+		SVGLayerPool& operator=(const SVGLayerPool&) = delete;
+
+		// The pool layers are drawn with
+		static SVGLayerPool& shared()
+		{
+			static SVGLayerPool gPool{};
+			return gPool;
+		}
+
+		// An image at least w by h, its contents are undefined
+		// The smallest free image that fits is handed out, as long as
+		// it isn't more than twice the size needed.
+		BLImage acquire(int w, int h)
+		{
+			int rw = roundUp(w);
+			int rh = roundUp(h);
+
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+
+				size_t best = fFree.size();
+				int64_t bestArea = 2 * (int64_t)rw * rh + 1;
+				for (size_t i = 0; i < fFree.size(); i++)
+				{
+					const BLImage& img = fFree[i];
+					int64_t area = (int64_t)img.width() * img.height();
+					if (img.width() >= w && img.height() >= h && area < bestArea)
+					{
+						best = i;
+						bestArea = area;
+					}
+				}
+
+				if (best < fFree.size())
+				{
+					BLImage img = fFree[best];
+					fFree[best] = fFree.back();
+					fFree.pop_back();
+					fBytes -= imageBytes(img);
+					fReuses++;
+
+					return img;
+				}
+
+				fAllocations++;
+			}
+
+			BLImage img{};
+			img.create(rw, rh, BL_FORMAT_PRGB32);
+
+			return img;
+		}
+
+		// Give an image back, to be handed out again
+		void release(BLImage& img)
+		{
+			if (img.empty())
+				return;
+
+			size_t bytes = imageBytes(img);
+
+			std::lock_guard<std::mutex> lock(fMutex);
+			if (fBytes + bytes <= fMaxBytes)
+			{
+				fFree.push_back(img);
+				fBytes += bytes;
+			}
+			img.reset();
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fFree.clear();
+			fBytes = 0;
+		}
+
+		void setMaxBytes(size_t maxBytes)
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fMaxBytes = maxBytes;
+			while (fBytes > fMaxBytes && !fFree.empty())
+			{
+				fBytes -= imageBytes(fFree.back());
+				fFree.pop_back();
+			}
+		}
+
+		size_t maxBytes() const { return fMaxBytes; }
+		size_t bytes() { std::lock_guard<std::mutex> lock(fMutex); return fBytes; }
+		size_t allocations() { std::lock_guard<std::mutex> lock(fMutex); return fAllocations; }
+		size_t reuses() { std::lock_guard<std::mutex> lock(fMutex); return fReuses; }
+
+	private:
+		std::vector<BLImage> fFree{};
+		std::mutex fMutex{};
+
+		size_t fMaxBytes{ 0 };
+		size_t fBytes{ 0 };
+		size_t fAllocations{ 0 };
+		size_t fReuses{ 0 };
+
+		static int roundUp(int v) { return ((v + kGranularity - 1) / kGranularity) * kGranularity; }
+		static size_t imageBytes(const BLImage& img) { return (size_t)img.width() * img.height() * 4; }
+	};
+
+	//
+	// SVGLayer
+	// One use of a layer.  begin() sets up a context, drawing into an image
+	// from the pool, in the same state as the context the layer is for,
+	// so drawing into it looks just the same.  end() draws the layer
+	// into that context, and gives the image back.
+	//
+	struct SVGLayer
+	{
+		static constexpr int kMaxLayerSize = 8192;		// pixels, in either direction
+
+		SVGLayerPool& fPool;
+		IRender fContext{};
+		BLImage fImage{};
+		BLRectI fBounds{};
+
+		SVGLayer(SVGLayerPool& pool = SVGLayerPool::shared()) : fPool(pool) {}
+		~SVGLayer() { fContext.end(); fPool.release(fImage); }
+
+		// The layer covers 'box', which is in the user space of 'ctx'
+		// Returns false if there's nothing to cover, or it's too big.
+		bool begin(IRender& ctx, const BLBox& box)
+		{
+			if (svgBoxIsUnbounded(box) || svgBoxIsEmpty(box))
+				return false;
+
+			// Where the box lands on the device, only the part
+			// that can be seen.  Anti-aliasing reaches a pixel further.
+			BLMatrix2D m = ctx.deviceMatrix();
+			BLBox dbox = svgBoxTransform(box, m);
+			BLBox cull = ctx.cullBox();
+
+			int x0 = (int)std::floor(std::max(dbox.x0 - 1, cull.x0));
+			int y0 = (int)std::floor(std::max(dbox.y0 - 1, cull.y0));
+			int x1 = (int)std::ceil(std::min(dbox.x1 + 1, cull.x1));
+			int y1 = (int)std::ceil(std::min(dbox.y1 + 1, cull.y1));
+			if (x1 <= x0 || y1 <= y0 || (x1 - x0) > kMaxLayerSize || (y1 - y0) > kMaxLayerSize)
+				return false;
+
+			fBounds = BLRectI(x0, y0, x1 - x0, y1 - y0);
+			fImage = fPool.acquire(fBounds.w, fBounds.h);
+			if (fImage.empty() || fContext.begin(fImage) != BL_SUCCESS)
+				return false;
+
+			// The image can be bigger than the layer
+			BLRectI area(0, 0, fBounds.w, fBounds.h);
+			fContext.clearRect(area);
+			fContext.clipToRect(area);
+
+			// Same state as the context, only positioned on the layer
+			fContext.setMatrix(BLMatrix2D::makeTranslation(-x0, -y0));
+			fContext.transform(m);
+
+			BLVar style{};
+			ctx.getFillStyle(style);
+			fContext.setFillStyle(style);
+			ctx.getStrokeStyle(style);
+			fContext.setStrokeStyle(style);
+			fContext.setFillAlpha(ctx.fillAlpha());
+			fContext.setStrokeAlpha(ctx.strokeAlpha());
+			fContext.setFillRule(ctx.fillRule());
+			fContext.setStrokeOptions(ctx.strokeOptions());
+
+			fContext.fHidden = ctx.fHidden;
+			fContext.setTextState(ctx.textState());
+			fContext.setCulling(ctx.culling());
+			fContext.setInstancing(ctx.instancing());
+			fContext.setLayers(ctx.layers());
+			fContext.setLevelOfDetail(ctx.levelOfDetail());
+			fContext.setCullBox(BLBox(0, 0, fBounds.w, fBounds.h));
+
+			return true;
+		}
+
+		IRender& context() { return fContext; }
+
+		// Draw what was drawn into the layer, at the opacity
+		void end(IRender& ctx, double opacity)
+		{
+			fContext.end();
+
+#if defined(SVG_ENABLE_STATS)
+			SVGDrawStats& stats = ctx.fDrawStats;
+			stats.fFills += fContext.fDrawStats.fFills;
+			stats.fStrokes += fContext.fDrawStats.fStrokes;
+			stats.fSkippedFills += fContext.fDrawStats.fSkippedFills;
+			stats.fSkippedStrokes += fContext.fDrawStats.fSkippedStrokes;
+#endif
+
+			// The layer is in device pixels
+			BLMatrix2D toDevice = ctx.metaMatrix();
+			toDevice.invert();
+
+			ctx.save();
+			ctx.setMatrix(toDevice);
+			ctx.setGlobalAlpha(ctx.globalAlpha() * opacity);
+			ctx.blitImage(BLPointI(fBounds.x, fBounds.y), fImage, BLRectI(0, 0, fBounds.w, fBounds.h));
+			ctx.restore();
+
+			fPool.release(fImage);
+		}
+	};
+}
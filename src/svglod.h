@@ -0,0 +1,278 @@
+#pragma once
+
+#include "blend2d.h"
+#include "irender.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+//
+// Level of detail
+// A path with a lot of geometry, drawn small (a detailed map as a
+// thumbnail), spends most of its time on segments far smaller than a
+// pixel.  When the context has a level of detail tolerance set, such
+// paths are drawn from a simplified copy instead: the curves flattened,
+// and the resulting polylines thinned with Douglas-Peucker, to within
+// the tolerance, in device pixels.  The cost of drawing then follows
+// the size it's drawn at, rather than how detailed the source is.
+//
+// Simplified copies are cached on the shape, one per power of two of
+// scale, each made to suit the largest scale in its range, so zooming
+// around doesn't make them over and over.
+//
+namespace svg2b2d {
+
+	// Append the points of a quadratic curve, flattened to within
+	// 'tolerance', not including where it starts
+	static inline void svgFlattenQuad(const BLPoint& p0, const BLPoint& p1, const BLPoint& p2, double tolerance, std::vector<BLPoint>& out)
+	{
+		// Enough steps for the curve to stay within the tolerance
+		double dx = p0.x - 2 * p1.x + p2.x;
+		double dy = p0.y - 2 * p1.y + p2.y;
+		double dd = std::sqrt(dx * dx + dy * dy);
+		int n = std::clamp((int)std::ceil(std::sqrt(0.25 * dd / tolerance)), 1, 256);
+
+		for (int i = 1; i <= n; i++)
+		{
+			double t = (double)i / n;
+			double mt = 1 - t;
+			out.push_back(BLPoint(mt * mt * p0.x + 2 * mt * t * p1.x + t * t * p2.x,
+				mt * mt * p0.y + 2 * mt * t * p1.y + t * t * p2.y));
+		}
+	}
+
+	static inline void svgFlattenCubic(const BLPoint& p0, const BLPoint& p1, const BLPoint& p2, const BLPoint& p3, double tolerance, std::vector<BLPoint>& out)
+	{
+		double ax = p0.x - 2 * p1.x + p2.x, ay = p0.y - 2 * p1.y + p2.y;
+		double bx = p1.x - 2 * p2.x + p3.x, by = p1.y - 2 * p2.y + p3.y;
+		double dd = std::sqrt(std::max(ax * ax + ay * ay, bx * bx + by * by));
+		int n = std::clamp((int)std::ceil(std::sqrt(0.75 * dd / tolerance)), 1, 256);
+
+		for (int i = 1; i <= n; i++)
+		{
+			double t = (double)i / n;
+			double mt = 1 - t;
+			double a = mt * mt * mt, b = 3 * mt * mt * t, c = 3 * mt * t * t, d = t * t * t;
+			out.push_back(BLPoint(a * p0.x + b * p1.x + c * p2.x + d * p3.x,
+				a * p0.y + b * p1.y + c * p2.y + d * p3.y));
+		}
+	}
+
+	// Douglas-Peucker
+	// Mark the points of pts that have to stay, for the polyline to
+	// be within 'tolerance' of where it was.  The ends always stay.
+	static inline void svgSimplifyPolyline(const std::vector<BLPoint>& pts, double tolerance, std::vector<uint8_t>& keep)
+	{
+		size_t n = pts.size();
+		keep.assign(n, 0);
+		if (n == 0)
+			return;
+
+		keep[0] = 1;
+		keep[n - 1] = 1;
+
+		double tol2 = tolerance * tolerance;
+		std::vector<std::pair<size_t, size_t>> stack{};
+		stack.push_back({ 0, n - 1 });
+
+		while (!stack.empty())
+		{
+			auto [first, last] = stack.back();
+			stack.pop_back();
+			if (last <= first + 1)
+				continue;
+
+			const BLPoint& a = pts[first];
+			double vx = pts[last].x - a.x;
+			double vy = pts[last].y - a.y;
+			double len2 = vx * vx + vy * vy;
+
+			// The point furthest from the line between the ends, or from
+			// the end, when they're in the same place (a closed ring)
+			double maxDist2 = -1;
+			size_t furthest = first;
+			for (size_t i = first + 1; i < last; i++)
+			{
+				double wx = pts[i].x - a.x;
+				double wy = pts[i].y - a.y;
+				double d2;
+				if (len2 > 0)
+				{
+					double cross = vx * wy - vy * wx;
+					d2 = cross * cross / len2;
+				}
+				else
+					d2 = wx * wx + wy * wy;
+
+				if (d2 > maxDist2)
+				{
+					maxDist2 = d2;
+					furthest = i;
+				}
+			}
+
+			if (maxDist2 > tol2)
+			{
+				keep[furthest] = 1;
+				stack.push_back({ first, furthest });
+				stack.push_back({ furthest, last });
+			}
+		}
+	}
+
+	// A copy of 'path', with curves flattened, and every figure
+	// simplified, to within 'tolerance', in the path's own units
+	static inline void svgSimplifyPath(const BLPath& path, double tolerance, BLPath& out)
+	{
+		out.clear();
+
+		const uint8_t* cmds = path.commandData();
+		const BLPoint* vtx = path.vertexData();
+		size_t n = path.size();
+
+		std::vector<BLPoint> pts{};
+		std::vector<uint8_t> keep{};
+
+		auto flush = [&](bool closed) {
+			if (!pts.empty())
+			{
+				svgSimplifyPolyline(pts, tolerance, keep);
+				out.moveTo(pts[0]);
+				for (size_t k = 1; k < pts.size(); k++)
+				{
+					if (keep[k])
+						out.lineTo(pts[k]);
+				}
+				if (closed)
+					out.close();
+			}
+			pts.clear();
+		};
+
+		size_t i = 0;
+		while (i < n)
+		{
+			switch (cmds[i])
+			{
+			case BL_PATH_CMD_MOVE:
+				flush(false);
+				pts.push_back(vtx[i]);
+				i++;
+			break;
+
+			case BL_PATH_CMD_ON:
+				pts.push_back(vtx[i]);
+				i++;
+			break;
+
+			case BL_PATH_CMD_QUAD:
+				if (i + 1 >= n || pts.empty())
+					return;
+				svgFlattenQuad(pts.back(), vtx[i], vtx[i + 1], tolerance, pts);
+				i += 2;
+			break;
+
+			case BL_PATH_CMD_CUBIC:
+				if (i + 2 >= n || pts.empty())
+					return;
+				svgFlattenCubic(pts.back(), vtx[i], vtx[i + 1], vtx[i + 2], tolerance, pts);
+				i += 3;
+			break;
+
+			case BL_PATH_CMD_CLOSE:
+				flush(true);
+				i++;
+			break;
+
+			default:
+				i++;
+			break;
+			}
+		}
+
+		flush(false);
+	}
+
+	//
+	// SVGLodCache
+	// The simplified copies of one shape's path
+	//
+	struct SVGLodCache
+	{
+		static constexpr size_t kMinDataBytes = 2048;	// of geometry data, for a shape to have a cache
+		static constexpr size_t kMinVertices = 256;		// paths with fewer are drawn as they are
+		static constexpr size_t kMaxEntries = 4;
+
+		struct Entry
+		{
+			int fBucket{ 0 };
+			double fTolerance{ 0 };
+			BLPath fPath{};
+		};
+
+		std::mutex fMutex{};
+		std::vector<Entry> fEntries{};
+		size_t fPathSize{ 0 };
+		size_t fNext{ 0 };		// the entry to replace next, once full
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fEntries.clear();
+			fNext = 0;
+		}
+
+		// The path to draw 'path' with, at the scale the context is at
+		// When simplifying doesn't save much, it's 'path' itself.
+		BLPath path(IRender& ctx, const BLPath& path)
+		{
+			double tolerancePx = ctx.levelOfDetail();
+			if (!(tolerancePx > 0) || path.size() < kMinVertices)
+				return path;
+
+			BLPoint deviceScale = ctx.deviceScale();
+			double scale = std::max(deviceScale.x, deviceScale.y);
+			if (!(scale > 0) || !std::isfinite(scale))
+				return path;
+
+			// Made for the largest scale of the bucket
+			int bucket = (int)std::floor(std::log2(scale));
+			double tolerance = tolerancePx / std::ldexp(1.0, bucket + 1);
+
+			std::lock_guard<std::mutex> lock(fMutex);
+
+			if (fPathSize != path.size())
+			{
+				fEntries.clear();
+				fNext = 0;
+				fPathSize = path.size();
+			}
+
+			for (const auto& e : fEntries)
+			{
+				if (e.fBucket == bucket && e.fTolerance == tolerance)
+					return e.fPath.empty() ? path : e.fPath;
+			}
+
+			Entry entry{ bucket, tolerance, BLPath{} };
+			svgSimplifyPath(path, tolerance, entry.fPath);
+
+			// Not worth drawing from, an empty path says so
+			if (entry.fPath.size() * 10 > path.size() * 9)
+				entry.fPath.reset();
+
+			BLPath result = entry.fPath.empty() ? path : entry.fPath;
+			if (fEntries.size() < kMaxEntries)
+				fEntries.push_back(std::move(entry));
+			else
+			{
+				fEntries[fNext] = std::move(entry);
+				fNext = (fNext + 1) % kMaxEntries;
+			}
+
+			return result;
+		}
+	};
+}
@@ -0,0 +1,296 @@
+#pragma once
+
+#include "bspan.h"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+//
+// Interned names for SVG elements and attributes
+// 
+// Every element tag and attribute name that the library knows about
+// is given a small integer id.  The XML scanner looks the name up once,
+// when it first sees it, so that the rest of the code can switch on an
+// integer rather than compare strings.
+//
+// The lookup table is an open addressing hash table which is built
+// entirely at compile time, so there is no static initialization, and
+// a lookup costs one hash, and typically one memcmp().
+//
+// A name that is not in the table gets SVG_NAME_UNKNOWN, and can still
+// be compared by its string value.
+//
+
+namespace svg2b2d {
+
+    // Keep this in the same order as gSVGNameStrings below
+    enum SVGNameId : uint8_t {
+        SVG_NAME_UNKNOWN = 0
+
+        // elements
+        , SVG_NAME_SVG
+        , SVG_NAME_G
+        , SVG_NAME_DEFS
+        , SVG_NAME_SYMBOL
+        , SVG_NAME_USE
+        , SVG_NAME_PATH
+        , SVG_NAME_RECT
+        , SVG_NAME_CIRCLE
+        , SVG_NAME_ELLIPSE
+        , SVG_NAME_LINE
+        , SVG_NAME_POLYLINE
+        , SVG_NAME_POLYGON
+        , SVG_NAME_IMAGE
+        , SVG_NAME_TEXT
+        , SVG_NAME_TSPAN
+        , SVG_NAME_TEXTPATH
+        , SVG_NAME_STYLE
+        , SVG_NAME_PATTERN
+        , SVG_NAME_LINEARGRADIENT
+        , SVG_NAME_RADIALGRADIENT
+        , SVG_NAME_STOP
+        , SVG_NAME_CLIPPATH
+        , SVG_NAME_MASK
+        , SVG_NAME_MARKER
+        , SVG_NAME_FILTER
+        , SVG_NAME_A
+        , SVG_NAME_SWITCH
+        , SVG_NAME_TITLE
+        , SVG_NAME_DESC
+        , SVG_NAME_METADATA
+        , SVG_NAME_FOREIGNOBJECT
+
+        // attributes, and CSS properties
+        , SVG_NAME_ID
+        , SVG_NAME_CLASS
+        , SVG_NAME_VERSION
+        , SVG_NAME_XMLNS
+        , SVG_NAME_XMLNS_XLINK
+        , SVG_NAME_X
+        , SVG_NAME_Y
+        , SVG_NAME_X1
+        , SVG_NAME_Y1
+        , SVG_NAME_X2
+        , SVG_NAME_Y2
+        , SVG_NAME_CX
+        , SVG_NAME_CY
+        , SVG_NAME_R
+        , SVG_NAME_RX
+        , SVG_NAME_RY
+        , SVG_NAME_FX
+        , SVG_NAME_FY
+        , SVG_NAME_DX
+        , SVG_NAME_DY
+        , SVG_NAME_WIDTH
+        , SVG_NAME_HEIGHT
+        , SVG_NAME_D
+        , SVG_NAME_POINTS
+        , SVG_NAME_HREF
+        , SVG_NAME_XLINK_HREF
+        , SVG_NAME_VIEWBOX
+        , SVG_NAME_PRESERVEASPECTRATIO
+        , SVG_NAME_TRANSFORM
+        , SVG_NAME_GRADIENTTRANSFORM
+        , SVG_NAME_PATTERNTRANSFORM
+        , SVG_NAME_GRADIENTUNITS
+        , SVG_NAME_PATTERNUNITS
+        , SVG_NAME_SPREADMETHOD
+        , SVG_NAME_OFFSET
+        , SVG_NAME_STOP_COLOR
+        , SVG_NAME_STOP_OPACITY
+        , SVG_NAME_COLOR
+        , SVG_NAME_FILL
+        , SVG_NAME_FILL_OPACITY
+        , SVG_NAME_FILL_RULE
+        , SVG_NAME_STROKE
+        , SVG_NAME_STROKE_WIDTH
+        , SVG_NAME_STROKE_OPACITY
+        , SVG_NAME_STROKE_LINEJOIN
+        , SVG_NAME_STROKE_LINECAP
+        , SVG_NAME_STROKE_MITERLIMIT
+        , SVG_NAME_STROKE_DASHARRAY
+        , SVG_NAME_STROKE_DASHOFFSET
+        , SVG_NAME_OPACITY
+        , SVG_NAME_DISPLAY
+        , SVG_NAME_VISIBILITY
+        , SVG_NAME_CLIP_PATH
+        , SVG_NAME_CLIP_RULE
+        , SVG_NAME_FONT_FAMILY
+        , SVG_NAME_FONT_SIZE
+        , SVG_NAME_FONT_STYLE
+        , SVG_NAME_FONT_WEIGHT
+        , SVG_NAME_TEXT_ANCHOR
+        , SVG_NAME_TEXT_ALIGN
+
+        , SVG_NAME_COUNT
+    };
+
+    static constexpr std::string_view gSVGNameStrings[] = {
+        ""
+
+        // elements
+        , "svg"
+        , "g"
+        , "defs"
+        , "symbol"
+        , "use"
+        , "path"
+        , "rect"
+        , "circle"
+        , "ellipse"
+        , "line"
+        , "polyline"
+        , "polygon"
+        , "image"
+        , "text"
+        , "tspan"
+        , "textPath"
+        , "style"
+        , "pattern"
+        , "linearGradient"
+        , "radialGradient"
+        , "stop"
+        , "clipPath"
+        , "mask"
+        , "marker"
+        , "filter"
+        , "a"
+        , "switch"
+        , "title"
+        , "desc"
+        , "metadata"
+        , "foreignObject"
+
+        // attributes, and CSS properties
+        , "id"
+        , "class"
+        , "version"
+        , "xmlns"
+        , "xmlns:xlink"
+        , "x"
+        , "y"
+        , "x1"
+        , "y1"
+        , "x2"
+        , "y2"
+        , "cx"
+        , "cy"
+        , "r"
+        , "rx"
+        , "ry"
+        , "fx"
+        , "fy"
+        , "dx"
+        , "dy"
+        , "width"
+        , "height"
+        , "d"
+        , "points"
+        , "href"
+        , "xlink:href"
+        , "viewBox"
+        , "preserveAspectRatio"
+        , "transform"
+        , "gradientTransform"
+        , "patternTransform"
+        , "gradientUnits"
+        , "patternUnits"
+        , "spreadMethod"
+        , "offset"
+        , "stop-color"
+        , "stop-opacity"
+        , "color"
+        , "fill"
+        , "fill-opacity"
+        , "fill-rule"
+        , "stroke"
+        , "stroke-width"
+        , "stroke-opacity"
+        , "stroke-linejoin"
+        , "stroke-linecap"
+        , "stroke-miterlimit"
+        , "stroke-dasharray"
+        , "stroke-dashoffset"
+        , "opacity"
+        , "display"
+        , "visibility"
+        , "clip-path"
+        , "clip-rule"
+        , "font-family"
+        , "font-size"
+        , "font-style"
+        , "font-weight"
+        , "text-anchor"
+        , "text-align"
+    };
+
+    static_assert(sizeof(gSVGNameStrings) / sizeof(gSVGNameStrings[0]) == SVG_NAME_COUNT, "gSVGNameStrings must match SVGNameId");
+
+
+    // FNV-1a hash, usable both at compile time, and on a ByteSpan at runtime
+    template <typename CharT>
+    static constexpr uint32_t svg_name_hash(const CharT* s, size_t len) noexcept
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++)
+        {
+            h ^= (uint8_t)s[i];
+            h *= 16777619u;
+        }
+
+        return h;
+    }
+
+    static constexpr size_t kSVGNameTableSize = 256;     // must be a power of 2
+    static_assert(SVG_NAME_COUNT * 2 <= kSVGNameTableSize, "SVG name table is too full, make it bigger");
+
+    // Build the hash table, using linear probing
+    // Each slot holds a name id, where 0 (SVG_NAME_UNKNOWN) marks an empty slot
+    static constexpr std::array<uint8_t, kSVGNameTableSize> buildSVGNameTable() noexcept
+    {
+        std::array<uint8_t, kSVGNameTableSize> table{};
+
+        for (size_t id = 1; id < SVG_NAME_COUNT; id++)
+        {
+            auto& name = gSVGNameStrings[id];
+            size_t slot = svg_name_hash(name.data(), name.size()) & (kSVGNameTableSize - 1);
+            while (table[slot] != SVG_NAME_UNKNOWN)
+                slot = (slot + 1) & (kSVGNameTableSize - 1);
+
+            table[slot] = (uint8_t)id;
+        }
+
+        return table;
+    }
+
+    static constexpr std::array<uint8_t, kSVGNameTableSize> gSVGNameTable = buildSVGNameTable();
+
+
+    // Return the id of a name, or SVG_NAME_UNKNOWN
+    static inline SVGNameId svgNameId(const ByteSpan& name) noexcept
+    {
+        size_t len = name.size();
+        if (len == 0)
+            return SVG_NAME_UNKNOWN;
+
+        size_t slot = svg_name_hash(name.fStart, len) & (kSVGNameTableSize - 1);
+        while (gSVGNameTable[slot] != SVG_NAME_UNKNOWN)
+        {
+            uint8_t id = gSVGNameTable[slot];
+            auto& candidate = gSVGNameStrings[id];
+            if (candidate.size() == len && memcmp(candidate.data(), name.fStart, len) == 0)
+                return (SVGNameId)id;
+
+            slot = (slot + 1) & (kSVGNameTableSize - 1);
+        }
+
+        return SVG_NAME_UNKNOWN;
+    }
+
+    // Return the string form of a name id
+    static constexpr std::string_view svgNameString(SVGNameId id) noexcept
+    {
+        return id < SVG_NAME_COUNT ? gSVGNameStrings[id] : gSVGNameStrings[SVG_NAME_UNKNOWN];
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "bspanutil.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+//
+// SVGNodeIndex
+// The nodes of a document that have an id, for looking up references
+// (url(#id), href="#id").  It's an open addressing hash table, with
+// linear probing, keyed by the id.  The keys are stored as strings,
+// but looked up by ByteSpan, straight out of the attribute that makes
+// the reference, so a lookup never allocates.  A lookup that misses
+// does not change the table.
+//
+namespace svg2b2d {
+
+	struct SVGObject;
+
+	struct SVGNodeIndex
+	{
+		struct Slot
+		{
+			uint64_t fHash{ 0 };
+			std::string fKey{};
+			std::shared_ptr<SVGObject> fNode{};
+		};
+
+		std::vector<Slot> fSlots{};
+		size_t fCount{ 0 };
+
+		size_t size() const { return fCount; }
+		bool empty() const { return fCount == 0; }
+
+		void clear()
+		{
+			fSlots.clear();
+			fCount = 0;
+		}
+
+		// Returns nullptr if there's nothing with that id
+		std::shared_ptr<SVGObject> find(const ByteSpan& key) const
+		{
+			if (fCount == 0 || !key)
+				return nullptr;
+
+			uint64_t hash = svg_hash64(key);
+			size_t mask = fSlots.size() - 1;
+			for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask)
+			{
+				const Slot& slot = fSlots[i];
+				if (slot.fNode == nullptr)
+					return nullptr;
+
+				if (slot.fHash == hash && matches(slot, key))
+					return slot.fNode;
+			}
+		}
+
+		// Add the node, replacing whatever had the same id
+		void insert(const ByteSpan& key, std::shared_ptr<SVGObject> node)
+		{
+			if (!key || node == nullptr)
+				return;
+
+			// Stay under 3/4 full, so probe runs stay short
+			if ((fCount + 1) * 4 > fSlots.size() * 3)
+				grow();
+
+			uint64_t hash = svg_hash64(key);
+			Slot* slot = probe(hash, key);
+			if (slot->fNode == nullptr)
+			{
+				slot->fHash = hash;
+				slot->fKey.assign((const char*)key.fStart, key.size());
+				fCount++;
+			}
+
+			slot->fNode = std::move(node);
+		}
+
+		// Add everything from 'other', replacing what has the same id
+		void insertAll(const SVGNodeIndex& other)
+		{
+			for (const auto& slot : other.fSlots)
+			{
+				if (slot.fNode != nullptr)
+					insert(ByteSpan(slot.fKey.data(), slot.fKey.size()), slot.fNode);
+			}
+		}
+
+		// Call fn(node) for every node in the index
+		template <typename FN>
+		void forEach(FN&& fn) const
+		{
+			for (const auto& slot : fSlots)
+			{
+				if (slot.fNode != nullptr)
+					fn(slot.fNode);
+			}
+		}
+
+	private:
+		static bool matches(const Slot& slot, const ByteSpan& key)
+		{
+			return (slot.fKey.size() == key.size()) && (memcmp(slot.fKey.data(), key.fStart, key.size()) == 0);
+		}
+
+		// The slot holding the key, or the empty one it would go in
+		Slot* probe(uint64_t hash, const ByteSpan& key)
+		{
+			size_t mask = fSlots.size() - 1;
+			for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask)
+			{
+				Slot& slot = fSlots[i];
+				if (slot.fNode == nullptr || (slot.fHash == hash && matches(slot, key)))
+					return &slot;
+			}
+		}
+
+		void grow()
+		{
+			std::vector<Slot> old = std::move(fSlots);
+			fSlots.clear();
+			fSlots.resize(old.empty() ? 16 : old.size() * 2);
+
+			size_t mask = fSlots.size() - 1;
+			for (auto& from : old)
+			{
+				if (from.fNode == nullptr)
+					continue;
+
+				size_t i = (size_t)from.fHash & mask;
+				while (fSlots[i].fNode != nullptr)
+					i = (i + 1) & mask;
+
+				fSlots[i] = std::move(from);
+			}
+		}
+	};
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "svgshapes.h"
+
+//
+// SVGSession
+// For rendering a stream of documents, one after the other.
+// Everything that parseSVG() sets up for every call, is set up once,
+// and reset between documents instead:
+//   - the pixel buffer, allocated up front at a configured maximum size
+//   - the rendering context, which stays attached as long as
+//     consecutive documents are the same size
+//   - the document, and the XML iterator, with its element storage
+//   - the node arena of the document, which is released, not freed
+//
+// Documents that are not larger than the configured size are rendered
+// without touching the pixel buffer allocation.  A larger document grows
+// the buffer once, and it stays that size from then on.
+//
+namespace svg2b2d {
+
+	struct SVGSessionOptions
+	{
+		int fMaxWidth{ 512 };       // size of pixel buffer allocated up front
+		int fMaxHeight{ 512 };
+		uint32_t fThreadCount{ 0 }; // same meaning as BLContextCreateInfo::threadCount
+		SVGLoadOptions fLoadOptions{ true };	// nodes come from the document arena, reset per document
+	};
+
+	struct SVGSession
+	{
+		SVGSessionOptions fOptions{};
+
+		BLImage fStorage{};         // pixel buffer, fMaxWidth X fMaxHeight
+		BLImage fImage{};           // view of fStorage, the size of the current document
+		SVGRenderer fContext{};
+		bool fAttached{ false };
+
+		SVGDocument fDocument{};
+		XmlElementIterator fIterator{ ByteSpan{} };
+
+		SVGSession(const SVGSessionOptions& options = SVGSessionOptions{})
+			: fOptions(options)
+			, fDocument(options.fLoadOptions)
+		{
+			fStorage.create(fOptions.fMaxWidth, fOptions.fMaxHeight, BL_FORMAT_PRGB32);
+		}
+
+		~SVGSession()
+		{
+			detach();
+		}
+
+		SVGSession(const SVGSession&) = delete;
+		SVGSession& operator=(const SVGSession&) = delete;
+
+		// The most recently rendered image
+		// It is owned by the session, and valid until the next render()
+		const BLImage& image() const { return fImage; }
+		SVGDocument& document() { return fDocument; }
+
+		// Parse the data, and render it
+		// Returns nullptr if the data did not contain a document
+		const BLImage* render(const void* bytes, const size_t sz)
+		{
+			fDocument.clear();
+			fIterator.restart(ByteSpan(bytes, sz));
+			fDocument.loadFromIterator(fIterator);
+
+			if (fDocument.fRootNode == nullptr)
+				return nullptr;
+
+			if (!prepareTarget((int)fDocument.width(), (int)fDocument.height()))
+				return nullptr;
+
+			// Back to the state the context had right after begin()
+			fContext.restore();
+			fContext.save();
+
+			fContext.clearAll();
+			fDocument.draw(fContext);
+			fContext.flush(BL_CONTEXT_FLUSH_SYNC);
+
+			return &fImage;
+		}
+
+	private:
+		void detach()
+		{
+			if (fAttached)
+			{
+				fContext.end();
+				fAttached = false;
+			}
+		}
+
+		// Make fImage a w X h view of the storage, and attach
+		// the context to it.  Nothing happens if it already is.
+		bool prepareTarget(int w, int h)
+		{
+			if (w <= 0 || h <= 0)
+				return false;
+
+			if (fAttached && fImage.width() == w && fImage.height() == h)
+				return true;
+
+			detach();
+
+			// Only grow the storage when a document doesn't fit
+			if (w > fStorage.width() || h > fStorage.height())
+			{
+				int newW = w > fStorage.width() ? w : fStorage.width();
+				int newH = h > fStorage.height() ? h : fStorage.height();
+				if (fStorage.create(newW, newH, BL_FORMAT_PRGB32) != BL_SUCCESS)
+					return false;
+			}
+
+			BLImageData data{};
+			if (fStorage.getData(&data) != BL_SUCCESS)
+				return false;
+
+			if (fImage.createFromData(w, h, BL_FORMAT_PRGB32, data.pixelData, data.stride) != BL_SUCCESS)
+				return false;
+
+			BLContextCreateInfo createInfo{};
+			createInfo.threadCount = fOptions.fThreadCount;
+			if (fContext.begin(fImage, createInfo) != BL_SUCCESS)
+				return false;
+
+			// Keep the initial state, so it can be restored for each document
+			fContext.save();
+			fAttached = true;
+
+			return true;
+		}
+	};
+}
@@ -2,13 +2,28 @@
 
 
 #include "svgtypes.h"
+#include "svgstyle.h"
+#include "svgdisplaylist.h"
+#include "svgbinary.h"
 #include "base64.h"
 #include "parseblpath.h"
 #include "xmlutil.h"
+#include "mmap.h"
+#include "svgimagecache.h"
+#include "svgthreadpool.h"
+#include "svgnodeindex.h"
+#include "svginstance.h"
+#include "svgstrokecache.h"
+#include "svglod.h"
+#include "svgfontcache.h"
+#include "svglayer.h"
 
 #include <string>
 #include <array>
 #include <functional>
+#include <algorithm>
+#include <future>
+#include <mutex>
 
 
 // Shape Common Attributes
@@ -26,25 +41,6 @@ namespace svg2b2d {
 	// filter
 	// clip-path
 	// mask
-	
-	static std::map<std::string, std::function<std::shared_ptr<SVGVisualProperty> (IMapSVGNodes *root, const std::string& , const XmlElement& )>> gSVGPropertyCreation = {
-//		,{"color", [](IMapSVGNodes *root, const std::string& name, const XmlElement& elem) {return SVGPaint::createFromXml(root, "stroke", elem); } }
-		{"fill", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem) {return SVGPaint::createFromXml(root, "fill", elem ); } }
-		,{"fill-rule", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem) {return SVGFillRule::createFromXml(root, "fill-rule", elem); } }
-		,{"font-size", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem) {return SVGFontSize::createFromXml(root, "font-size", elem); } }
-		//,{"stop-color", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem) {return SVGPaint::createFromXml(root, "stop-color", elem); } }
-		,{"opacity", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem) {return SVGOpacity::createFromXml(root, "opacity", elem); } }
-		,{"stroke", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem ) {return SVGPaint::createFromXml(root, "stroke", elem); } }
-		,{"stroke-linejoin", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem) {return SVGStrokeLineJoin::createFromXml(root, "stroke-linejoin", elem); } }
-		,{"stroke-linecap", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem ) {return SVGStrokeLineCap::createFromXml(root, "stroke-linecap", elem); } }
-		,{"stroke-miterlimit", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem ) {return SVGStrokeMiterLimit::createFromXml(root, "stroke-miterlimit", elem); } }
-		,{"stroke-width", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem ) {return SVGStrokeWidth::createFromXml(root, "stroke-width", elem); } }
-		//,{"text-align", [](IMapSVGNodes *root, const std::string& name, const XmlElement& elem) {return SVGTextAlign::createFromXml(root, "text-align", elem); } }
-		,{"text-anchor", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem) {return SVGTextAnchor::createFromXml(root, "text-anchor", elem); } }
-		,{"transform", [](IMapSVGNodes* root, const std::string& name, const XmlElement& elem) {return SVGTransform::createFromXml(root, "transform", elem); } }
-		//,{"gradientTransform", [](IMapSVGNodes *root, const std::string& name, const XmlElement& elem) {return SVGTransform::createFromXml(root, "gradientTransform", elem); } }
-
-	};
 
 
 	//
@@ -57,7 +53,11 @@ namespace svg2b2d {
 	{
 
 		std::string fId{};      // The id of the element
-		std::map<std::string, std::shared_ptr<SVGVisualProperty>> fVisualProperties{};
+		SVGStyle fStyle{};		// resolved styling attributes
+
+		// Whether drawing the node changes the state of the context,
+		// so it has to be bracketed with save()/restore()
+		bool fChangesState{ true };
 
 		SVGVisualNode() = default;
 		SVGVisualNode(IMapSVGNodes* root)
@@ -68,94 +68,95 @@ namespace svg2b2d {
 		SVGVisualNode(const SVGVisualNode& other) :SVGObject(other)
 		{
 			fId = other.fId;
-			fVisualProperties = other.fVisualProperties;
+			fStyle = other.fStyle;
+			fChangesState = other.fChangesState;
 		}
 
 
 		SVGVisualNode & operator=(const SVGVisualNode& rhs)
 		{
 			fId = rhs.fId;
-			fVisualProperties = rhs.fVisualProperties;
+			fStyle = rhs.fStyle;
+			fChangesState = rhs.fChangesState;
 			
 			return *this;
 		}
 		
 		const std::string& id() const { return fId; }
 		void setId(const std::string& id) { fId = id; }
-		
-		void loadVisualProperties(const XmlElement& elem)
-		{
-			// Run Through the property creation routines, generating
-			// properties for the ones we find in the XmlElement
-			for (auto& propconv : gSVGPropertyCreation)
-			{
-				// get the named attribute
-				auto attrName = propconv.first;
 
-				// We have a property and value, convert to SVGVisibleProperty
-				// and add it to our map of visual properties
-				auto prop = propconv.second(root(), attrName, elem);
-				if (prop->isSet())
-					fVisualProperties[attrName] = prop;
+		void addMemoryUsage(SVGMemoryUsage& usage) const override
+		{
+			SVGObject::addMemoryUsage(usage);
+			usage.fStrings += SVGMemoryUsage::stringBytes(fId);
+		}
 
-			}
+		void shrink() override
+		{
+			SVGObject::shrink();
+			fId.shrink_to_fit();
 		}
+		
+		const SVGStyle& style() const { return fStyle; }
 
 		void setCommonVisualProperties(const XmlElement &elem)
 		{
 			// load the common stuff that doesn't require
 			// any additional processing
-			loadVisualProperties(elem);
+			fStyle.loadFromXmlElement(root(), elem);
 
-			// Handle the style attribute separately by turning
-			// it into a standalone XmlElement, and then loading
-			// that like a normal element, by running through the properties again
-			// It's ok if there were already styles in separate attributes of the
-			// original elem, because anything in the 'style' attribute is supposed
-			// to override whatever was there.
-			auto styleChunk = elem.getAttribute("style");
-
-			if (styleChunk) {
-				// Create an XML Element to hang the style properties on as attributes
-				XmlElement styleElement{};
-
-				// use CSSInlineIterator to iterate through the key value pairs
-				// creating a visual attribute, using the gSVGPropertyCreation map
-				CSSInlineStyleIterator iter(styleChunk);
-
-				while (iter.next())
-				{
-					std::string name = std::string((*iter).first.fStart, (*iter).first.fEnd);
-					if (!name.empty() && (*iter).second)
-					{
-						styleElement.addAttribute(name, (*iter).second);
-					}
-				}
+			// Style sheet rules override the attributes
+			SVGStyleSheet* sheet = (root() != nullptr) ? root()->styleSheet() : nullptr;
+			if (sheet != nullptr && !sheet->empty())
+				fStyle.loadFromStyleSheet(root(), *sheet, elem);
 
-				loadVisualProperties(styleElement);
-			}
+			// Handle the style attribute separately.  Anything in the 
+			// 'style' attribute is supposed to override whatever was 
+			// in separate attributes of the original elem, so those
+			// properties are loaded on top of what's already there.
+			auto styleChunk = elem.getAttribute(SVG_NAME_STYLE);
+			if (styleChunk)
+				fStyle.loadFromStyleAttribute(root(), styleChunk);
 
-			// Deal with any more attributes that need special handling
+			// Fold opacities into the paints, now that all
+			// sources have been seen
+			fStyle.resolve();
 		}
 
 		void loadSelfFromXml(const XmlElement& elem) override
 		{
 			SVGObject::loadSelfFromXml(elem);
 			
-			auto id = elem.getAttribute("id");
+			auto id = elem.getAttribute(SVG_NAME_ID);
 			if (id)
 				setId(std::string(id.fStart, id.fEnd));
 
 			
 			setCommonVisualProperties(elem);
+			updateChangesState();
 		}
 		
+		void resolveReferences() override
+		{
+			fStyle.resolveReferences(root());
+			updateChangesState();
+		}
+
+		// Sub-classes whose drawSelf() leaves the context
+		// the way it found it say so
+		virtual bool drawSelfChangesState() const { return true; }
+
+		// A node with no styling of its own, that draws without
+		// changing anything, doesn't need to save the state at all
+		void updateChangesState()
+		{
+			fChangesState = (fStyle.fSetMask != SVG_STYLE_NONE) || drawSelfChangesState();
+		}
+
 		// Contains styling attributes
 		void applyAttributes(IRender& ctx)
 		{
-			for (auto& prop : fVisualProperties) {
-				prop.second->draw(ctx);
-			}
+			fStyle.apply(ctx);
 		}
 		
 		virtual void drawSelf(IRender& ctx)
@@ -164,8 +165,64 @@ namespace svg2b2d {
 
 		}
 		
+		// Bounds of what the node draws, in its own coordinate space
+		// Sub-classes that know their geometry override this, and
+		// increase strokeScale if they scale their children.
+		virtual BLBox localExtent(double& strokeScale)
+		{
+			return svgBoxUnbounded();
+		}
+
+		void calculateExtent() override
+		{
+			double strokeScale = 1.0;
+			BLBox box = localExtent(strokeScale);
+
+			// Add the stroke this node sets itself
+			// Without a join, or miter limit, assume the largest
+			// reach those could have
+			if (fStyle.isSet(SVG_STYLE_STROKE_WIDTH))
+			{
+				BLStrokeJoin join = fStyle.isSet(SVG_STYLE_STROKE_LINEJOIN) ? fStyle.fStrokeLineJoin : BL_STROKE_JOIN_MITER_CLIP;
+				double miterLimit = fStyle.isSet(SVG_STYLE_STROKE_MITERLIMIT) ? fStyle.fStrokeMiterLimit : 10.0;
+				box = svgBoxInflate(box, svgStrokeReach(fStyle.fStrokeWidth, join, miterLimit) * strokeScale);
+			}
+
+			if (fStyle.isSet(SVG_STYLE_TRANSFORM))
+			{
+				box = svgBoxTransform(box, fStyle.fTransform);
+				strokeScale *= svgMatrixMaxScale(fStyle.fTransform);
+			}
+
+			fExtent = box;
+			fExtentStrokeScale = strokeScale;
+		}
+
+		// True if nothing the node draws can be seen by the context
+		// The context's current stroke is what the node will inherit
+		bool isCulled(IRender& ctx)
+		{
+			if (!ctx.culling())
+				return false;
+
+			const BLBox& box = extent();
+			if (svgBoxIsUnbounded(box))
+				return false;
+
+			return !ctx.isBoxVisible(svgBoxInflate(box, ctx.strokeReach() * fExtentStrokeScale));
+		}
+
 		void draw(IRender& ctx) override
 		{
+			if (isCulled(ctx))
+				return;
+
+			if (!fChangesState)
+			{
+				drawSelf(ctx);
+				return;
+			}
+
 			ctx.save();
 			
 			applyAttributes(ctx);
@@ -174,6 +231,31 @@ namespace svg2b2d {
 
 			ctx.restore();
 		}
+
+		// Sub-classes override this to record whatever
+		// they would have drawn in drawSelf()
+		virtual void compileSelf(SVGDisplayListBuilder& builder)
+		{
+			;
+		}
+
+		// Mirror of draw(), against the display list builder
+		void compile(SVGDisplayListBuilder& builder) override
+		{
+			if (!fChangesState)
+			{
+				compileSelf(builder);
+				return;
+			}
+
+			builder.save();
+
+			fStyle.apply(builder);
+
+			compileSelf(builder);
+
+			builder.restore();
+		}
 	};
 	
 	struct SVGShape : public SVGVisualNode
@@ -219,16 +301,21 @@ namespace svg2b2d {
 			return fWrappedNode->getVariant();
 		}
 		
-		void setRoot(IMapSVGNodes* root) override
+		// Looked up once the whole document has been loaded, so it's
+		// found no matter where it is, or which part of a parallel
+		// load it was in
+		void resolveReferences() override
 		{
-			SVGShape::setRoot(root);
+			SVGShape::resolveReferences();
 
-			// Use the root to lookup the wrapped node
-			if (root != nullptr && !fWrappedID.empty())
-			{
-				fWrappedNode = root->findNodeById(fWrappedID);
-			}
+			if (fWrappedNode == nullptr && root() != nullptr && !fWrappedID.empty())
+				fWrappedNode = root()->findNodeById(ByteSpan(fWrappedID.data(), fWrappedID.size()));
 
+			// Every <use> of the same node shares its instance cache
+			// References are resolved by one thread, after loading, 
+			// so nothing else is looking at the node.
+			if (fWrappedNode != nullptr && fWrappedNode->fInstances == nullptr)
+				fWrappedNode->fInstances = std::make_shared<SVGInstanceCache>();
 		}
 
 		void drawSelf(IRender& ctx) override
@@ -240,9 +327,38 @@ namespace svg2b2d {
 			// Apply locally generated attributes
 			ctx.translate(fX, fY);
 			
-			// Draw the wrapped graphic
+			// Draw the wrapped graphic, from the instance cache
+			// when it has been drawn before
+			if (fWrappedNode->fInstances != nullptr && fWrappedNode->fInstances->draw(ctx, *fWrappedNode))
+				return;
+
 			fWrappedNode->draw(ctx);
 		}
+
+		bool drawsLayers() override
+		{
+			return fWrappedNode != nullptr && fWrappedNode->drawsLayers();
+		}
+
+		void compileSelf(SVGDisplayListBuilder& builder) override
+		{
+			if (fWrappedNode == nullptr)
+				return;
+
+			builder.translate(fX, fY);
+			fWrappedNode->compile(builder);
+		}
+
+		BLBox localExtent(double& strokeScale) override
+		{
+			if (fWrappedNode == nullptr)
+				return svgBoxEmpty();
+
+			BLBox box = fWrappedNode->extent();
+			strokeScale = fWrappedNode->fExtentStrokeScale;
+
+			return svgBoxTransform(box, BLMatrix2D::makeTranslation(fX, fY));
+		}
 		
 		void loadSelfFromXml(const XmlElement& elem) override
 		{
@@ -251,20 +367,19 @@ namespace svg2b2d {
 			SVGShape::loadSelfFromXml(elem);
 
 			// look for the href, or xlink:href attribute
-			auto href = elem.getAttribute("href");
+			auto href = elem.getAttribute(SVG_NAME_HREF);
 			if (!href)
 			{
-				href = chunk_trim(elem.getAttribute("xlink:href"), wspChars);
+				href = chunk_trim(elem.getAttribute(SVG_NAME_XLINK_HREF), wspChars);
 			}
 
 			if (!href)
 				return;
 
-			fX = parseDimension(elem.getAttribute("x")).calculatePixels();
-			fY = parseDimension(elem.getAttribute("y")).calculatePixels();
+			fX = parseDimension(elem.getAttribute(SVG_NAME_X)).calculatePixels();
+			fY = parseDimension(elem.getAttribute(SVG_NAME_Y)).calculatePixels();
 
-			// Use the href to lookup the node in the tree
-			// have to wait for setRoot() to be called before we can do the lookup
+			// Use the href to lookup the node in the tree, once it's all loaded
 			if (*href == '#')
 			{
 				href++;
@@ -277,7 +392,7 @@ namespace svg2b2d {
 
 		static std::shared_ptr<SVGTemplateNode> createFromXml(IMapSVGNodes* iMap, const XmlElement& elem)
 		{
-			auto shape = std::make_shared<SVGTemplateNode>(iMap);
+			auto shape = makeNode<SVGTemplateNode>(iMap);
 			shape->loadFromXmlElement(elem);
 
 			return shape;
@@ -289,15 +404,179 @@ namespace svg2b2d {
 	struct SVGPathBasedShape : public SVGShape
 	{
 		BLPath fPath{};
+
+		// Geometry data (a 'd', or 'points' attribute) that has not been
+		// parsed into fPath yet.  Only used when the document is loaded
+		// with fLazyPaths.  It points into the source data.
+		ByteSpan fPendingData{};
+
+		// Only when the document is loaded with fCacheStrokes
+		std::shared_ptr<SVGStrokeCache> fStrokeCache{};
+
+		// Only for shapes with enough geometry to be worth simplifying,
+		// made the first time one is drawn at a level of detail, so
+		// documents drawn at full detail don't pay for it
+		bool fLodWorthwhile{ false };
+		std::once_flag fLodOnce{};
+		std::shared_ptr<SVGLodCache> fLodCache{};
 		
 		SVGPathBasedShape() :SVGShape() {}
 		SVGPathBasedShape(IMapSVGNodes* iMap) :SVGShape(iMap) {}
 		
+		// Either parse the geometry data now, or hold onto it, 
+		// to be parsed the first time the path is needed
+		void loadGeometry(const ByteSpan& data)
+		{
+			fLodWorthwhile = data.size() >= SVGLodCache::kMinDataBytes;
+
+			if (fRoot != nullptr && fRoot->loadOptions().fLazyPaths)
+			{
+				fPendingData = data;
+				return;
+			}
+
+			parseGeometry(data);
+			SVG_STATS(countSegments());
+		}
+
+#if defined(SVG_ENABLE_STATS)
+		// Every line, curve, and close of the path is a segment,
+		// and ends at an 'on' point, or is a close
+		void countSegments()
+		{
+			const uint8_t* cmd = fPath.commandData();
+			const uint8_t* end = cmd + fPath.size();
+			uint64_t segments = 0;
+			for (; cmd < end; cmd++)
+			{
+				if (*cmd == BL_PATH_CMD_ON || *cmd == BL_PATH_CMD_CLOSE)
+					segments++;
+			}
+
+			svgCount(fRoot, &SVGStats::fPathSegments, segments);
+		}
+#endif
+
+		void loadSelfFromXml(const XmlElement& elem) override
+		{
+			SVGShape::loadSelfFromXml(elem);
+
+			if (fRoot != nullptr && fRoot->loadOptions().fCacheStrokes)
+				fStrokeCache = std::make_shared<SVGStrokeCache>();
+		}
+
+		// The caches are shared by copies of the shape, so
+		// they're counted once, along with the path
+		void addMemoryUsage(SVGMemoryUsage& usage) const override
+		{
+			SVGShape::addMemoryUsage(usage);
+			usage.addPath(fPath);
+
+			if (fStrokeCache != nullptr && usage.first(fStrokeCache.get()))
+			{
+				std::lock_guard<std::mutex> lock(fStrokeCache->fMutex);
+				usage.fCaches += sizeof(SVGStrokeCache) + SVGMemoryUsage::pathBytes(fStrokeCache->fOutline);
+			}
+
+			if (fLodCache != nullptr && usage.first(fLodCache.get()))
+			{
+				std::lock_guard<std::mutex> lock(fLodCache->fMutex);
+				usage.fCaches += sizeof(SVGLodCache) + fLodCache->fEntries.capacity() * sizeof(SVGLodCache::Entry);
+				for (const auto& e : fLodCache->fEntries)
+					usage.fCaches += SVGMemoryUsage::pathBytes(e.fPath);
+			}
+		}
+
+		// A deferred path is parsed now
+		void prepare() override
+		{
+			path();
+			SVGShape::prepare();
+		}
+
+		// Paths are grown as they're parsed, usually to more than
+		// they end up needing
+		void shrink() override
+		{
+			SVGShape::shrink();
+			fPath.shrink();
+		}
+
+		// Turn geometry data into fPath
+		// The shapes that have data to parse override this
+		virtual void parseGeometry(const ByteSpan& data)
+		{
+			;
+		}
+
+		// The geometry of the shape, parsed now if it was deferred
+		const BLPath& path()
+		{
+			if (fPendingData)
+			{
+				ByteSpan data = fPendingData;
+				fPendingData = {};
+				parseGeometry(data);
+				SVG_STATS(countSegments());
+			}
+
+			return fPath;
+		}
 		
 		void drawSelf(IRender &ctx) override
 		{
-			ctx.fillPath(fPath);
-			ctx.strokePath(fPath);
+			// A simplified copy, when drawing at a level of detail
+			BLPath simplified{};
+			const BLPath* drawn = &path();
+			if (fLodWorthwhile && ctx.levelOfDetail() > 0)
+			{
+				std::call_once(fLodOnce, [this]() { fLodCache = std::make_shared<SVGLodCache>(); });
+				simplified = fLodCache->path(ctx, *drawn);
+				drawn = &simplified;
+			}
+			const BLPath& p = *drawn;
+
+			// Skip whatever would draw nothing
+			if (ctx.fillVisible())
+			{
+				ctx.fillPath(p);
+				SVG_STATS(ctx.fDrawStats.fFills++);
+			}
+			else
+			{
+				SVG_STATS(ctx.fDrawStats.fSkippedFills++);
+			}
+
+			if (!ctx.strokeVisible())
+			{
+				SVG_STATS(ctx.fDrawStats.fSkippedStrokes++);
+				return;
+			}
+
+			SVG_STATS(ctx.fDrawStats.fStrokes++);
+			if (fStrokeCache != nullptr && fStrokeCache->stroke(ctx, p))
+				return;
+
+			ctx.strokePath(p);
+		}
+
+		// Filling, and stroking, change nothing
+		bool drawSelfChangesState() const override { return false; }
+
+		void compileSelf(SVGDisplayListBuilder& builder) override
+		{
+			builder.addPath(path());
+		}
+
+		BLBox localExtent(double& strokeScale) override
+		{
+			const BLPath& p = path();
+
+			BLBox box{};
+			if (p.empty() || p.getBoundingBox(&box) != BL_SUCCESS)
+				return svgBoxEmpty();
+
+			return box;
 		}
 	};
 	
@@ -320,17 +599,17 @@ namespace svg2b2d {
 		{
 			SVGPathBasedShape::loadSelfFromXml(elem);
 			
-			fGeometry.x0 = parseDimension(elem.getAttribute("x1")).calculatePixels();
-			fGeometry.y0 = parseDimension(elem.getAttribute("y1")).calculatePixels();
-			fGeometry.x1 = parseDimension(elem.getAttribute("x2")).calculatePixels();
-			fGeometry.y1 = parseDimension(elem.getAttribute("y2")).calculatePixels();
+			fGeometry.x0 = parseDimension(elem.getAttribute(SVG_NAME_X1)).calculatePixels();
+			fGeometry.y0 = parseDimension(elem.getAttribute(SVG_NAME_Y1)).calculatePixels();
+			fGeometry.x1 = parseDimension(elem.getAttribute(SVG_NAME_X2)).calculatePixels();
+			fGeometry.y1 = parseDimension(elem.getAttribute(SVG_NAME_Y2)).calculatePixels();
 
 			fPath.addLine(fGeometry);
 		}
 
 		static std::shared_ptr<SVGLine> createFromXml(IMapSVGNodes *iMap, const XmlElement& elem)
 		{
-			auto shape = std::make_shared<SVGLine>(iMap);
+			auto shape = makeNode<SVGLine>(iMap);
 			shape->loadFromXmlElement(elem);
 
 			return shape;
@@ -350,15 +629,15 @@ namespace svg2b2d {
 		{
 			SVGPathBasedShape::loadSelfFromXml(elem);
 			
-			fGeometry.x = parseDimension(elem.getAttribute("x")).calculatePixels();
-			fGeometry.y = parseDimension(elem.getAttribute("y")).calculatePixels();
-			fGeometry.w = parseDimension(elem.getAttribute("width")).calculatePixels();
-			fGeometry.h = parseDimension(elem.getAttribute("height")).calculatePixels();
+			fGeometry.x = parseDimension(elem.getAttribute(SVG_NAME_X)).calculatePixels();
+			fGeometry.y = parseDimension(elem.getAttribute(SVG_NAME_Y)).calculatePixels();
+			fGeometry.w = parseDimension(elem.getAttribute(SVG_NAME_WIDTH)).calculatePixels();
+			fGeometry.h = parseDimension(elem.getAttribute(SVG_NAME_HEIGHT)).calculatePixels();
 
-			if (elem.getAttribute("rx"))
+			if (elem.getAttribute(SVG_NAME_RX))
 			{
-				fGeometry.rx = parseDimension(elem.getAttribute("rx")).calculatePixels();
-				fGeometry.ry = parseDimension(elem.getAttribute("ry")).calculatePixels();
+				fGeometry.rx = parseDimension(elem.getAttribute(SVG_NAME_RX)).calculatePixels();
+				fGeometry.ry = parseDimension(elem.getAttribute(SVG_NAME_RY)).calculatePixels();
 				fPath.addRoundRect(fGeometry);
 			}
 			else
@@ -369,7 +648,7 @@ namespace svg2b2d {
 		
 		static std::shared_ptr<SVGRect> createFromXml(IMapSVGNodes* iMap, const XmlElement& elem)
 		{
-			auto shape = std::make_shared<SVGRect>(iMap);
+			auto shape = makeNode<SVGRect>(iMap);
 			shape->loadFromXmlElement(elem);
 
 			return shape;
@@ -387,16 +666,16 @@ namespace svg2b2d {
 		{
 			SVGPathBasedShape::loadSelfFromXml(elem);
 			
-			fCircle.cx = parseDimension(elem.getAttribute("cx")).calculatePixels();
-			fCircle.cy = parseDimension(elem.getAttribute("cy")).calculatePixels();
-			fCircle.r = parseDimension(elem.getAttribute("r")).calculatePixels();
+			fCircle.cx = parseDimension(elem.getAttribute(SVG_NAME_CX)).calculatePixels();
+			fCircle.cy = parseDimension(elem.getAttribute(SVG_NAME_CY)).calculatePixels();
+			fCircle.r = parseDimension(elem.getAttribute(SVG_NAME_R)).calculatePixels();
 
 			fPath.addCircle(fCircle);
 		}
 
 		static std::shared_ptr<SVGCircle> createFromXml(IMapSVGNodes* iMap, const XmlElement& elem)
 		{
-			auto shape = std::make_shared<SVGCircle>(iMap);
+			auto shape = makeNode<SVGCircle>(iMap);
 			shape->loadFromXmlElement(elem);
 
 			return shape;
@@ -414,17 +693,17 @@ namespace svg2b2d {
 		{
 			SVGPathBasedShape::loadSelfFromXml(elem);
 			
-			fGeometry.cx = parseDimension(elem.getAttribute("cx")).calculatePixels();
-			fGeometry.cy = parseDimension(elem.getAttribute("cy")).calculatePixels();
-			fGeometry.rx = parseDimension(elem.getAttribute("rx")).calculatePixels();
-			fGeometry.ry = parseDimension(elem.getAttribute("ry")).calculatePixels();
+			fGeometry.cx = parseDimension(elem.getAttribute(SVG_NAME_CX)).calculatePixels();
+			fGeometry.cy = parseDimension(elem.getAttribute(SVG_NAME_CY)).calculatePixels();
+			fGeometry.rx = parseDimension(elem.getAttribute(SVG_NAME_RX)).calculatePixels();
+			fGeometry.ry = parseDimension(elem.getAttribute(SVG_NAME_RY)).calculatePixels();
 
 			fPath.addEllipse(fGeometry);
 		}
 
 		static std::shared_ptr<SVGEllipse> createFromXml(IMapSVGNodes* iMap, const XmlElement& elem)
 		{
-			auto shape = std::make_shared<SVGEllipse>(iMap);
+			auto shape = makeNode<SVGEllipse>(iMap);
 			shape->loadFromXmlElement(elem);
 			
 			return shape;
@@ -441,21 +720,26 @@ namespace svg2b2d {
 		{
 			SVGPathBasedShape::loadSelfFromXml(elem);
 			
-			auto points = elem.getAttribute("points");
+			loadGeometry(elem.getAttribute(SVG_NAME_POINTS));
+		}
+
+		void parseGeometry(const ByteSpan& points) override
+		{
 			auto pts = parsePoints(points);
+			if (pts.empty())
+				return;
 
+			fPath.reserve(fPath.size() + pts.size());
 			fPath.moveTo(pts[0].x, pts[0].y);
 			for (int i = 1; i < pts.size(); i++)
 			{
 				fPath.lineTo(pts[i].x, pts[i].y);
 			}
-
-			
 		}
 
 		static std::shared_ptr<SVGPolyline> createFromXml(IMapSVGNodes* iMap, const XmlElement& elem)
 		{
-			auto shape = std::make_shared<SVGPolyline>(iMap);
+			auto shape = makeNode<SVGPolyline>(iMap);
 			shape->loadFromXmlElement(elem);
 
 			return shape;
@@ -472,21 +756,27 @@ namespace svg2b2d {
 		{
 			SVGPathBasedShape::loadSelfFromXml(elem);
 			
-			auto points = elem.getAttribute("points");
+			loadGeometry(elem.getAttribute(SVG_NAME_POINTS));
+		}
+
+		void parseGeometry(const ByteSpan& points) override
+		{
 			auto pts = parsePoints(points);
+			if (pts.empty())
+				return;
 
+			fPath.reserve(fPath.size() + pts.size() + 1);
 			fPath.moveTo(pts[0]);
 			for (int i = 1; i < pts.size(); i++)
 			{
 				fPath.lineTo(pts[i]);
 			}
 			fPath.close();
-			
 		}
 
 		static std::shared_ptr<SVGPolygon> createFromXml(IMapSVGNodes* iMap, const XmlElement& elem)
 		{
-			auto shape = std::make_shared<SVGPolygon>(iMap);
+			auto shape = makeNode<SVGPolygon>(iMap);
 			shape->loadFromXmlElement(elem);
 
 			return shape;
@@ -503,14 +793,21 @@ namespace svg2b2d {
 		{
 			SVGPathBasedShape::loadSelfFromXml(elem);
 			
-			auto d = elem.getAttribute("d");
+			loadGeometry(elem.getAttribute(SVG_NAME_D));
+		}
+
+		void parseGeometry(const ByteSpan& d) override
+		{
+			if (fRoot != nullptr && fRoot->loadOptions().fReservePaths)
+				fPath.reserve(fPath.size() + estimatePathVertices(d));
+
 			//auto success = blPathFromCommands(d, fPath);
 			auto success = parsePath(d, fPath);
 		}
 
 		static std::shared_ptr<SVGPath> createFromXml(IMapSVGNodes* iMap, const XmlElement& elem)
 		{
-			auto path = std::make_shared<SVGPath>(iMap);
+			auto path = makeNode<SVGPath>(iMap);
 			path->loadFromXmlElement(elem);
 			
 			return path;
@@ -523,7 +820,32 @@ namespace svg2b2d {
 	// href of an <image> tage, or as a lookup for a 
 	// fill, or stroke pain attribute.
 	//
-	bool parseImage(const ByteSpan& inChunk, BLImage& img)
+	// Scale the image down, keeping its aspect, so neither
+	// side is larger than maxSize.  True if it was changed.
+	static inline bool fitImage(BLImage& img, int maxSize)
+	{
+		int w = img.width();
+		int h = img.height();
+		if (maxSize <= 0 || (w <= maxSize && h <= maxSize))
+			return false;
+
+		double s = (double)maxSize / (w > h ? w : h);
+		BLSizeI size((int)(w * s) > 0 ? (int)(w * s) : 1, (int)(h * s) > 0 ? (int)(h * s) : 1);
+
+		BLImage scaled{};
+		if (BLImage::scale(scaled, img, size, BL_IMAGE_SCALE_FILTER_BILINEAR) != BL_SUCCESS)
+			return false;
+
+		img = scaled;
+
+		return true;
+	}
+
+	// Decode a data: URI into an image
+	// With a cache, an image that has been decoded before is
+	// not decoded again, and a newly decoded one is added to it.
+	// With a maxSize, the image is scaled down to fit within it.
+	bool parseImage(const ByteSpan& inChunk, BLImage& img, SVGImageCache* cache = nullptr, int maxSize = 0)
 	{
 		bool success{ false };
 		ByteSpan value = inChunk;
@@ -547,21 +869,27 @@ namespace svg2b2d {
 			}
 			else if ((mime == "image/png") || (mime == "image/jpeg"))
 			{
-				// allocate some memory to decode into
-				uint8_t* outBuff{ new uint8_t[chunk_size(value)]{} };
-				ByteSpan outChunk(outBuff, value.size());	//  = chunk_from_data_size(outBuff, chunk_size(value));
+				uint64_t variant = maxSize > 0 ? (uint64_t)maxSize : 0;
+				if (cache != nullptr && cache->find(value, img, variant))
+					return true;
+
+				// Decode into a buffer that stays around for
+				// the next image loaded on this thread
+				static thread_local std::vector<uint8_t> decodeBuff;
 
-				auto outData = b64tobin(value, outChunk);
+				auto outData = b64decode(value, decodeBuff);
 
 				if (outData)
 				{
 					BLResult res = img.readFromData(outData.fStart, chunk_size(outData));
 					success = (res == BL_SUCCESS);
-					printf("parseImage, readFromData: %d  %dX%d\n", res, img.size().w, img.size().h);
 				}
 
-				delete[] outBuff;
+				if (success)
+					fitImage(img, maxSize);
 
+				if (success && cache != nullptr)
+					cache->add(value, img, variant);
 			}
 		}
 
@@ -571,6 +899,18 @@ namespace svg2b2d {
 	struct SVGImageNode : public SVGShape
 	{
 		BLImage fImage{};
+		std::shared_future<BLImage> fPendingImage{};	// decoding in the background
+
+		// Copies of the image, each half the size of the one before,
+		// made the first time the image is drawn that small.
+		// Shared by copies of the node, and guarded, since a document
+		// can be drawn by several threads at the same time.
+		struct MipLevels
+		{
+			std::mutex fMutex{};
+			std::vector<BLImage> fLevels{};		// [0] is half the size of the image
+		};
+		std::shared_ptr<MipLevels> fMips{ std::make_shared<MipLevels>() };
 		//BLPattern fPattern{};
 		double fWidth{};
 		double fHeight{};
@@ -579,11 +919,13 @@ namespace svg2b2d {
 
 		
 		SVGImageNode(IMapSVGNodes* root) : SVGShape(root) {}
-		SVGImageNode(const SVGImageNode& other) :SVGShape(other) { fImage = other.fImage; fWidth = other.fWidth; fHeight = other.fHeight; }
+		SVGImageNode(const SVGImageNode& other) :SVGShape(other) { fImage = other.fImage; fPendingImage = other.fPendingImage; fMips = other.fMips; fWidth = other.fWidth; fHeight = other.fHeight; }
 		SVGImageNode& operator=(const SVGImageNode& rhs)
 		{
 			//SVGShape::operator=(rhs);
 			fImage = rhs.fImage;
+			fPendingImage = rhs.fPendingImage;
+			fMips = rhs.fMips;
 			fWidth = rhs.fWidth;
 			fHeight = rhs.fHeight;
 
@@ -594,21 +936,127 @@ namespace svg2b2d {
 		{
 			if (fVar.isNull())
 			{
-				blVarAssignWeak(&fVar, &fImage);
+				blVarAssignWeak(&fVar, &image());
 			}
 
 			return fVar;
 		}
+
+		// Waits for a background decode, if there is one
+		void prepare() override
+		{
+			getVariant();
+			SVGShape::prepare();
+		}
+
+		// The decoded pixels
+		// If the image is being decoded in the background, this waits
+		// for it to finish.  Nothing is modified, so any number of 
+		// threads can wait on it at the same time.
+		const BLImage& image() const
+		{
+			if (fPendingImage.valid())
+				return fPendingImage.get();
+
+			return fImage;
+		}
+
+		// Whether there is, or will be, an image
+		bool hasImage() const { return fPendingImage.valid() || !fImage.empty(); }
+
+		// An image still decoding isn't waited for, or counted
+		void addMemoryUsage(SVGMemoryUsage& usage) const override
+		{
+			SVGShape::addMemoryUsage(usage);
+
+			if (!fPendingImage.valid())
+				usage.addImage(fImage);
+			else if (fPendingImage.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+				usage.addImage(fPendingImage.get());
+
+			if (fMips != nullptr && usage.first(fMips.get()))
+			{
+				std::lock_guard<std::mutex> lock(fMips->fMutex);
+				for (const auto& level : fMips->fLevels)
+					usage.addImage(level);
+			}
+		}
+
+		// The smallest version of the image that still has at least 
+		// one pixel for every device pixel it covers, w X h
+		// A downscaled blit samples a fraction of the pixels, so
+		// drawing from this also looks better.
+		BLImage imageForSize(double w, double h)
+		{
+			const BLImage& img = image();
+			if (img.empty() || fMips == nullptr)
+				return img;
+
+			int level = 0;
+			int lw = img.width();
+			int lh = img.height();
+			while ((lw / 2 >= w) && (lh / 2 >= h) && (lw > 1) && (lh > 1))
+			{
+				lw /= 2;
+				lh /= 2;
+				level++;
+			}
+
+			if (level == 0)
+				return img;
+
+			std::lock_guard<std::mutex> lock(fMips->fMutex);
+			auto& levels = fMips->fLevels;
+			while ((int)levels.size() < level)
+			{
+				const BLImage& from = levels.empty() ? img : levels.back();
+				BLSizeI size(from.width() / 2, from.height() / 2);
+
+				BLImage scaled{};
+				if (BLImage::scale(scaled, from, size, BL_IMAGE_SCALE_FILTER_BILINEAR) != BL_SUCCESS)
+					return levels.empty() ? img : levels.back();
+
+				levels.push_back(scaled);
+			}
+
+			return levels[level - 1];
+		}
 		
 		void drawSelf(IRender& ctx)
 		{
-			if (fImage.empty())
+			if (!hasImage())
+				return;
+
+			BLPoint scale = ctx.deviceScale();
+			BLImage img = imageForSize(fWidth * scale.x, fHeight * scale.y);
+			if (img.empty())
 				return;
 			
 			BLRect dst{ fX,fY,fWidth,fHeight };
-			BLRectI srcArea{ (int)0,(int)0,(int)fImage.size().w,fImage.size().h };
+			BLRectI srcArea{ (int)0,(int)0,(int)img.size().w,img.size().h };
+
+			ctx.blitImage(dst, img, srcArea);
+		}
+
+		bool drawSelfChangesState() const override { return false; }
+
+		void compileSelf(SVGDisplayListBuilder& builder) override
+		{
+			const BLImage& img = image();
+
+			BLRect dst{ fX,fY,fWidth,fHeight };
+			BLRectI srcArea{ (int)0,(int)0,(int)img.size().w,img.size().h };
+
+			builder.addImage(img, dst, srcArea);
+		}
+
+		// Doesn't need the pixels, so it doesn't wait for them
+		BLBox localExtent(double& strokeScale) override
+		{
+			if (!hasImage())
+				return svgBoxEmpty();
 
-			ctx.blitImage(dst, fImage, srcArea);
+			return BLBox(fX, fY, fX + fWidth, fY + fHeight);
 		}
 
 		void loadSelfFromXml(const XmlElement& elem) override
@@ -616,11 +1064,11 @@ namespace svg2b2d {
 			SVGShape::loadSelfFromXml(elem);
 
 			// Specify the size at which things are displayed
-			fWidth = parseDimension(elem.getAttribute("width")).calculatePixels(96);
-			fHeight = parseDimension(elem.getAttribute("height")).calculatePixels(96);
+			fWidth = parseDimension(elem.getAttribute(SVG_NAME_WIDTH)).calculatePixels(96);
+			fHeight = parseDimension(elem.getAttribute(SVG_NAME_HEIGHT)).calculatePixels(96);
 
-			fX = parseDimension(elem.getAttribute("x")).calculatePixels(96);
-			fY = parseDimension(elem.getAttribute("y")).calculatePixels(96);
+			fX = parseDimension(elem.getAttribute(SVG_NAME_X)).calculatePixels(96);
+			fY = parseDimension(elem.getAttribute(SVG_NAME_Y)).calculatePixels(96);
 			
 			// docode and load the image
 			//fImage.create(fWidth, fHeight, BL_FORMAT_PRGB32);
@@ -630,19 +1078,40 @@ namespace svg2b2d {
 			//fCtx.end();
 
 			//printf("SVGImageNode: %3.0f %3.0f\n", fWidth, fHeight);
-			auto href = elem.getAttribute("xlink:href");
+			auto href = elem.getAttribute(SVG_NAME_XLINK_HREF);
 			if (!href)
-				href = elem.getAttribute("href");
+				href = elem.getAttribute(SVG_NAME_HREF);
 
 			if (!href)
 				return;
 
-			parseImage(href, fImage);
+			SVGImageCache* cache = (root() != nullptr && root()->loadOptions().fCacheImages) ? &SVGImageCache::shared() : nullptr;
+			SVGThreadPool* pool = (root() != nullptr) ? root()->loadOptions().fImagePool : nullptr;
+			int maxSize = (root() != nullptr) ? root()->loadOptions().fMaxImageSize : 0;
+
+			if (pool == nullptr)
+			{
+				parseImage(href, fImage, cache, maxSize);
+				return;
+			}
+
+			// Decode on the pool, while loading carries on.  The task has
+			// its own copy of the encoded data, so it doesn't matter if
+			// the source goes away before it runs.
+			auto task = std::make_shared<std::packaged_task<BLImage()>>(
+				[encoded = std::vector<uint8_t>(href.fStart, href.fEnd), cache, maxSize]() {
+					BLImage img{};
+					parseImage(ByteSpan(encoded.data(), encoded.size()), img, cache, maxSize);
+					return img;
+				});
+
+			fPendingImage = task->get_future().share();
+			pool->submit([task]() { (*task)(); });
 		}
 
 		static std::shared_ptr<SVGImageNode> createFromXml(IMapSVGNodes* iMap, const XmlElement& elem)
 		{
-			auto node = std::make_shared<SVGImageNode>(iMap);
+			auto node = makeNode<SVGImageNode>(iMap);
 			node->loadFromXmlElement(elem);
 
 			return node;
@@ -652,18 +1121,28 @@ namespace svg2b2d {
 
 	
 	
-	std::map<std::string, std::function<std::shared_ptr<SVGShape>(IMapSVGNodes* root, const XmlElement& elem)>> gShapeCreationMap = {
-	{"line", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGLine::createFromXml(root, elem); }},
-	{"rect", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGRect::createFromXml(root, elem); }},
-	{"circle", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGCircle::createFromXml(root,elem); }},
-	{"ellipse", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGEllipse::createFromXml(root,elem); }},
-	{"image", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGImageNode::createFromXml(root,elem); }},
-	{"polyline", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGPolyline::createFromXml(root,elem); }},
-	{"polygon", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGPolygon::createFromXml(root,elem); }},
-	{"path", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGPath::createFromXml(root,elem); }},
-	{"use", [](IMapSVGNodes* root, const XmlElement& elem) { return SVGTemplateNode::createFromXml(root,elem); }},
-
-	};
+	// Create a shape from a self closing element
+	// Dispatch is on the interned name id, so there are no string compares
+	// Returns nullptr if the element is not a shape we know about
+	static std::shared_ptr<SVGShape> createShapeFromXml(IMapSVGNodes* root, const XmlElement& elem)
+	{
+		switch (elem.nameId())
+		{
+		case SVG_NAME_LINE: return SVGLine::createFromXml(root, elem);
+		case SVG_NAME_RECT: return SVGRect::createFromXml(root, elem);
+		case SVG_NAME_CIRCLE: return SVGCircle::createFromXml(root, elem);
+		case SVG_NAME_ELLIPSE: return SVGEllipse::createFromXml(root, elem);
+		case SVG_NAME_IMAGE: return SVGImageNode::createFromXml(root, elem);
+		case SVG_NAME_POLYLINE: return SVGPolyline::createFromXml(root, elem);
+		case SVG_NAME_POLYGON: return SVGPolygon::createFromXml(root, elem);
+		case SVG_NAME_PATH: return SVGPath::createFromXml(root, elem);
+		case SVG_NAME_USE: return SVGTemplateNode::createFromXml(root, elem);
+		default:
+			break;
+		}
+
+		return nullptr;
+	}
 
 
 	struct SVGCompoundNode : public SVGShape
@@ -674,7 +1153,6 @@ namespace svg2b2d {
 		
 		
 		std::vector<std::shared_ptr<SVGObject>> fNodes{};
-		std::map<std::string, std::shared_ptr<SVGObject>> fDefinitions;
 		int buildState = BUILD_STATE_OPEN;
 		
 		SVGCompoundNode() : SVGShape() {}
@@ -708,40 +1186,138 @@ namespace svg2b2d {
 				node->draw(ctx);
 			}
 		}
-		
-		virtual void addNode(std::shared_ptr < SVGVisualNode > node)
-		{
-			if (node == nullptr)
-				return;
 
-			node->setRoot(fRoot);
+		void prepare() override
+		{
+			for (auto& node : fNodes)
+				node->prepare();
 
-			fNodes.push_back(node);
+			SVGShape::prepare();
 		}
-		
-		virtual void loadSelfClosingNode(const XmlElement& elem)
+
+		void addMemoryUsage(SVGMemoryUsage& usage) const override
 		{
-			auto it = gShapeCreationMap.find(elem.name());
-			if (it != gShapeCreationMap.end())
-			{
-				auto node = it->second(root(), elem);
-				addNode(node);
-			}
+			SVGShape::addMemoryUsage(usage);
+			usage.fMaps += fNodes.capacity() * sizeof(std::shared_ptr<SVGObject>);
+
+			for (const auto& node : fNodes)
+				node->memoryUsage(usage);
 		}
-		
-		virtual void loadContentNode(const XmlElement& elem)
+
+		void shrink() override
 		{
-			// Do something with content nodes	
+			SVGShape::shrink();
+			fNodes.shrink_to_fit();
+
+			for (auto& node : fNodes)
+				node->shrink();
 		}
-		
-		virtual void loadCDataNode(const XmlElement& elem)
+
+		// The children look after their own state
+		bool drawSelfChangesState() const override { return false; }
+
+		// With an opacity, the children are drawn into a layer,
+		// and the layer is drawn at the opacity, see SVGLayer.
+		// Otherwise, the opacity becomes the alpha of the fills.
+		void draw(IRender& ctx) override
+		{
+			if (!ctx.layers() || !fStyle.isSet(SVG_STYLE_OPACITY) || fStyle.fOpacity >= 1.0)
+			{
+				SVGShape::draw(ctx);
+				return;
+			}
+
+			if (isCulled(ctx) || fStyle.fOpacity <= 0)
+				return;
+
+			const BLBox& box = extent();
+			SVGLayer layer{};
+			if (svgBoxIsUnbounded(box) || !layer.begin(ctx, svgBoxInflate(box, ctx.strokeReach() * fExtentStrokeScale)))
+			{
+				SVGShape::draw(ctx);
+				return;
+			}
+
+			IRender& lctx = layer.context();
+			fStyle.apply(lctx, SVG_STYLE_OPACITY);
+			drawSelf(lctx);
+
+			layer.end(ctx, fStyle.fOpacity);
+		}
+
+		bool drawsLayers() override
+		{
+			if (fStyle.isSet(SVG_STYLE_OPACITY) && fStyle.fOpacity < 1.0)
+				return true;
+
+			for (auto& node : fNodes)
+			{
+				if (node->drawsLayers())
+					return true;
+			}
+
+			return false;
+		}
+
+		void compileSelf(SVGDisplayListBuilder& builder) override
+		{
+			for (auto& node : fNodes) {
+				node->compile(builder);
+			}
+		}
+
+		void resolveReferences() override
+		{
+			SVGShape::resolveReferences();
+
+			for (auto& node : fNodes)
+				node->resolveReferences();
+		}
+
+		// The union of what the children cover
+		BLBox localExtent(double& strokeScale) override
+		{
+			BLBox box = svgBoxEmpty();
+			for (auto& node : fNodes)
+			{
+				box = svgBoxUnion(box, node->extent());
+				if (node->fExtentStrokeScale > strokeScale)
+					strokeScale = node->fExtentStrokeScale;
+			}
+
+			return box;
+		}
+		
+		virtual void addNode(std::shared_ptr < SVGVisualNode > node)
+		{
+			if (node == nullptr)
+				return;
+
+			node->setRoot(fRoot);
+
+			fNodes.push_back(node);
+		}
+		
+		virtual void loadSelfClosingNode(const XmlElement& elem)
+		{
+			auto node = createShapeFromXml(root(), elem);
+			if (node != nullptr)
+				addNode(node);
+		}
+		
+		virtual void loadContentNode(const XmlElement& elem)
+		{
+			// Do something with content nodes	
+		}
+		
+		virtual void loadCDataNode(const XmlElement& elem)
 		{
 			// Do something with CDATA nodes
 		}
 		
 		virtual void loadCompoundNode(XmlElementIterator& iter)
 		{
-			auto node = std::make_shared<SVGCompoundNode>(fRoot);
+			auto node = makeNode<SVGCompoundNode>(fRoot);
 			node->loadFromIterator(iter);
 			addNode(node);
 		}
@@ -782,10 +1358,12 @@ namespace svg2b2d {
 				case BUILD_STATE_OPEN:
 				{
 					if (elem.isSelfClosing()) {
+						SVG_STATS(svgCount(root(), &SVGStats::fElements));
 						loadSelfClosingNode(elem);
 					}
 					else if (elem.isStart())
 					{
+						SVG_STATS(svgCount(root(), &SVGStats::fElements));
 						loadCompoundNode(iter);
 					}
 					else if (elem.isEnd())
@@ -804,8 +1382,7 @@ namespace svg2b2d {
 					else
 					{
 						// Ignore anything else
-						printf("IGNORING: %s\n", elem.name().c_str());
-						ndt_debug::printXmlElement(elem);
+						SVG_STATS(svgCount(root(), &SVGStats::fIgnoredElements));
 					}
 				}
 				break;
@@ -832,40 +1409,136 @@ namespace svg2b2d {
 		double dy = 0;
 
 		std::string fText;
+
+		// The text shaped with each font it's been drawn with
+		// Shared by copies of the node.
+		std::shared_ptr<SVGGlyphRunCache> fGlyphRuns{};
 		
 		SVGTextNode() :SVGCompoundNode() {}
 		SVGTextNode(IMapSVGNodes* root) :SVGCompoundNode(root) {}
 
+		void addMemoryUsage(SVGMemoryUsage& usage) const override
+		{
+			SVGCompoundNode::addMemoryUsage(usage);
+			usage.fStrings += SVGMemoryUsage::stringBytes(fText);
+
+			if (fGlyphRuns != nullptr && usage.first(fGlyphRuns.get()))
+			{
+				std::lock_guard<std::mutex> lock(fGlyphRuns->fMutex);
+				for (const auto& run : fGlyphRuns->fEntries)
+					usage.fCaches += sizeof(SVGGlyphRun) + run->glyphRun().size * (sizeof(uint32_t) + sizeof(BLGlyphPlacement));
+			}
+		}
+
+		// The font is inherited, and only known when drawing,
+		// so text is never culled
+		BLBox localExtent(double& strokeScale) override
+		{
+			return svgBoxUnbounded();
+		}
+
+		// The text shaped with the font of the state, and where it starts,
+		// moved back along the baseline for the text-anchor
+		template <typename CTX>
+		std::shared_ptr<const SVGGlyphRun> glyphRun(const CTX& ctx, BLPoint& origin) const
+		{
+			if (fGlyphRuns == nullptr)
+				return nullptr;
+
+			const SVGTextState& text = ctx.textState();
+			BLFontFace face = text.fFontFace.empty() ? SVGFontCache::shared().defaultFace() : text.fFontFace;
+			auto run = fGlyphRuns->run(face, (float)text.fFontSize, fText);
+			if (run == nullptr)
+				return nullptr;
+
+			origin = BLPoint(x - run->advance() * text.fTextAnchor, y + dy);
+
+			return run;
+		}
+
 		void drawSelf(IRender& ctx) override
 		{
-			//ctx.textFont("Calibri");	// BUGBUG - hardcoded, should go away when property supported
-			//ctx.text(fText.c_str(), x, y+dy);
+			BLPoint origin{};
+			auto run = glyphRun(ctx, origin);
+			if (run != nullptr)
+			{
+				if (ctx.fillVisible())
+				{
+					ctx.fillGlyphRun(origin, run->fFont, run->glyphRun());
+					SVG_STATS(ctx.fDrawStats.fFills++);
+				}
+				if (ctx.strokeVisible())
+				{
+					ctx.strokeGlyphRun(origin, run->fFont, run->glyphRun());
+					SVG_STATS(ctx.fDrawStats.fStrokes++);
+				}
+			}
 
 			SVGCompoundNode::drawSelf(ctx);
 		}
+
+		// Recorded as the outlines of the glyphs
+		void compileSelf(SVGDisplayListBuilder& builder) override
+		{
+			BLPoint origin{};
+			auto run = glyphRun(builder, origin);
+			if (run != nullptr)
+			{
+				BLPath outlines{};
+				if (run->fFont.getGlyphRunOutlines(run->glyphRun(), BLMatrix2D::makeTranslation(origin.x, origin.y), outlines) == BL_SUCCESS)
+					builder.addPath(outlines);
+			}
+
+			SVGCompoundNode::compileSelf(builder);
+		}
 		
 		virtual void loadSelfFromXml(const XmlElement& elem)
 		{
 			SVGCompoundNode::loadSelfFromXml(elem);
 
-			x = parseDimension(elem.getAttribute("x")).calculatePixels(96);
-			y = parseDimension(elem.getAttribute("y")).calculatePixels(96);
-			dy = parseDimension(elem.getAttribute("dy")).calculatePixels(96);
-			//fFontSize = parseDimension(elem.getAttribute("font-size")).calculatePixels(96);
+			x = parseDimension(elem.getAttribute(SVG_NAME_X)).calculatePixels(96);
+			y = parseDimension(elem.getAttribute(SVG_NAME_Y)).calculatePixels(96);
+			dy = parseDimension(elem.getAttribute(SVG_NAME_DY)).calculatePixels(96);
+			//fFontSize = parseDimension(elem.getAttribute(SVG_NAME_FONT_SIZE)).calculatePixels(96);
 		}
 
+		// Runs of whitespace are drawn as one space, as
+		// xml:space="preserve" isn't supported
 		void loadContentNode(const XmlElement& elem) override
 		{
-			// Do something with content nodes	
-			fText = toString(elem.data());
+			std::string text{};
+			ByteSpan s = chunk_trim(elem.data(), wspChars);
+			while (s)
+			{
+				if (wspChars(*s))
+				{
+					s = chunk_skip_wsp(s);
+					text.push_back(' ');
+					continue;
+				}
+
+				text.push_back((char)*s);
+				s++;
+			}
+
+			// Whitespace between a <tspan>, and the end of the
+			// text, doesn't replace what came before
+			if (text.empty())
+				return;
+
+			fText = std::move(text);
+			if (fGlyphRuns == nullptr)
+				fGlyphRuns = std::make_shared<SVGGlyphRunCache>();
+			else
+				fGlyphRuns->clear();
 		}
 
 		void loadCompoundNode(XmlElementIterator& iter) override
 		{
 			// Most likely a <tspan>
-			if ((*iter).name() == "tspan")
+			if ((*iter).nameId() == SVG_NAME_TSPAN)
 			{
-				auto node = std::make_shared<SVGTextNode>(fRoot);
+				auto node = makeNode<SVGTextNode>(fRoot);
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
@@ -891,17 +1564,41 @@ namespace svg2b2d {
 		SVGStyleNode() :SVGCompoundNode() {}
 		SVGStyleNode(IMapSVGNodes* root) :SVGCompoundNode(root) {}
 
+		void addMemoryUsage(SVGMemoryUsage& usage) const override
+		{
+			SVGCompoundNode::addMemoryUsage(usage);
+			usage.fStrings += SVGMemoryUsage::stringBytes(fText);
+		}
+
 
 		virtual void loadSelfFromXml(const XmlElement& elem)
 		{
 			SVGCompoundNode::loadSelfFromXml(elem);
 		}
 
+		// The style sheet is either plain content, or in a CDATA section
+		void loadContentNode(const XmlElement& elem) override
+		{
+			loadStyleSheet(elem.data());
+		}
+
 		void loadCDataNode(const XmlElement& elem) override
 		{
-			// Do something with CDATA nodes	
-			// parse a style sheet
-			ndt_debug::printXmlElement(elem);
+			ByteSpan s = elem.data();
+			if (chunk_starts_with_cstr(s, "![CDATA["))
+				s = chunk_subchunk(s, 8, s.size() - 8);
+			if (chunk_ends_with_cstr(s, "]]"))
+				s.fEnd -= 2;
+
+			loadStyleSheet(s);
+		}
+
+		// Rules only apply to the elements that come after them
+		void loadStyleSheet(const ByteSpan& css)
+		{
+			SVGStyleSheet* sheet = (root() != nullptr) ? root()->styleSheet() : nullptr;
+			if (sheet != nullptr && chunk_trim(css, wspChars))
+				sheet->load(css);
 		}
 	};
 	
@@ -914,6 +1611,7 @@ namespace svg2b2d {
 		BLMatrix2D fTransform{};
 		double fWidth{};
 		double fHeight{};
+		std::string fImageRef{};		// the id a <use> within refers to
 
 
 		SVGPatternNode(IMapSVGNodes* root) :SVGCompoundNode(root) {}
@@ -928,6 +1626,12 @@ namespace svg2b2d {
 			
 			return fVar;
 		}
+
+		void prepare() override
+		{
+			getVariant();
+			SVGCompoundNode::prepare();
+		}
 		
 		void drawSelf(IRender& ctx) override
 		{
@@ -941,10 +1645,10 @@ namespace svg2b2d {
 			SVGCompoundNode::loadSelfFromXml(elem);
 
 			fPattern.setExtendMode(BL_EXTEND_MODE_PAD);
-			fWidth = parseDimension(elem.getAttribute("width")).calculatePixels(1,0,96);
-			fHeight = parseDimension(elem.getAttribute("height")).calculatePixels(1,0,96);
+			fWidth = parseDimension(elem.getAttribute(SVG_NAME_WIDTH)).calculatePixels(1,0,96);
+			fHeight = parseDimension(elem.getAttribute(SVG_NAME_HEIGHT)).calculatePixels(1,0,96);
 
-			if (elem.getAttribute("patternTransform"))
+			if (elem.getAttribute(SVG_NAME_PATTERNTRANSFORM))
 			{
 				auto  tform = SVGTransform::createFromXml(root(), "patternTransform", elem);
 				fTransform = tform->fTransform;
@@ -953,39 +1657,37 @@ namespace svg2b2d {
 		}
 
 		// Here we get called while loading child nodes
-		// look for <use> here
+		// look for <use> here, what it refers to is looked
+		// up once everything has been loaded
 		void loadSelfClosingNode(const XmlElement& elem) override
 		{
-			printf("SVGPatternNode::loadSelfClosingNode\n");
-			ndt_debug::printXmlElement(elem);
-
-			// if it's a 'use' node, then get the href field
-			// and use that to find the referenced node
-			if (elem.name() == "use")
+			if (elem.nameId() == SVG_NAME_USE)
 			{
-				auto href = elem.getAttribute("href");
+				auto href = elem.getAttribute(SVG_NAME_HREF);
 				if (!href)
-					href = elem.getAttribute("xlink:href");
+					href = elem.getAttribute(SVG_NAME_XLINK_HREF);
 				
 				if (href)
+					fImageRef = toString(href);
+			}
+		}
+
+		// If what the <use> refers to is an image, 
+		// it's what the pattern is made of
+		void resolveReferences() override
+		{
+			SVGCompoundNode::resolveReferences();
+
+			if (fImageRef.empty() || root() == nullptr)
+				return;
+
+			auto refNode = root()->findNodeByHref(ByteSpan(fImageRef.data(), fImageRef.size()));
+			if (refNode)
+			{
+				const BLVar & avar = refNode->getVariant();
+				if (avar.type() == BL_OBJECT_TYPE_IMAGE)
 				{
-					auto refNode = root()->findNodeByHref(href);
-					if (refNode)
-					{
-						// Now we have the referenced node
-						// Get the varient from it, and if it's type is image
-						// then assign it to our pattern.
-						const BLVar & avar = refNode->getVariant();
-
-						//auto atype = blVarGetType(&avar);
-						//printf("SVGPatternNode: %d\n", atype);
-
-						
-						if (avar.type() == BL_OBJECT_TYPE_IMAGE)
-						{
-							fPattern.setImage(avar.as<BLImage>());
-						}
-					}
+					fPattern.setImage(avar.as<BLImage>());
 				}
 			}
 		}
@@ -1000,6 +1702,13 @@ namespace svg2b2d {
 		BLMatrix2D fGradientTransform{};
 		BLGradient fGradient{};
 		BLVar fGradientVar{};
+		std::once_flag fGradientVarOnce{};
+
+		// The gradient an href refers to, that stops, and the
+		// transform, are taken from, if this one doesn't have its own
+		std::string fHrefId{};
+		bool fHasTransform{ false };
+		bool fHrefResolved{ false };
 
 		SVGGradient(IMapSVGNodes* root) :SVGCompoundNode(root) 
 		{
@@ -1013,62 +1722,76 @@ namespace svg2b2d {
 			//auto nStops = fGradient.size();
 			//printf("STOPS: %d\n", nStops);
 			
-			blVarAssignWeak(&fGradientVar, &fGradient);
+			// Every paint that refers to this gradient
+			// shares the one gradient object.  Parts of a document 
+			// loading in parallel can ask for it at the same time.
+			// A paint can be resolved before the gradient has
+			// been, so the href is taken care of first.
+			std::call_once(fGradientVarOnce, [this]() {
+				resolveHref();
+				blVarAssignWeak(&fGradientVar, &fGradient);
+			});
+
 			return fGradientVar;
 		}
-		
-		// Load a URL Reference
-		void loadFromUrl(const ByteSpan& inChunk)
+
+		void resolveReferences() override
 		{
-			ByteSpan str = inChunk;
+			SVGCompoundNode::resolveReferences();
+			resolveHref();
+		}
 
-			auto id = chunk_trim(str, wspChars);
-			
-			// The first character could be '.' or '#'
-			// so we need to skip past that
-			if (*id == '.' || *id == '#')
-				id++;
+		void prepare() override
+		{
+			getVariant();
+			SVGCompoundNode::prepare();
+		}
 
-			if (!id)
+		// Take the stops, and the transform, of the gradient the href
+		// refers to, when this one doesn't have its own.  Done once the
+		// whole document is loaded, so it doesn't matter where in the
+		// document it is.  A chain of hrefs is followed to the end, and
+		// one that loops back on itself stops where it does.
+		void resolveHref()
+		{
+			if (fHrefResolved)
 				return;
+			fHrefResolved = true;
 
-			// lookup the thing we're referencing
-			std::string idStr = toString(id);
+			if (fHrefId.empty() || fRoot == nullptr)
+				return;
 
-			if (fRoot != nullptr)
-			{
-				auto node = fRoot->findNodeById(idStr);
+			auto node = fRoot->findNodeById(ByteSpan(fHrefId.data(), fHrefId.size()));
+			auto ref = dynamic_cast<SVGGradient*>(node.get());
+			if (ref == nullptr || ref == this)
+				return;
 
-				// pull out the color value
-				if (node != nullptr)
-				{
-					const BLVar& aVar = node->getVariant();
+			ref->resolveHref();
 
+			if (fGradient.size() == 0 && ref->fGradient.size() > 0)
+				fGradient.assignStops(ref->fGradient.stops(), ref->fGradient.size());
 
-					if (aVar.isGradient())
-						fGradient = aVar.as<BLGradient>();
-				}
-			}
+			if (!fHasTransform)
+				fGradient.setMatrix(ref->fGradient.matrix());
 		}
 		
 		// This is called to load specific attributes
 		void loadSelfFromXml(const XmlElement& elem) override
 		{
-			//printf("LOAD FROM SELF\n");
-			//ndt_debug::printXmlElement(elem);
-			
 			// look for an href template
-			ByteSpan href = elem.getAttribute("href");
+			ByteSpan href = elem.getAttribute(SVG_NAME_HREF);
 			if (!href)
-				href = elem.getAttribute("xlink:href");
+				href = elem.getAttribute(SVG_NAME_XLINK_HREF);
 
+			href = chunk_trim(href, wspChars);
+			if (href && (*href == '.' || *href == '#'))
+				href++;
 			if (href)
-				loadFromUrl(href);
-			
+				fHrefId = toString(href);
 
+			fHasTransform = (bool)elem.getAttribute(SVG_NAME_GRADIENTTRANSFORM);
 			
 			SVGCompoundNode::loadSelfFromXml(elem);
-
 		}
 		
 		
@@ -1078,44 +1801,55 @@ namespace svg2b2d {
 			//ndt_debug::printXmlElement(elem);
 			
 			SVGDimension dim{};
-			dim.loadSelfFromChunk(elem.getAttribute("offset"));
+			dim.loadSelfFromChunk(elem.getAttribute(SVG_NAME_OFFSET));
 			auto offset = dim.calculatePixels(1, 0);
 
 
-			std::shared_ptr<SVGPaint> c = nullptr;
-			
-			// If the node specifies a stop color, then use that
-			if (elem.getAttribute("stop-color"))
-			{
-				// the color could either be wrappep up in a 'style' attribute
-				// or directly as 'stop-color' and 'stop-opacity'
-				c = SVGPaint::createFromXml(root(), "stop-color", elem);
-			}
-			else if (elem.getAttribute("style"))
+			// The color could be given directly, as 'stop-color' and
+			// 'stop-opacity', or inside a 'style' attribute, which
+			// overrides the attributes
+			ByteSpan color = elem.getAttribute(SVG_NAME_STOP_COLOR);
+			ByteSpan opacity = elem.getAttribute(SVG_NAME_STOP_OPACITY);
+
+			ByteSpan style = elem.getAttribute(SVG_NAME_STYLE);
+			if (style)
 			{
-				// Otherwise, look for a style attribute
-				// If found, parse it, then look for a stop-color in there
-				ByteSpan style = elem.getAttribute("style");
-				if (style)
+				CSSInlineStyleIterator iter(style);
+				while (iter.next())
 				{
-					XmlElement styleElement;
-					// Turn the style into an XmlElement so we can get at the attributes
-					parseStyleAttribute(style, styleElement);
-					c = SVGPaint::createFromXml(root(), "stop-color", styleElement);
+					switch (svgNameId(iter.fCurrentName))
+					{
+					case SVG_NAME_STOP_COLOR:
+						color = iter.fCurrentValue;
+					break;
+
+					case SVG_NAME_STOP_OPACITY:
+						opacity = iter.fCurrentValue;
+					break;
+
+					default:
+					break;
+					}
 				}
 			}
 
+			if (!color)
+				return;
 
-			if (c != nullptr)
-			{
-				// Convert the variant color to a BLRgba32
-				BLVar aVar = c->getVariant();
-				uint32_t colorValue = 0;
-				auto res = blVarToRgba32(&aVar, &colorValue);
-				BLRgba32 acolor(colorValue);
+			SVGPaint paint(root());
+			paint.loadFromChunk(color);
+			if (!paint.isSet())
+				return;
 
-				fGradient.addStop(offset, acolor);
-			}
+			if (opacity)
+				paint.setOpacity(toNumber(opacity));
+
+			// Convert the variant color to a BLRgba32
+			const BLVar& aVar = paint.getVariant();
+			uint32_t colorValue = 0;
+			blVarToRgba32(&aVar, &colorValue);
+
+			fGradient.addStop(offset, BLRgba32(colorValue));
 		}
 		
 	};
@@ -1133,10 +1867,10 @@ namespace svg2b2d {
 			// and we want that to happen before we set our own stuff.
 			SVGGradient::loadSelfFromXml(elem);
 			
-			double x1 = parseDimension(elem.getAttribute("x1")).calculatePixels();
-			double y1 = parseDimension(elem.getAttribute("y1")).calculatePixels();
-			double x2 = parseDimension(elem.getAttribute("x2")).calculatePixels();
-			double y2 = parseDimension(elem.getAttribute("y2")).calculatePixels();
+			double x1 = parseDimension(elem.getAttribute(SVG_NAME_X1)).calculatePixels();
+			double y1 = parseDimension(elem.getAttribute(SVG_NAME_Y1)).calculatePixels();
+			double x2 = parseDimension(elem.getAttribute(SVG_NAME_X2)).calculatePixels();
+			double y2 = parseDimension(elem.getAttribute(SVG_NAME_Y2)).calculatePixels();
 			
 
 			// gradientUnits needs to be read in here
@@ -1145,7 +1879,7 @@ namespace svg2b2d {
 
 
 			// Get the transform
-			if (elem.getAttribute("gradientTransform"))
+			if (elem.getAttribute(SVG_NAME_GRADIENTTRANSFORM))
 			{
 				auto  tform = SVGTransform::createFromXml(root(), "gradientTransform", elem);
 				fGradient.setMatrix(tform->getTransform());
@@ -1174,11 +1908,11 @@ namespace svg2b2d {
 			//BLRadialGradientValues gradientValues(0.5,0.5,0.5,0.5,0);
 			BLRadialGradientValues gradientValues{};
 			
-			if (elem.getAttribute("cx") && elem.getAttribute("cy") && elem.getAttribute("r"))
+			if (elem.getAttribute(SVG_NAME_CX) && elem.getAttribute(SVG_NAME_CY) && elem.getAttribute(SVG_NAME_R))
 			{
-				double cx = parseDimension(elem.getAttribute("cx")).calculatePixels(96);
-				double cy = parseDimension(elem.getAttribute("cy")).calculatePixels(96);
-				double r = parseDimension(elem.getAttribute("r")).calculatePixels(96);
+				double cx = parseDimension(elem.getAttribute(SVG_NAME_CX)).calculatePixels(96);
+				double cy = parseDimension(elem.getAttribute(SVG_NAME_CY)).calculatePixels(96);
+				double r = parseDimension(elem.getAttribute(SVG_NAME_R)).calculatePixels(96);
 
 				gradientValues.x0 = cx;
 				gradientValues.y0 = cy;
@@ -1188,11 +1922,11 @@ namespace svg2b2d {
 			}
 
 
-			if (elem.getAttribute("fx"))
-				gradientValues.x1 = parseDimension(elem.getAttribute("fx")).calculatePixels(96);
+			if (elem.getAttribute(SVG_NAME_FX))
+				gradientValues.x1 = parseDimension(elem.getAttribute(SVG_NAME_FX)).calculatePixels(96);
 				
-			if (elem.getAttribute("fy"))
-				gradientValues.y1 = parseDimension(elem.getAttribute("fy")).calculatePixels(96);
+			if (elem.getAttribute(SVG_NAME_FY))
+				gradientValues.y1 = parseDimension(elem.getAttribute(SVG_NAME_FY)).calculatePixels(96);
 			
 			fGradient.setValues(gradientValues);
 			
@@ -1200,7 +1934,7 @@ namespace svg2b2d {
 
 
 
-			if (elem.getAttribute("gradientTransform"))
+			if (elem.getAttribute(SVG_NAME_GRADIENTTRANSFORM))
 			{
 				auto  tform = SVGTransform::createFromXml(root(), "gradientTransform", elem);
 				fGradient.setMatrix(tform->getTransform());
@@ -1220,7 +1954,10 @@ namespace svg2b2d {
 	protected:
 		
 		bool fInDefinitions{ false };
-		std::map<std::string, std::shared_ptr<SVGObject>> fDefinitions;
+		SVGNodeIndex fDefinitions{};		// only the root's is used
+		SVGStyleSheet fStyleSheet{};		// only the root's is used
+		std::pmr::memory_resource* fNodeResource{ nullptr };
+		SVGLoadOptions fLoadOptions{};
 
 	public:
 		SVGGroup() :SVGCompoundNode(nullptr) {}
@@ -1230,12 +1967,104 @@ namespace svg2b2d {
 		bool inDefinitions() const override { return fInDefinitions; }
 		void setInDefinitions(bool indefs) override { fInDefinitions = indefs; };
 
-		std::shared_ptr<SVGObject> findNodeById(const std::string& name) override
+		// The root also resolves everything that was only loaded 
+		// as a definition, and isn't one of the drawn nodes
+		void resolveReferences() override
 		{
+			SVGCompoundNode::resolveReferences();
+
 			if (fRoot == this)
-				return fDefinitions[name];
+			{
+				fDefinitions.forEach([](const std::shared_ptr<SVGObject>& node) {
+					node->resolveReferences();
+				});
+			}
+		}
+
+		// The root also prepares what's only reachable by reference
+		void prepare() override
+		{
+			SVGCompoundNode::prepare();
+
+			if (fRoot == this)
+			{
+				fDefinitions.forEach([](const std::shared_ptr<SVGObject>& node) {
+					node->prepare();
+				});
+			}
+		}
+
+		// The root also counts the index of ids, and whatever is
+		// only in it, and the style sheet
+		void addMemoryUsage(SVGMemoryUsage& usage) const override
+		{
+			SVGCompoundNode::addMemoryUsage(usage);
+
+			if (fRoot != this)
+				return;
+
+			usage.fMaps += fDefinitions.fSlots.capacity() * sizeof(SVGNodeIndex::Slot);
+			for (const auto& slot : fDefinitions.fSlots)
+			{
+				usage.fMaps += SVGMemoryUsage::stringBytes(slot.fKey);
+				if (slot.fNode != nullptr)
+					slot.fNode->memoryUsage(usage);
+			}
+
+			usage.fLoadOnly += fStyleSheet.bytes();
+		}
+
+		// The style sheet is only matched against while loading
+		void shrink() override
+		{
+			SVGCompoundNode::shrink();
+
+			if (fRoot != this)
+				return;
+
+			fStyleSheet.clear();
+			fDefinitions.forEach([](const std::shared_ptr<SVGObject>& node) {
+				node->shrink();
+			});
+		}
+
+		// Only the root holds the resource, everyone else asks the root
+		std::pmr::memory_resource* nodeResource() override
+		{
+			if (fRoot == this)
+				return fNodeResource;
 			else if (fRoot)
-				return fRoot->findNodeById(name);
+				return fRoot->nodeResource();
+
+			return nullptr;
+		}
+		void setNodeResource(std::pmr::memory_resource* mr) { fNodeResource = mr; }
+
+		const SVGLoadOptions& loadOptions() override
+		{
+			if (fRoot == this || fRoot == nullptr)
+				return fLoadOptions;
+
+			return fRoot->loadOptions();
+		}
+		void setLoadOptions(const SVGLoadOptions& options) { fLoadOptions = options; }
+
+		SVGStyleSheet* styleSheet() override
+		{
+			if (fRoot == this)
+				return &fStyleSheet;
+			else if (fRoot)
+				return fRoot->styleSheet();
+
+			return nullptr;
+		}
+
+		std::shared_ptr<SVGObject> findNodeById(const ByteSpan& id) override
+		{
+			if (fRoot == this)
+				return fDefinitions.find(id);
+			else if (fRoot)
+				return fRoot->findNodeById(id);
 			
 			return nullptr;
 		}
@@ -1256,9 +2085,7 @@ namespace svg2b2d {
 				return nullptr;
 
 			// lookup the thing we're referencing
-			std::string idStr = toString(id);
-
-			return findNodeById(idStr);
+			return findNodeById(id);
 		}
 		
 		void addNode(std::shared_ptr < SVGVisualNode > node) override
@@ -1272,23 +2099,23 @@ namespace svg2b2d {
 			// if the visual has an ID, then add the node
 			// to our definitions map.
 			if (!node->id().empty())
-				addDefinition(node->id(), node);
+				addDefinition(ByteSpan(node->id().data(), node->id().size()), node);
 
 			// If we're not in definitions mode, then 
 			// also add the node to the visual nodes list
-			if (!inDefinitions() && (node->name() != "symbol"))
+			if (!inDefinitions() && (node->nameId() != SVG_NAME_SYMBOL))
 			{
 				fNodes.push_back(node);
 			}
 
 		}
 
-		void addDefinition(const std::string& name, std::shared_ptr<SVGObject> obj)
+		void addDefinition(const ByteSpan& id, std::shared_ptr<SVGObject> obj) override
 		{
 			if (fRoot == this)
-				fDefinitions[name] = obj;
+				fDefinitions.insert(id, obj);
 			else if (fRoot != nullptr)
-				fRoot->addDefinition(name, obj);
+				fRoot->addDefinition(id, obj);
 			
 		}
 
@@ -1300,24 +2127,32 @@ namespace svg2b2d {
 
 		void loadSelfClosingNode(const XmlElement& elem) override
 		{
-			if (elem.name() == "linearGradient")
+			switch (elem.nameId())
+			{
+			case SVG_NAME_LINEARGRADIENT:
 			{
-				auto node = std::make_shared<SVGLinearGradient>(root());
+				auto node = makeNode<SVGLinearGradient>(root());
 				node->loadSelfFromXml(elem);
 				addNode(node);
 			}
-			else if (elem.name() == "radialGradient")
+			break;
+
+			case SVG_NAME_RADIALGRADIENT:
 			{
-				auto node = std::make_shared<SVGRadialGradient>(root());
+				auto node = makeNode<SVGRadialGradient>(root());
 				node->loadSelfFromXml(elem);
 				addNode(node);
 			}
-			
-			auto it = gShapeCreationMap.find(elem.name());
-			if (it != gShapeCreationMap.end())
+			break;
+
+			default:
 			{
-				auto node = it->second(root(), elem);
-				addNode(node);
+				auto node = createShapeFromXml(root(), elem);
+				if (node != nullptr)
+					addNode(node);
+				SVG_STATS(if (node == nullptr) svgCount(root(), &SVGStats::fIgnoredElements));
+			}
+			break;
 			}
 		}
 		
@@ -1328,62 +2163,85 @@ namespace svg2b2d {
 
 			
 			// Add a child, and call loadIterator
-			if (elem.name() == "g")
+			switch (elem.nameId())
+			{
+			case SVG_NAME_G:
 			{
-				auto node = std::make_shared<SVGGroup>(root());
+				auto node = makeNode<SVGGroup>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
-			else if (elem.name() == "defs")
+			break;
+
+			case SVG_NAME_DEFS:
 			{
 				setInDefinitions(true);
-				auto node = std::make_shared<SVGGroup>(root());
+				auto node = makeNode<SVGGroup>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 				setInDefinitions(false);
 			}
-			else if (elem.name() == "linearGradient")
+			break;
+
+			case SVG_NAME_LINEARGRADIENT:
 			{
-				auto node = std::make_shared<SVGLinearGradient>(root());
+				auto node = makeNode<SVGLinearGradient>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
-			else if (elem.name() == "pattern")
+			break;
+
+			case SVG_NAME_PATTERN:
 			{
-				auto node = std::make_shared<SVGPatternNode>(root());
+				auto node = makeNode<SVGPatternNode>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
-			else if (elem.name() == "radialGradient")
+			break;
+
+			case SVG_NAME_RADIALGRADIENT:
 			{
-				auto node = std::make_shared<SVGRadialGradient>(root());
+				auto node = makeNode<SVGRadialGradient>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
-			else if (elem.name() == "text")
+			break;
+
+			case SVG_NAME_TEXT:
 			{
-				auto node = std::make_shared<SVGTextNode>(root());
+				auto node = makeNode<SVGTextNode>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
-			else if (elem.name() == "symbol")
+			break;
+
+			case SVG_NAME_SYMBOL:
 			{
-				auto  node = std::make_shared<SVGGroup>(root());
+				auto  node = makeNode<SVGGroup>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
-			else if (elem.name() == "style")
+			break;
+
+			case SVG_NAME_STYLE:
 			{
-				auto node = std::make_shared<SVGStyleNode>(root());
+				auto node = makeNode<SVGStyleNode>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
-			else {
-				//printf("loadCompoundNode: UNKNOWN: %s\n", elem.name().c_str());
-				auto node = std::make_shared<SVGGroup>(root());
+			break;
+
+			default:
+			{
+				//printf("loadCompoundNode: UNKNOWN: %.*s\n", (int)elem.name().size(), (const char*)elem.name().fStart);
+				// Loaded as a group, so what's inside still shows up
+				SVG_STATS(svgCount(root(), &SVGStats::fIgnoredElements));
+				auto node = makeNode<SVGGroup>(root());
 				node->loadFromIterator(iter);
 				addNode(node);
 			}
+			break;
+			}
 		}
 
 		static std::shared_ptr<SVGGroup> createFromIterator(XmlElementIterator& iter)
@@ -1444,11 +2302,11 @@ namespace svg2b2d {
 				fWidth = fViewbox.width();
 				fHeight = fViewbox.height();
 				
-				fPreserveAspectRatio = elem.getAttribute("preserveAspectRatio") == "xMidYMid meet";
+				fPreserveAspectRatio = elem.getAttribute(SVG_NAME_PRESERVEASPECTRATIO) == "xMidYMid meet";
 			}
 			
 			// Dimensions
-			if (elem.getAttribute("width") && elem.getAttribute("height"))
+			if (elem.getAttribute(SVG_NAME_WIDTH) && elem.getAttribute(SVG_NAME_HEIGHT))
 			{
 				double rangeX = 100;
 				double rangeY = 100;
@@ -1459,12 +2317,12 @@ namespace svg2b2d {
 					rangeY = fViewbox.height();
 				}
 
-				fWidth = parseDimension(elem.getAttribute("width")).calculatePixels(rangeX, 0, 96);
-				fHeight = parseDimension(elem.getAttribute("height")).calculatePixels(rangeY, 0, 96);
+				fWidth = parseDimension(elem.getAttribute(SVG_NAME_WIDTH)).calculatePixels(rangeX, 0, 96);
+				fHeight = parseDimension(elem.getAttribute(SVG_NAME_HEIGHT)).calculatePixels(rangeY, 0, 96);
 			}
 
 			
-			fPreserveAspectRatio = elem.getAttribute("preserveAspectRatio") == "xMidYMid meet";
+			fPreserveAspectRatio = elem.getAttribute(SVG_NAME_PRESERVEASPECTRATIO) == "xMidYMid meet";
 
 			set(true);
 		}
@@ -1473,23 +2331,129 @@ namespace svg2b2d {
 		
 		static std::shared_ptr<SVGPortal> createFromXml(IMapSVGNodes* root, const XmlElement& elem, const std::string &name)
 		{
-			auto node = std::make_shared<SVGPortal>(root);
+			auto node = makeNode<SVGPortal>(root);
 			node->loadFromXmlElement(elem);
 
 			return node;
 		}
 	};
 
+	//
+	// SVGSubtreeMap
+	// Stands in for the root, for a part of the document that is loaded
+	// on another thread.  Its nodes are allocated from its own arena, and
+	// the ids defined within it go into its own index, so nothing is shared
+	// with the other threads while it loads.  What it looks up is found in
+	// its own index, or in the ids the root had before loading went parallel.
+	// Once everything has loaded, the root takes in the ids, and after that,
+	// this just passes everything on to the root.
+	//
+	// The root also keeps the ids it gets, while parts are loading, in one
+	// of these, so they can all be added in document order at the end.
+	//
+	// A part is matched against a copy of the root's style sheet, as it was
+	// when the part was reached.  Rules of <style> elements within the part
+	// only apply to the rest of that part.
+	//
+	struct SVGSubtreeMap : public IMapSVGNodes
+	{
+		IMapSVGNodes* fDocRoot{ nullptr };
+		const SVGNodeIndex* fRootDefinitions{ nullptr };	// not changed while parts load
+		std::unique_ptr<std::pmr::monotonic_buffer_resource> fArena{};
+		SVGNodeIndex fDefinitions{};
+		SVGStyleSheet fStyleSheet{};
+		std::shared_ptr<SVGGroup> fNode{};		// the top of the part, until it's merged
+		bool fPart{ false };					// false when it's the root's own ids
+		bool fInDefinitions{ false };
+		bool fMerged{ false };
+
+		SVGSubtreeMap(IMapSVGNodes* root, const SVGNodeIndex* rootDefinitions)
+			: fDocRoot(root)
+			, fRootDefinitions(rootDefinitions)
+		{
+			if (root->nodeResource() != nullptr)
+				fArena = std::make_unique<std::pmr::monotonic_buffer_resource>(root->loadOptions().fArenaBlockSize);
+		}
+
+		std::shared_ptr<SVGObject> findNodeById(const ByteSpan& id) override
+		{
+			if (fMerged)
+				return fDocRoot->findNodeById(id);
+
+			auto node = fDefinitions.find(id);
+			if (node == nullptr)
+				node = fRootDefinitions->find(id);
+
+			return node;
+		}
+
+		std::shared_ptr<SVGObject> findNodeByHref(const ByteSpan& inChunk) override
+		{
+			auto id = chunk_trim(inChunk, wspChars);
+			if (*id == '.' || *id == '#')
+				id++;
+
+			if (!id)
+				return nullptr;
+
+			return findNodeById(id);
+		}
+
+		void addDefinition(const ByteSpan& id, std::shared_ptr<SVGObject> obj) override
+		{
+			if (fMerged)
+				fDocRoot->addDefinition(id, obj);
+			else
+				fDefinitions.insert(id, obj);
+		}
+
+		void setInDefinitions(bool indefs) override { fInDefinitions = indefs; }
+		bool inDefinitions() const override { return fInDefinitions; }
+
+		const SVGLoadOptions& loadOptions() override { return fDocRoot->loadOptions(); }
+		std::pmr::memory_resource* nodeResource() override { return fMerged ? fDocRoot->nodeResource() : fArena.get(); }
+		SVGStyleSheet* styleSheet() override { return fMerged ? fDocRoot->styleSheet() : &fStyleSheet; }
+	};
+
 	struct SVGRootNode : public SVGGroup
 	{
 		std::shared_ptr<SVGPortal> fPortal;
 
+		// Parts of the document loaded in parallel, see loadInParallel()
+		std::vector<std::unique_ptr<SVGSubtreeMap>> fSubtrees{};
+		bool fLoadingParallel{ false };
+
 		SVGRootNode() :SVGGroup(nullptr) { setRoot(this); }
 		SVGRootNode(IMapSVGNodes *root)
 			: SVGGroup(root)
 		{
 			setRoot(this);
 		}
+
+		// Nodes loaded in parallel live in the arenas of the subtrees,
+		// so they have to go before the subtrees do
+		~SVGRootNode()
+		{
+			fNodes.clear();
+			fDefinitions.clear();
+		}
+
+		// The parts keep their copies of the style sheet, but their
+		// arenas hold the nodes loaded into them, so they stay
+		void addMemoryUsage(SVGMemoryUsage& usage) const override
+		{
+			SVGGroup::addMemoryUsage(usage);
+			usage.fMaps += fSubtrees.capacity() * sizeof(std::unique_ptr<SVGSubtreeMap>);
+			for (const auto& sub : fSubtrees)
+				usage.fLoadOnly += sub->fStyleSheet.bytes();
+		}
+
+		void shrink() override
+		{
+			SVGGroup::shrink();
+			for (auto& sub : fSubtrees)
+				sub->fStyleSheet.clear();
+		}
 		
 		double width()
 		{
@@ -1512,11 +2476,169 @@ namespace svg2b2d {
 			fPortal = SVGPortal::createFromXml(root(), elem, "portal");
 		}
 
-		static std::shared_ptr<SVGRootNode> createFromIterator(XmlElementIterator& iter)
+		std::shared_ptr<SVGObject> findNodeById(const ByteSpan& id) override
+		{
+			// The ids gotten since loading went parallel come first
+			if (fLoadingParallel)
+			{
+				for (auto it = fSubtrees.rbegin(); it != fSubtrees.rend(); ++it)
+				{
+					if ((*it)->fPart)
+						continue;
+
+					auto node = (*it)->fDefinitions.find(id);
+					if (node != nullptr)
+						return node;
+				}
+			}
+
+			return SVGGroup::findNodeById(id);
+		}
+
+		void addDefinition(const ByteSpan& id, std::shared_ptr<SVGObject> obj) override
+		{
+			if (!fLoadingParallel)
+			{
+				SVGGroup::addDefinition(id, obj);
+				return;
+			}
+
+			// Parts might be reading the root's ids, so hold onto 
+			// these until they're done
+			if (fSubtrees.empty() || fSubtrees.back()->fPart)
+				fSubtrees.push_back(std::make_unique<SVGSubtreeMap>(this, &fDefinitions));
+			fSubtrees.back()->fDefinitions.insert(id, obj);
+		}
+
+		void loadFromIterator(XmlElementIterator& iter) override
+		{
+			if (fLoadOptions.fLoadPool != nullptr)
+				loadInParallel(iter, *fLoadOptions.fLoadPool);
+			else
+				SVGGroup::loadFromIterator(iter);
+		}
+
+		// The same as loading in order, except that each of the
+		// large top level <g> elements is skipped over, and loaded
+		// on the pool, while this thread carries on with the rest.
+		// Once they're all loaded, the ids are added to the root in
+		// the order they appear in the document, so the same node
+		// is found for an id as when loading in order.
+		// Nothing refers to anything by id while loading, references
+		// (<use>, gradient hrefs, paints) are all resolved after the
+		// parts have been merged, so they find the same nodes either way.
+		void loadInParallel(XmlElementIterator& iter, SVGThreadPool& pool)
+		{
+			loadFromXmlElement(*iter);
+
+			fLoadingParallel = true;
+			std::vector<std::future<void>> pending{};
+
+			buildState = BUILD_STATE_OPEN;
+			while (iter && (buildState != BUILD_STATE_CLOSE))
+			{
+				iter++;
+
+				const svg2b2d::XmlElement& elem = *iter;
+				if (!elem)
+					break;
+
+				if (elem.isStart() && (elem.nameId() == SVG_NAME_G) && !inDefinitions())
+				{
+					ByteSpan extent = iter.elementExtent();
+					if (extent.size() >= fLoadOptions.fParallelMinBytes)
+					{
+						SVG_STATS(svgCount(root(), &SVGStats::fElements));
+						iter.skipElement(extent);
+
+						auto part = std::make_unique<SVGSubtreeMap>(this, &fDefinitions);
+						auto node = makeNode<SVGGroup>(part.get());
+						part->fNode = node;
+						part->fPart = true;
+						part->fStyleSheet = fStyleSheet;
+						fSubtrees.push_back(std::move(part));
+
+						// Its place among the children is kept, even though it
+						// isn't loaded yet
+						fNodes.push_back(node);
+
+						auto task = std::make_shared<std::packaged_task<void()>>([node, extent]() {
+							XmlElementIterator subIter(extent);
+							node->loadFromIterator(subIter);
+						});
+						pending.push_back(task->get_future());
+						pool.submit([task]() { (*task)(); });
+
+						continue;
+					}
+				}
+
+				// Counted the same as SVGCompoundNode::loadFromIterator()
+				if (elem.isSelfClosing())
+				{
+					SVG_STATS(svgCount(root(), &SVGStats::fElements));
+					loadSelfClosingNode(elem);
+				}
+				else if (elem.isStart())
+				{
+					SVG_STATS(svgCount(root(), &SVGStats::fElements));
+					loadCompoundNode(iter);
+				}
+				else if (elem.isEnd())
+					buildState = BUILD_STATE_CLOSE;
+				else if (elem.isContent())
+					loadContentNode(elem);
+				else if (elem.isCData())
+					loadCDataNode(elem);
+				else
+				{
+					SVG_STATS(svgCount(root(), &SVGStats::fIgnoredElements));
+				}
+			}
+
+			for (auto& f : pending)
+				f.wait();
+
+			// Take in the ids, in document order
+			fLoadingParallel = false;
+			for (auto& sub : fSubtrees)
+			{
+				if (sub->fNode != nullptr)
+				{
+					// As addNode() would have, after the children
+					sub->fNode->setRoot(this);
+					if (!sub->fNode->id().empty())
+						sub->fDefinitions.insert(ByteSpan(sub->fNode->id().data(), sub->fNode->id().size()), sub->fNode);
+					sub->fNode = nullptr;
+				}
+
+				fDefinitions.insertAll(sub->fDefinitions);
+				sub->fDefinitions.clear();
+				sub->fMerged = true;
+			}
+
+			// Only the parts are still referred to, by their nodes
+			fSubtrees.erase(std::remove_if(fSubtrees.begin(), fSubtrees.end(),
+				[](const std::unique_ptr<SVGSubtreeMap>& sub) { return !sub->fPart; }), fSubtrees.end());
+		}
+
+		// If a memory resource is specified, the root, and all 
+		// the nodes below it, are allocated from it
+		static std::shared_ptr<SVGRootNode> createFromIterator(XmlElementIterator& iter, const SVGLoadOptions& options = SVGLoadOptions{}, std::pmr::memory_resource* mr = nullptr)
 		{
-			auto node = std::make_shared<SVGRootNode>();
+			std::shared_ptr<SVGRootNode> node{};
+			if (mr != nullptr)
+				node = std::allocate_shared<SVGRootNode>(std::pmr::polymorphic_allocator<SVGRootNode>(mr));
+			else
+				node = std::make_shared<SVGRootNode>();
+
+			node->setNodeResource(mr);
+			node->setLoadOptions(options);
 			node->loadFromIterator(iter);
 
+			// Now that everything can be found
+			node->resolveReferences();
+
 			return node;
 		}
 
@@ -1534,7 +2656,8 @@ namespace svg2b2d {
 			
 			ctx.setStrokeStyle(BLRgba32(0));
 			ctx.setStrokeWidth(1.0);
-			//ctx.textSize(16);
+			ctx.fHidden = SVG_HIDDEN_STROKE;
+			ctx.setTextState(SVGTextState{});
 			
 			// Apply attributes that have been gathered
 			// in the case of the root node, it's mostly the viewport
@@ -1546,26 +2669,71 @@ namespace svg2b2d {
 			ctx.restore();
 		}
 
+		void compile(SVGDisplayListBuilder& builder) override
+		{
+			builder.save();
+
+			// Same default state as draw()
+			builder.setFillStyle(BLRgba32(0, 0, 0));
+			builder.setStrokeStyle(BLRgba32(0));
+			builder.setStrokeWidth(1.0);
+
+			fStyle.apply(builder);
+
+			compileSelf(builder);
+
+			builder.restore();
+		}
+
 	};
 	
 	
-	std::map<std::string, std::function<std::shared_ptr<SVGGroup>(XmlElementIterator& iter)>> gGroupCreationMap = {
-		{"g", [](XmlElementIterator& iter) { return SVGGroup::createFromIterator(iter); }},
-		{"svg", [](XmlElementIterator& iter) { return SVGRootNode::createFromIterator(iter); }},
-		{"defs", [](XmlElementIterator& iter) { return SVGRootNode::createFromIterator(iter); }},
-		{"symbol", [](XmlElementIterator& iter) { return SVGGroup::createFromIterator(iter); }},
-	};
+	// Create a group from a start tag
+	// Returns nullptr if the element is not a grouping element
+	static std::shared_ptr<SVGGroup> createGroupFromIterator(XmlElementIterator& iter)
+	{
+		switch ((*iter).nameId())
+		{
+		case SVG_NAME_G: return SVGGroup::createFromIterator(iter);
+		case SVG_NAME_SVG: return SVGRootNode::createFromIterator(iter);
+		case SVG_NAME_DEFS: return SVGRootNode::createFromIterator(iter);
+		case SVG_NAME_SYMBOL: return SVGGroup::createFromIterator(iter);
+		default:
+			break;
+		}
+
+		return nullptr;
+	}
 
 
 	struct SVGDocument : public IDrawable
 	{
+		SVGLoadOptions fOptions{};
+
+		// The mapped file the document was read from, if any.
+		// The nodes hold spans into it, so it comes before them,
+		// and is destroyed after them.
+		std::shared_ptr<filemapper::mmap> fMappedFile{};
+
+		// The arena comes before the nodes, so it is destroyed after them
+		std::unique_ptr<std::pmr::monotonic_buffer_resource> fArena{};
 
 		// All the drawable nodes within this document
 		std::shared_ptr<SVGRootNode> fRootNode{};
-		std::vector<std::shared_ptr<IDrawable>> fShapes{};
+		std::vector<std::shared_ptr<SVGObject>> fShapes{};
 		BLBox fExtent{};
 
+		// Counts of loading, and drawing, when fOptions doesn't
+		// say where they go
+		SVGStats fStats{};
+
 		SVGDocument() = default;
+		SVGDocument(const SVGLoadOptions& options)
+			: fOptions(options)
+		{
+			if (fOptions.fUseArena)
+				fArena = std::make_unique<std::pmr::monotonic_buffer_resource>(fOptions.fArenaBlockSize);
+		}
 
 		double width() const { 
 			if (fRootNode == nullptr)
@@ -1581,10 +2749,116 @@ namespace svg2b2d {
 
 		void draw(IRender& ctx) override
 		{
+			SVG_STATS(auto start = std::chrono::steady_clock::now());
+			SVG_STATS(SVGDrawStats before = ctx.fDrawStats);
+
 			for (auto& shape : fShapes)
 			{
 				shape->draw(ctx);
 			}
+
+#if defined(SVG_ENABLE_STATS)
+			SVGStats& st = stats();
+			SVGStats::addTime(st.fDrawNs, start);
+			SVGStats::add(st.fDraws);
+			SVGStats::add(st.fFills, ctx.fDrawStats.fFills - before.fFills);
+			SVGStats::add(st.fStrokes, ctx.fDrawStats.fStrokes - before.fStrokes);
+			SVGStats::add(st.fSkippedFills, ctx.fDrawStats.fSkippedFills - before.fSkippedFills);
+			SVGStats::add(st.fSkippedStrokes, ctx.fDrawStats.fSkippedStrokes - before.fSkippedStrokes);
+#endif
+		}
+
+		// What's been counted, loading and drawing, this document
+		// Stays at zero unless SVG_ENABLE_STATS is defined.
+		SVGStats& stats() { return (fOptions.fStats != nullptr) ? *fOptions.fStats : fStats; }
+
+		// Drop everything that was loaded, so the document
+		// can be used to load another one.  The storage of
+		// the shapes list is kept.
+		void clear()
+		{
+			fRootNode = nullptr;
+			fShapes.clear();
+			fExtent = BLBox{};
+
+			// With the nodes gone, all the arena memory can be reused
+			if (fArena != nullptr)
+				fArena->release();
+
+			// and nothing refers to the file anymore
+			fMappedFile = nullptr;
+		}
+
+		// Compute everything that is otherwise computed the first time
+		// it's needed: the bounds of every node, any deferred paths, and
+		// the paints of images, patterns, and gradients, including those
+		// only reached by reference.  After this, drawing doesn't modify
+		// the document (the caches it fills are guarded), so it can be 
+		// drawn by several threads at the same time.
+		void prepare()
+		{
+			for (auto& shape : fShapes)
+				shape->prepare();
+
+			if (fRootNode != nullptr)
+			{
+				fRootNode->prepare();
+				fExtent = fRootNode->extent();
+			}
+		}
+
+		// What the loaded document holds onto, see SVGMemoryUsage
+		SVGMemoryUsage memoryUsage() const
+		{
+			SVGMemoryUsage usage{};
+			usage.fMaps += fShapes.capacity() * sizeof(std::shared_ptr<SVGObject>);
+			for (const auto& shape : fShapes)
+				shape->memoryUsage(usage);
+
+			if (fRootNode != nullptr)
+				fRootNode->memoryUsage(usage);
+
+			return usage;
+		}
+
+		// Free what's only needed while loading (retained source
+		// elements, style sheets), and trim what was grown as it
+		// loaded, paths in particular, to the size it ended up.
+		// Best done after prepare(), so deferred paths have been
+		// parsed, and before compile(), since a path that's shared
+		// with a display list gets copied, rather than trimmed.
+		// Not to be called while the document is being drawn.
+		void shrink()
+		{
+			fShapes.shrink_to_fit();
+			for (auto& shape : fShapes)
+				shape->shrink();
+
+			if (fRootNode != nullptr)
+				fRootNode->shrink();
+		}
+
+		// Flatten the document into a display list, which can
+		// then be drawn repeatedly, without walking the tree.
+		// Any existing contents of the list are replaced.
+		void compile(SVGDisplayList& dl)
+		{
+			dl.clear();
+
+			SVGDisplayListBuilder builder(dl);
+			for (auto& shape : fShapes)
+			{
+				shape->compile(builder);
+			}
+		}
+
+		// Compile the document, and write the display list out as a
+		// blob that SVGCompiledDocument can load without parsing
+		void writeCompiled(std::vector<uint8_t>& out)
+		{
+			SVGDisplayList dl;
+			compile(dl);
+			svgWriteDisplayList(dl, width(), height(), out);
 		}
 
 		// Add a node that can be drawn
@@ -1618,14 +2892,21 @@ namespace svg2b2d {
 				}
 
 
-				if (elem.isStart() && (elem.name() == "svg"))
+				if (elem.isStart() && (elem.nameId() == SVG_NAME_SVG))
 				{
+					SVG_STATS(SVGStats::add(stats().fElements));
+
                     // There should be only one root node in a document, so we should 
                     // break here, but, curiosity...
-                    fRootNode = SVGRootNode::createFromIterator(iter);
+                    fRootNode = SVGRootNode::createFromIterator(iter, fOptions, fArena.get());
                     if (fRootNode != nullptr)
                     {
                         addNode(fRootNode);
+
+                        // Work out the bounds of everything now, unless 
+                        // that would mean parsing deferred paths
+                        if (!fOptions.fLazyPaths)
+                            fExtent = fRootNode->extent();
                     }
 				}
 
@@ -1637,13 +2918,96 @@ namespace svg2b2d {
 		{
 			ByteSpan s = inChunk;
 
+			// The nodes find the counts through the options
+			SVG_STATS(fOptions.fStats = &stats());
+			SVG_STATS(auto start = std::chrono::steady_clock::now());
+
 			XmlElementIterator iter(s);
 
 			loadFromIterator(iter);
 
+			SVG_STATS(SVGStats::add(fOptions.fStats->fBytesScanned, inChunk.size()));
+			SVG_STATS(SVGStats::addTime(fOptions.fStats->fBuildNs, start));
+
 			return true;
 		}
 
+		// Map the file, and load the document straight from the mapping.
+		// Nothing is copied, the file stays mapped for as long as the 
+		// document is alive, or until clear().
+		bool readFromFile(const char* filename)
+		{
+			auto mapped = filemapper::mmap::createShared(filename);
+			if (mapped == nullptr)
+				return false;
+
+			clear();
+			fMappedFile = mapped;
 
+			readFromData(ByteSpan(fMappedFile->data(), fMappedFile->size()));
+
+			return fRootNode != nullptr;
+		}
+
+
+	};
+
+	// The intrinsic size of a document, the same as an SVGDocument
+	// loaded from it would have
+	struct SVGDimensions
+	{
+		double fWidth{ 100 };
+		double fHeight{ 100 };
+		BLRect fViewBox{};
+		bool fHasViewBox{ false };
 	};
+
+	// Work out the size of a document from its root <svg> start tag,
+	// without loading anything else.  Scanning stops at the root, so
+	// the cost doesn't depend on how big the document is.
+	// Returns false if the first element isn't an <svg>.
+	static inline bool svgProbeDimensions(const ByteSpan& inChunk, SVGDimensions& out)
+	{
+		out = SVGDimensions{};
+
+		XmlElementIterator iter(inChunk);
+		while (iter)
+		{
+			const XmlElement& elem = *iter;
+			if (!elem)
+				break;
+
+			if (elem.isStart() || elem.isSelfClosing())
+			{
+				if (elem.nameId() != SVG_NAME_SVG)
+					return false;
+
+				// Same as the root node does it
+				SVGPortal portal(nullptr);
+				portal.loadFromXmlElement(elem);
+
+				out.fWidth = portal.width();
+				out.fHeight = portal.height();
+				out.fHasViewBox = portal.fViewbox.isSet();
+				if (out.fHasViewBox)
+					out.fViewBox = portal.fViewbox.fRect;
+
+				return true;
+			}
+
+			iter++;
+		}
+
+		return false;
+	}
+
+	// Only the first pages of the file are ever read
+	static inline bool svgProbeDimensionsFile(const char* filename, SVGDimensions& out)
+	{
+		auto mapped = filemapper::mmap::createShared(filename);
+		if (mapped == nullptr)
+			return false;
+
+		return svgProbeDimensions(ByteSpan(mapped->data(), mapped->size()), out);
+	}
 }
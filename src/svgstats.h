@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+//
+// Statistics
+// Counters for what went into loading, and drawing, a document: how much
+// was scanned, how many elements and path segments, what was ignored,
+// how many nodes were allocated, and how long each stage took.  They're
+// for finding the documents that are pathological, without attaching
+// a profiler.
+//
+// The counting is only compiled in when SVG_ENABLE_STATS is defined.
+// Without it, everything wrapped in SVG_STATS() compiles to nothing,
+// and the counters stay at zero.
+//
+// The counters are atomic, since parts of a document can be loaded,
+// and drawn, on several threads at once.
+//
+#if defined(SVG_ENABLE_STATS)
+#define SVG_STATS(...) __VA_ARGS__
+#else
+#define SVG_STATS(...)
+#endif
+
+namespace svg2b2d {
+
+	// A plain copy of the counters, to look at, or keep
+	struct SVGStatsReport
+	{
+		uint64_t fBytesScanned{ 0 };
+		uint64_t fElements{ 0 };
+		uint64_t fIgnoredElements{ 0 };		// elements that aren't loaded into anything
+		uint64_t fPathSegments{ 0 };
+		uint64_t fNodeAllocations{ 0 };
+		uint64_t fNodeBytes{ 0 };
+
+		uint64_t fFills{ 0 };
+		uint64_t fStrokes{ 0 };
+		uint64_t fSkippedFills{ 0 };		// would not have drawn anything
+		uint64_t fSkippedStrokes{ 0 };
+
+		double fBuildMs{ 0 };
+		double fDrawMs{ 0 };
+		uint64_t fDraws{ 0 };
+	};
+
+	struct SVGStats
+	{
+		std::atomic<uint64_t> fBytesScanned{ 0 };
+		std::atomic<uint64_t> fElements{ 0 };
+		std::atomic<uint64_t> fIgnoredElements{ 0 };
+		std::atomic<uint64_t> fPathSegments{ 0 };
+		std::atomic<uint64_t> fNodeAllocations{ 0 };
+		std::atomic<uint64_t> fNodeBytes{ 0 };
+
+		std::atomic<uint64_t> fFills{ 0 };
+		std::atomic<uint64_t> fStrokes{ 0 };
+		std::atomic<uint64_t> fSkippedFills{ 0 };
+		std::atomic<uint64_t> fSkippedStrokes{ 0 };
+
+		std::atomic<uint64_t> fBuildNs{ 0 };
+		std::atomic<uint64_t> fDrawNs{ 0 };
+		std::atomic<uint64_t> fDraws{ 0 };
+
+		static void add(std::atomic<uint64_t>& counter, uint64_t n = 1) noexcept
+		{
+			counter.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		// Nanoseconds since 'start', added to 'counter'
+		static void addTime(std::atomic<uint64_t>& counter, std::chrono::steady_clock::time_point start) noexcept
+		{
+			auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			add(counter, (uint64_t)ns);
+		}
+
+		void reset() noexcept
+		{
+			for (auto* c : { &fBytesScanned, &fElements, &fIgnoredElements, &fPathSegments, &fNodeAllocations, &fNodeBytes,
+				&fFills, &fStrokes, &fSkippedFills, &fSkippedStrokes, &fBuildNs, &fDrawNs, &fDraws })
+				c->store(0, std::memory_order_relaxed);
+		}
+
+		SVGStatsReport report() const noexcept
+		{
+			SVGStatsReport r{};
+			r.fBytesScanned = fBytesScanned.load();
+			r.fElements = fElements.load();
+			r.fIgnoredElements = fIgnoredElements.load();
+			r.fPathSegments = fPathSegments.load();
+			r.fNodeAllocations = fNodeAllocations.load();
+			r.fNodeBytes = fNodeBytes.load();
+			r.fFills = fFills.load();
+			r.fStrokes = fStrokes.load();
+			r.fSkippedFills = fSkippedFills.load();
+			r.fSkippedStrokes = fSkippedStrokes.load();
+			r.fBuildMs = fBuildNs.load() / 1e6;
+			r.fDrawMs = fDrawNs.load() / 1e6;
+			r.fDraws = fDraws.load();
+
+			return r;
+		}
+	};
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "svgshapes.h"
+
+//
+// Streaming rendering
+// For "parse it, draw it once" conversions, there is no need to hold onto
+// the whole tree of nodes.  Here, the XML is read the same way as when
+// loading a document, but each shape is drawn into the context as soon as
+// it has been loaded, and then let go.  Groups push their styling onto the
+// context when they open, and pop it when they close, so all that's held
+// onto at any moment is one group per level of nesting.
+//
+// What is kept, so that it can be referred to by what comes later:
+//   - the contents of <defs>, and <symbol>
+//   - gradients, and patterns
+//   - any individual shape that has an id
+// A <g> with an id is drawn as it streams by, it is not kept, so
+// a <use> of it draws nothing.  References to something that comes
+// later in the document can't be resolved in a single pass either.
+//
+namespace svg2b2d {
+
+	struct SVGStreamGroup : public SVGGroup
+	{
+		IRender* fContext{ nullptr };
+		bool fPushed{ false };
+
+		SVGStreamGroup(IMapSVGNodes* root, IRender* ctx)
+			: SVGGroup(root)
+			, fContext(ctx)
+		{}
+
+		// The group's own attributes have been loaded, so put its
+		// styling onto the context, for the children to draw with
+		void loadSelfFromXml(const XmlElement& elem) override
+		{
+			SVGGroup::loadSelfFromXml(elem);
+
+			fContext->save();
+			fPushed = true;
+
+			// The group's own paints, the children don't exist yet
+			fStyle.resolveReferences(root());
+
+			// The root starts from the same defaults SVGRootNode draws with
+			if (fRoot == this)
+			{
+				fContext->setFillStyle(BLRgba32(0, 0, 0));
+				fContext->setStrokeStyle(BLRgba32(0));
+				fContext->setStrokeWidth(1.0);
+				fContext->fHidden = SVG_HIDDEN_STROKE;
+				fContext->setTextState(SVGTextState{});
+			}
+
+			applyAttributes(*fContext);
+		}
+
+		void loadFromIterator(XmlElementIterator& iter) override
+		{
+			SVGGroup::loadFromIterator(iter);
+
+			// The group has closed
+			if (fPushed)
+			{
+				fContext->restore();
+				fPushed = false;
+			}
+		}
+
+		// The children were drawn as they were loaded
+		void draw(IRender&) override {}
+
+		// Rather than keeping the node, draw it, and let it go
+		// Only nodes with an id are held onto, for later reference
+		void addNode(std::shared_ptr<SVGVisualNode> node) override
+		{
+			if (node == nullptr)
+				return;
+
+			node->setRoot(fRoot);
+
+			if (!node->id().empty())
+				addDefinition(ByteSpan(node->id().data(), node->id().size()), node);
+
+			if (inDefinitions() || (node->nameId() == SVG_NAME_SYMBOL))
+				return;
+
+			// Only what has already streamed by can be found
+			node->resolveReferences();
+			node->draw(*fContext);
+		}
+
+		void loadCompoundNode(XmlElementIterator& iter) override
+		{
+			switch ((*iter).nameId())
+			{
+			// These are kept whole, same as when loading a document
+			case SVG_NAME_DEFS:
+			case SVG_NAME_LINEARGRADIENT:
+			case SVG_NAME_RADIALGRADIENT:
+			case SVG_NAME_PATTERN:
+			case SVG_NAME_SYMBOL:
+			case SVG_NAME_TEXT:
+			case SVG_NAME_STYLE:
+				SVGGroup::loadCompoundNode(iter);
+			break;
+
+			// Groups, nested <svg>, and anything else, stream
+			default:
+			{
+				auto node = std::make_shared<SVGStreamGroup>(root(), fContext);
+				node->loadFromIterator(iter);
+				addNode(node);
+			}
+			break;
+			}
+		}
+	};
+
+	struct SVGStreamRoot : public SVGStreamGroup
+	{
+		SVGStreamRoot(IRender* ctx)
+			: SVGStreamGroup(nullptr, ctx)
+		{
+			setRoot(this);
+		}
+	};
+
+	// Draw the document in the data straight into the context,
+	// without building a document.
+	// Returns false if there is no <svg> element.
+	static inline bool streamSVG(XmlElementIterator& iter, IRender& ctx, const SVGLoadOptions& options = SVGLoadOptions{})
+	{
+		while (iter)
+		{
+			const XmlElement& elem = *iter;
+			if (!elem)
+				break;
+
+			if (elem.isStart() && (elem.nameId() == SVG_NAME_SVG))
+			{
+				auto root = std::make_shared<SVGStreamRoot>(&ctx);
+				root->setLoadOptions(options);
+				root->loadFromIterator(iter);
+
+				return true;
+			}
+
+			iter++;
+		}
+
+		return false;
+	}
+
+	// Same as parseSVG(), the image is created to the size of the
+	// document, only without building the document along the way.
+	static inline bool streamSVG(const ByteSpan& data, BLImage& outImage, uint32_t threadCount = 0)
+	{
+		SVGDimensions dims{};
+		if (!svgProbeDimensions(data, dims))
+			return false;
+
+		if (outImage.create((int)dims.fWidth, (int)dims.fHeight, BL_FORMAT_PRGB32) != BL_SUCCESS)
+			return false;
+
+		BLContextCreateInfo createInfo{};
+		createInfo.threadCount = threadCount;
+
+		SVGRenderer ctx(outImage, createInfo);
+
+		XmlElementIterator iter(data);
+		bool success = streamSVG(iter, ctx);
+
+		ctx.flush(BL_CONTEXT_FLUSH_SYNC);
+		ctx.end();
+
+		return success;
+	}
+}
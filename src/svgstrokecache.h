@@ -0,0 +1,121 @@
+#pragma once
+
+#include "blend2d.h"
+#include "irender.h"
+
+#include <algorithm>
+#include <mutex>
+
+//
+// SVGStrokeCache
+// The outline of a stroked path, worked out once, and then filled,
+// rather than running the stroker over the path every time it's drawn.
+// For thin strokes over a lot of geometry (CAD, maps), filling the
+// outline is a lot cheaper than stroking.
+//
+// The outline is in user space, and depends on the stroke width, join,
+// caps, and miter limit in effect, as well as on the scale it's drawn at,
+// since curves are flattened to suit the number of pixels they cover.
+// When any of those change, the outline is made again.  Dashed strokes,
+// and strokes applied after the transform, are left to the stroker.
+//
+// The outline is kept for one particular path, not just one of the same
+// size.  A reference to the path it was made from is held onto, and
+// compared by identity, so a different path (a simplified copy, drawn
+// at a level of detail) never gets the outline of another.  As long as
+// the reference is held, the path's data can't change, or be freed and
+// have its address reused.
+//
+namespace svg2b2d {
+
+	struct SVGStrokeCache
+	{
+		std::mutex fMutex{};
+		BLPath fOutline{};
+		bool fValid{ false };
+
+		// What the outline was made with
+		uint64_t fHints{ 0 };		// caps, and join
+		double fWidth{ 0 };
+		double fMiterLimit{ 0 };
+		double fScale{ 0 };
+		BLPath fSource{};			// the path itself, shared, not copied
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fOutline.reset();
+			fSource.reset();
+			fValid = false;
+		}
+
+		// Stroke 'path' by filling its cached outline
+		// Returns false if the stroke can't come from the cache,
+		// and the path should be stroked the regular way.
+		bool stroke(IRender& ctx, const BLPath& path)
+		{
+			// Nothing to stroke with
+			if (ctx.strokeStyleType() == BL_OBJECT_TYPE_NULL)
+				return true;
+
+			const BLStrokeOptions& options = ctx.strokeOptions();
+			if (!options.dashArray.empty() || options.transformOrder != BL_STROKE_TRANSFORM_ORDER_AFTER)
+				return false;
+
+			BLPoint deviceScale = ctx.deviceScale();
+			double scale = std::max(deviceScale.x, deviceScale.y);
+			if (!(scale > 0))
+				return false;
+
+			BLPath outline{};
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+
+				if (!fValid || fHints != options.hints || fWidth != options.width ||
+					fMiterLimit != options.miterLimit || fScale != scale || fSource._d.impl != path._d.impl)
+				{
+					// Flatten to the same tolerance, in pixels, the stroker would
+					BLApproximationOptions approx = ctx.approximationOptions();
+					approx.flattenTolerance /= scale;
+					approx.simplifyTolerance /= scale;
+
+					fOutline.clear();
+					if (fOutline.addStrokedPath(path, options, approx) != BL_SUCCESS)
+					{
+						fValid = false;
+						return false;
+					}
+
+					fHints = options.hints;
+					fWidth = options.width;
+					fMiterLimit = options.miterLimit;
+					fScale = scale;
+					fSource = path;
+					fValid = true;
+				}
+
+				outline = fOutline;
+			}
+
+			// Fill with what the stroke would have drawn with,
+			// then put the fill back the way it was
+			BLVar fillStyle{};
+			BLVar strokeStyle{};
+			ctx.getFillStyle(fillStyle);
+			ctx.getStrokeStyle(strokeStyle);
+			double fillAlpha = ctx.fillAlpha();
+			BLFillRule fillRule = ctx.fillRule();
+
+			ctx.setFillStyle(strokeStyle);
+			ctx.setFillAlpha(ctx.strokeAlpha());
+			ctx.setFillRule(BL_FILL_RULE_NON_ZERO);
+			ctx.fillPath(outline);
+
+			ctx.setFillStyle(fillStyle);
+			ctx.setFillAlpha(fillAlpha);
+			ctx.setFillRule(fillRule);
+
+			return true;
+		}
+	};
+}
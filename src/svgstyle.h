@@ -0,0 +1,433 @@
+#pragma once
+
+#include "svgtypes.h"
+#include "svgstylesheet.h"
+#include "svgfontcache.h"
+
+//
+// SVGStyle
+// The resolved styling state of a single node.  Rather than keeping a map
+// of heap allocated visual properties, each node carries one of these
+// blocks by value.  Attributes are parsed once at load time, straight into
+// the fields, and a bitmask records which of them were actually specified.
+// At draw time, apply() pushes only the set fields into the context, in a
+// fixed order, with no virtual dispatch and no map traversal.
+//
+namespace svg2b2d {
+
+	// Bits in SVGStyle::fSetMask
+	enum SVGStyleField : uint32_t
+	{
+		SVG_STYLE_NONE				= 0,
+		SVG_STYLE_TRANSFORM			= 0x0001,
+		SVG_STYLE_OPACITY			= 0x0002,
+		SVG_STYLE_FILL				= 0x0004,
+		SVG_STYLE_FILL_OPACITY		= 0x0008,
+		SVG_STYLE_FILL_RULE			= 0x0010,
+		SVG_STYLE_STROKE			= 0x0020,
+		SVG_STYLE_STROKE_OPACITY	= 0x0040,
+		SVG_STYLE_STROKE_WIDTH		= 0x0080,
+		SVG_STYLE_STROKE_LINEJOIN	= 0x0100,
+		SVG_STYLE_STROKE_LINECAP	= 0x0200,
+		SVG_STYLE_STROKE_MITERLIMIT	= 0x0400,
+		SVG_STYLE_FONT_SIZE			= 0x0800,
+		SVG_STYLE_TEXT_ANCHOR		= 0x1000,
+		SVG_STYLE_FONT_FAMILY		= 0x2000,
+	};
+
+	struct SVGStyle
+	{
+		uint32_t fSetMask{ SVG_STYLE_NONE };
+
+		BLMatrix2D fTransform{ BLMatrix2D::makeIdentity() };
+		bool fTransformIsTranslation{ false };		// so it can be applied as one
+		double fOpacity{ 1.0 };
+
+		BLVar fFill{};
+		double fFillOpacity{ 1.0 };
+		BLFillRule fFillRule{ BL_FILL_RULE_NON_ZERO };
+
+		BLVar fStroke{};
+		double fStrokeOpacity{ 1.0 };
+		double fStrokeWidth{ 1.0 };
+		BLStrokeJoin fStrokeLineJoin{ BL_STROKE_JOIN_MITER_BEVEL };
+		BLStrokeCap fStrokeLineCap{ BL_STROKE_CAP_BUTT };
+		double fStrokeMiterLimit{ 4.0 };
+
+		double fFontSize{ 12.0 };
+		ALIGNMENT fTextAnchor{ ALIGNMENT::START };
+		BLFontFace fFontFace{};		// what font-family came to, in SVGFontCache
+
+		// Paints given as url(#id), waiting for resolveReferences()
+		ByteSpan fFillRef{};
+		ByteSpan fStrokeRef{};
+
+		// The paints that are set can't draw anything (none, transparent)
+		bool fFillHidden{ false };
+		bool fStrokeHidden{ false };
+
+		SVGStyle() = default;
+		SVGStyle(const SVGStyle& other) { *this = other; }
+
+		// BLVar does not have a copy assignment, so the
+		// paints are assigned by weak reference
+		SVGStyle& operator=(const SVGStyle& rhs)
+		{
+			fSetMask = rhs.fSetMask;
+			fTransform = rhs.fTransform;
+			fTransformIsTranslation = rhs.fTransformIsTranslation;
+			fOpacity = rhs.fOpacity;
+			blVarAssignWeak(&fFill, &rhs.fFill);
+			fFillOpacity = rhs.fFillOpacity;
+			fFillRule = rhs.fFillRule;
+			blVarAssignWeak(&fStroke, &rhs.fStroke);
+			fStrokeOpacity = rhs.fStrokeOpacity;
+			fStrokeWidth = rhs.fStrokeWidth;
+			fStrokeLineJoin = rhs.fStrokeLineJoin;
+			fStrokeLineCap = rhs.fStrokeLineCap;
+			fStrokeMiterLimit = rhs.fStrokeMiterLimit;
+			fFontSize = rhs.fFontSize;
+			fTextAnchor = rhs.fTextAnchor;
+			fFontFace = rhs.fFontFace;
+			fFillRef = rhs.fFillRef;
+			fStrokeRef = rhs.fStrokeRef;
+			fFillHidden = rhs.fFillHidden;
+			fStrokeHidden = rhs.fStrokeHidden;
+
+			return *this;
+		}
+
+		bool isSet(uint32_t field) const { return (fSetMask & field) != 0; }
+		bool empty() const { return fSetMask == SVG_STYLE_NONE; }
+		void markSet(uint32_t field) { fSetMask |= field; }
+
+		// The id out of a url(#id) paint, or an empty span
+		static ByteSpan paintRef(const ByteSpan& inChunk)
+		{
+			ByteSpan str = chunk_trim(inChunk, wspChars);
+			if (!chunk_starts_with_cstr(str, "url("))
+				return {};
+
+			chunk_token(str, "(");
+			auto id = chunk_trim(chunk_token(str, ")"), wspChars);
+			if (*id == '#')
+				id++;
+
+			return id;
+		}
+
+		// Look up a paint reference, and take on its paint
+		static bool resolvePaint(IMapSVGNodes* root, const ByteSpan& ref, BLVar& outVar)
+		{
+			if (root == nullptr)
+				return false;
+
+			auto node = root->findNodeByHref(ref);
+			if (node == nullptr)
+				return false;
+
+			return blVarAssignWeak(&outVar, &node->getVariant()) == BL_SUCCESS;
+		}
+
+		// Load a paint value (fill, stroke) into the specified variant
+		// 'none' is turned into a fully transparent color
+		// A url(#id) is not looked up here, only the id is kept in 'outRef',
+		// to be resolved once everything has been loaded.
+		// When only coverage is drawn, every paint is black, with
+		// the alpha it had, and url(#id) paints are opaque.
+		static bool loadPaint(IMapSVGNodes* root, const ByteSpan& inChunk, BLVar& outVar, ByteSpan& outRef)
+		{
+			bool coverageOnly = (root != nullptr) && root->loadOptions().fCoverageOnly;
+
+			outRef = paintRef(inChunk);
+			if (outRef)
+			{
+				if (coverageOnly)
+				{
+					outRef = {};
+					blVarAssignRgba32(&outVar, 0xff000000);
+				}
+				return true;
+			}
+
+			SVGPaint paint(root);
+			paint.loadFromChunk(inChunk);
+			if (!paint.isSet())
+				return false;
+
+			if (paint.fExplicitNone)
+				blVarAssignRgba32(&outVar, 0);
+			else if (coverageOnly)
+			{
+				uint32_t value = 0xff000000;
+				blVarToRgba32(&paint.fPaint, &value);
+				blVarAssignRgba32(&outVar, value & 0xff000000);
+			}
+			else
+				blVarAssignWeak(&outVar, &paint.fPaint);
+
+			return true;
+		}
+
+		// Replace the alpha of a solid color paint
+		// Paints that are not simple colors (gradients, patterns) are left alone
+		static void applyPaintOpacity(BLVar& aVar, double opacity)
+		{
+			uint32_t outValue;
+			if (BL_SUCCESS == blVarToRgba32(&aVar, &outValue))
+			{
+				BLRgba32 newColor(outValue);
+				newColor.setA((uint32_t)(opacity * 255));
+				blVarAssignRgba32(&aVar, newColor.value);
+			}
+		}
+
+		// Parse a single styling property, identified by its interned name.
+		// Returns false if the name is not a styling property, or
+		// the value could not be parsed.
+		bool loadProperty(IMapSVGNodes* root, SVGNameId nameId, const ByteSpan& inChunk)
+		{
+			if (!inChunk)
+				return false;
+
+			switch (nameId)
+			{
+			case SVG_NAME_TRANSFORM: {
+				SVGTransform prop(root);
+				prop.loadFromChunk(inChunk);
+				if (!prop.isSet())
+					return false;
+				fTransform = prop.fTransform;
+				fTransformIsTranslation = prop.isTranslation();
+				markSet(SVG_STYLE_TRANSFORM);
+			}
+			break;
+
+			case SVG_NAME_OPACITY:
+				fOpacity = parseDimension(inChunk).calculatePixels(1);
+				markSet(SVG_STYLE_OPACITY);
+			break;
+
+			case SVG_NAME_FILL:
+				if (!loadPaint(root, inChunk, fFill, fFillRef))
+					return false;
+				if (!fFillRef)
+					markSet(SVG_STYLE_FILL);
+			break;
+
+			case SVG_NAME_FILL_OPACITY:
+				fFillOpacity = toNumber(inChunk);
+				markSet(SVG_STYLE_FILL_OPACITY);
+			break;
+
+			case SVG_NAME_FILL_RULE: {
+				SVGFillRule prop(root);
+				prop.loadFromChunk(inChunk);
+				if (!prop.isSet())
+					return false;
+				fFillRule = prop.fValue;
+				markSet(SVG_STYLE_FILL_RULE);
+			}
+			break;
+
+			case SVG_NAME_STROKE:
+				if (!loadPaint(root, inChunk, fStroke, fStrokeRef))
+					return false;
+				if (!fStrokeRef)
+					markSet(SVG_STYLE_STROKE);
+			break;
+
+			case SVG_NAME_STROKE_OPACITY:
+				fStrokeOpacity = toNumber(inChunk);
+				markSet(SVG_STYLE_STROKE_OPACITY);
+			break;
+
+			case SVG_NAME_STROKE_WIDTH:
+				fStrokeWidth = toNumber(inChunk);
+				markSet(SVG_STYLE_STROKE_WIDTH);
+			break;
+
+			case SVG_NAME_STROKE_LINEJOIN: {
+				SVGStrokeLineJoin prop(root);
+				prop.loadFromChunk(inChunk);
+				if (!prop.isSet())
+					return false;
+				fStrokeLineJoin = prop.fLineJoin;
+				markSet(SVG_STYLE_STROKE_LINEJOIN);
+			}
+			break;
+
+			case SVG_NAME_STROKE_LINECAP: {
+				SVGStrokeLineCap prop(root);
+				prop.loadFromChunk(inChunk);
+				if (!prop.isSet())
+					return false;
+				fStrokeLineCap = prop.fLineCap;
+				markSet(SVG_STYLE_STROKE_LINECAP);
+			}
+			break;
+
+			case SVG_NAME_STROKE_MITERLIMIT:
+				fStrokeMiterLimit = clamp((float)toNumber(inChunk), 1.0f, 10.0f);
+				markSet(SVG_STYLE_STROKE_MITERLIMIT);
+			break;
+
+			case SVG_NAME_FONT_SIZE:
+				fFontSize = parseDimension(inChunk).calculatePixels(96);
+				markSet(SVG_STYLE_FONT_SIZE);
+			break;
+
+			case SVG_NAME_TEXT_ANCHOR: {
+				SVGTextAnchor prop(root);
+				prop.loadFromChunk(inChunk);
+				fTextAnchor = prop.fValue;
+				markSet(SVG_STYLE_TEXT_ANCHOR);
+			}
+			break;
+
+			// Looked up now, so drawing doesn't have to.  A family
+			// that doesn't come to any face leaves the inherited one.
+			case SVG_NAME_FONT_FAMILY:
+				fFontFace = SVGFontCache::shared().face(chunk_trim(inChunk, wspChars));
+				if (fFontFace.empty())
+					return false;
+				markSet(SVG_STYLE_FONT_FAMILY);
+			break;
+
+			default:
+				return false;
+			}
+
+			return true;
+		}
+
+		// Load all the styling properties found on an element
+		void loadFromXmlElement(IMapSVGNodes* root, const XmlElement& elem)
+		{
+			for (auto& attr : elem.attributes())
+				loadProperty(root, attr.nameId(), attr.value());
+		}
+
+		// Load the properties of the style sheet rules that match the
+		// element, on top of its attributes, in cascade order
+		void loadFromStyleSheet(IMapSVGNodes* root, const SVGStyleSheet& sheet, const XmlElement& elem)
+		{
+			sheet.match(elem.name(), elem.getAttribute(SVG_NAME_ID), elem.getAttribute(SVG_NAME_CLASS),
+				[&](SVGNameId nameId, const ByteSpan& value) {
+					loadProperty(root, nameId, value);
+				});
+		}
+
+		// Load the properties of an inline 'style' attribute, on top
+		// of whatever is already loaded.  Each one goes straight
+		// to its field, by the interned id of its name.
+		void loadFromStyleAttribute(IMapSVGNodes* root, const ByteSpan& inChunk)
+		{
+			CSSInlineStyleIterator iter(inChunk);
+			while (iter.next())
+				loadProperty(root, svgNameId(iter.fCurrentName), iter.fCurrentValue);
+		}
+
+		// Once all the sources of style have been loaded, fold the
+		// fill-opacity and stroke-opacity into the paints they modify.
+		// Like before, they only have an effect on a paint specified
+		// on the same node.
+		void resolve()
+		{
+			if (isSet(SVG_STYLE_FILL) && isSet(SVG_STYLE_FILL_OPACITY))
+				applyPaintOpacity(fFill, fFillOpacity);
+
+			if (isSet(SVG_STYLE_STROKE) && isSet(SVG_STYLE_STROKE_OPACITY))
+				applyPaintOpacity(fStroke, fStrokeOpacity);
+
+			updateVisibility();
+		}
+
+		// Whether the paints that are set could draw anything
+		void updateVisibility()
+		{
+			fFillHidden = isSet(SVG_STYLE_FILL) && !IRender::paintVisible(fFill);
+			fStrokeHidden = isSet(SVG_STYLE_STROKE) && !IRender::paintVisible(fStroke);
+		}
+
+		// Look up the url(#id) paints
+		// A paint is only set if what it refers to is found, otherwise
+		// whatever was there before, or the inherited paint, is used.
+		void resolveReferences(IMapSVGNodes* root)
+		{
+			if (fFillRef)
+			{
+				if (resolvePaint(root, fFillRef, fFill))
+					markSet(SVG_STYLE_FILL);
+				fFillRef = {};
+			}
+
+			if (fStrokeRef)
+			{
+				if (resolvePaint(root, fStrokeRef, fStroke))
+					markSet(SVG_STYLE_STROKE);
+				fStrokeRef = {};
+			}
+
+			updateVisibility();
+		}
+
+		// Apply the set fields to the context, other than those in 'skip'
+		// This is a template so the same code can drive either
+		// a real context, or anything else that tracks the same state
+		// (the display list builder).
+		template <typename CTX>
+		void apply(CTX& ctx, uint32_t skip = SVG_STYLE_NONE) const
+		{
+			uint32_t mask = fSetMask & ~skip;
+			if (mask == SVG_STYLE_NONE)
+				return;
+
+			if (mask & SVG_STYLE_TRANSFORM)
+			{
+				if (fTransformIsTranslation)
+					ctx.translate(fTransform.m20, fTransform.m21);
+				else
+					ctx.transform(fTransform);
+			}
+			if (mask & SVG_STYLE_OPACITY)
+			{
+				ctx.setFillAlpha(fOpacity);
+				ctx.setPaintHidden(SVG_HIDDEN_FILL_ALPHA, fOpacity <= 0);
+			}
+
+			if (mask & SVG_STYLE_FILL)
+			{
+				ctx.setFillStyle(fFill);
+				ctx.setPaintHidden(SVG_HIDDEN_FILL, fFillHidden);
+			}
+			if (mask & SVG_STYLE_FILL_RULE)
+				ctx.setFillRule(fFillRule);
+
+			if (mask & SVG_STYLE_STROKE)
+			{
+				ctx.setStrokeStyle(fStroke);
+				ctx.setPaintHidden(SVG_HIDDEN_STROKE, fStrokeHidden);
+			}
+			if (mask & SVG_STYLE_STROKE_WIDTH)
+			{
+				ctx.setStrokeWidth(fStrokeWidth);
+				ctx.setPaintHidden(SVG_HIDDEN_STROKE_WIDTH, fStrokeWidth <= 0);
+			}
+			if (mask & SVG_STYLE_STROKE_LINEJOIN)
+				ctx.setStrokeJoin(fStrokeLineJoin);
+			if (mask & SVG_STYLE_STROKE_LINECAP)
+				ctx.setStrokeCaps(fStrokeLineCap);
+			if (mask & SVG_STYLE_STROKE_MITERLIMIT)
+				ctx.setStrokeMiterLimit(fStrokeMiterLimit);
+
+			// The font state, for text nodes
+			if (mask & SVG_STYLE_FONT_FAMILY)
+				ctx.setFontFace(fFontFace);
+			if (mask & SVG_STYLE_FONT_SIZE)
+				ctx.setFontSize(fFontSize);
+			if (mask & SVG_STYLE_TEXT_ANCHOR)
+				ctx.setTextAnchor(fTextAnchor == ALIGNMENT::MIDDLE ? 0.5 : (fTextAnchor == ALIGNMENT::END ? 1.0 : 0.0));
+		}
+	};
+}
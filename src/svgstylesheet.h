@@ -0,0 +1,388 @@
+#pragma once
+
+#include "bspanutil.h"
+#include "css.h"
+#include "svgnames.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// SVGStyleSheet
+// The rules of a document's <style> elements, ready to be matched against
+// each element as it loads.  Only simple selectors are supported: a tag,
+// or '*', followed by any number of .class and #id, as in 'rect', '.cls-1',
+// 'path.outline', '#logo'.  Selector lists ('a, b') become a rule for each
+// selector.  Rules with combinators, attribute selectors, or pseudo
+// classes are skipped.
+//
+// Rules are put in buckets, by their id, or their first class, or their
+// tag, so matching an element only looks at the rules that could match
+// it, not every rule in the sheet.  Icon sets with hundreds of .cls-N
+// rules cost about the same per element as a sheet with one.
+//
+// The properties of the rules that match are handed over in cascade
+// order, lowest specificity first, and in document order for the same
+// specificity, so whatever takes them in just has to let later ones
+// override earlier ones.
+//
+// The sheet keeps its own copy of the text, shared with any copies of
+// the sheet, so it doesn't depend on the source staying around.
+//
+namespace svg2b2d {
+
+	struct SVGStyleSheet
+	{
+		struct Declaration
+		{
+			SVGNameId fNameId{ SVG_NAME_UNKNOWN };
+			ByteSpan fValue{};
+		};
+
+		struct Rule
+		{
+			ByteSpan fTag{};					// empty for any
+			ByteSpan fId{};
+			std::vector<ByteSpan> fClasses{};
+			uint32_t fSpecificity{ 0 };
+			uint32_t fFirstDeclaration{ 0 };
+			uint32_t fDeclarationCount{ 0 };
+		};
+
+		std::vector<std::shared_ptr<const std::string>> fTexts{};
+		std::vector<Rule> fRules{};
+		std::vector<Declaration> fDeclarations{};
+
+		std::unordered_map<uint64_t, std::vector<uint32_t>> fById{};
+		std::unordered_map<uint64_t, std::vector<uint32_t>> fByClass{};
+		std::unordered_map<uint64_t, std::vector<uint32_t>> fByTag{};
+		std::vector<uint32_t> fUniversal{};
+
+		size_t size() const { return fRules.size(); }
+		bool empty() const { return fRules.empty(); }
+
+		void clear()
+		{
+			fTexts.clear();
+			fRules.clear();
+			fDeclarations.clear();
+			fById.clear();
+			fByClass.clear();
+			fByTag.clear();
+			fUniversal.clear();
+		}
+
+		// About how much memory the sheet holds onto
+		size_t bytes() const
+		{
+			size_t n = fRules.capacity() * sizeof(Rule) + fDeclarations.capacity() * sizeof(Declaration);
+			for (const auto& text : fTexts)
+				n += text->capacity();
+			for (const auto& rule : fRules)
+				n += rule.fClasses.capacity() * sizeof(ByteSpan);
+
+			for (const auto* buckets : { &fById, &fByClass, &fByTag })
+			{
+				n += buckets->bucket_count() * sizeof(void*);
+				for (const auto& b : *buckets)
+					n += sizeof(b) + 2 * sizeof(void*) + b.second.capacity() * sizeof(uint32_t);
+			}
+			n += fUniversal.capacity() * sizeof(uint32_t);
+
+			return n;
+		}
+
+		// Add the rules of a style sheet, after the ones already there
+		void load(const ByteSpan& css)
+		{
+			auto text = std::make_shared<std::string>();
+			text->reserve(css.size());
+			stripComments(css, *text);
+			fTexts.push_back(text);
+
+			static constexpr charset openChars("{");
+			static constexpr charset commaChars(",");
+
+			ByteSpan s(text->data(), text->size());
+			while (s)
+			{
+				ByteSpan selectors = chunk_trim(chunk_token(s, openChars), wspChars);
+				ByteSpan block = nextBlock(s);
+
+				// At-rules (@media, @font-face) aren't supported, they're
+				// skipped whole, along with any rules nested in them
+				if (!selectors || *selectors == '@')
+					continue;
+
+				uint32_t firstDecl = (uint32_t)fDeclarations.size();
+				loadDeclarations(block);
+				uint32_t declCount = (uint32_t)fDeclarations.size() - firstDecl;
+				if (declCount == 0)
+					continue;
+
+				while (selectors)
+				{
+					Rule rule{};
+					if (!parseSelector(chunk_trim(chunk_token(selectors, commaChars), wspChars), rule))
+						continue;
+
+					rule.fFirstDeclaration = firstDecl;
+					rule.fDeclarationCount = declCount;
+					addRule(std::move(rule));
+				}
+			}
+		}
+
+		// Call fn(nameId, value) for every property of every rule that
+		// matches an element with the tag, id, and class attribute, in
+		// cascade order
+		template <typename FN>
+		void match(const ByteSpan& tag, const ByteSpan& id, const ByteSpan& classes, FN&& fn) const
+		{
+			if (fRules.empty())
+				return;
+
+			// (specificity, rule) pairs, sorting them puts them in
+			// cascade order, since rules are in document order
+			thread_local std::vector<uint64_t> matched{};
+			matched.clear();
+
+			auto gather = [&](const std::vector<uint32_t>& bucket) {
+				for (uint32_t r : bucket)
+				{
+					if (matches(fRules[r], tag, id, classes))
+						matched.push_back(((uint64_t)fRules[r].fSpecificity << 32) | r);
+				}
+			};
+
+			gathered(fUniversal, gather);
+			if (tag)
+				gathered(fByTag, svg_hash64(tag), gather);
+			if (id)
+				gathered(fById, svg_hash64(id), gather);
+
+			ByteSpan cs = classes;
+			while (cs)
+			{
+				ByteSpan cls = nextClass(cs);
+				if (cls)
+					gathered(fByClass, svg_hash64(cls), gather);
+			}
+
+			if (matched.empty())
+				return;
+
+			// An element with the same class twice finds a rule twice
+			std::sort(matched.begin(), matched.end());
+			matched.erase(std::unique(matched.begin(), matched.end()), matched.end());
+
+			for (uint64_t m : matched)
+			{
+				const Rule& rule = fRules[(uint32_t)m];
+				for (uint32_t d = 0; d < rule.fDeclarationCount; d++)
+				{
+					const Declaration& decl = fDeclarations[rule.fFirstDeclaration + d];
+					fn(decl.fNameId, decl.fValue);
+				}
+			}
+		}
+
+	private:
+		template <typename FN>
+		static void gathered(const std::vector<uint32_t>& bucket, FN& fn)
+		{
+			if (!bucket.empty())
+				fn(bucket);
+		}
+
+		template <typename FN>
+		static void gathered(const std::unordered_map<uint64_t, std::vector<uint32_t>>& buckets, uint64_t key, FN& fn)
+		{
+			auto it = buckets.find(key);
+			if (it != buckets.end())
+				fn(it->second);
+		}
+
+		static ByteSpan nextClass(ByteSpan& cs)
+		{
+			cs = chunk_skip_wsp(cs);
+			const uint8_t* start = cs.fStart;
+			while (cs && !wspChars(*cs))
+				cs++;
+
+			return ByteSpan(start, cs.fStart);
+		}
+
+		static bool hasClass(const ByteSpan& classes, const ByteSpan& cls)
+		{
+			ByteSpan cs = classes;
+			while (cs)
+			{
+				if (nextClass(cs) == cls)
+					return true;
+			}
+
+			return false;
+		}
+
+		static bool matches(const Rule& rule, const ByteSpan& tag, const ByteSpan& id, const ByteSpan& classes)
+		{
+			if (rule.fTag && rule.fTag != tag)
+				return false;
+			if (rule.fId && rule.fId != id)
+				return false;
+
+			for (const auto& cls : rule.fClasses)
+			{
+				if (!hasClass(classes, cls))
+					return false;
+			}
+
+			return true;
+		}
+
+		void addRule(Rule&& rule)
+		{
+			uint32_t index = (uint32_t)fRules.size();
+
+			// The bucket of whatever narrows it down the most
+			if (rule.fId)
+				fById[svg_hash64(rule.fId)].push_back(index);
+			else if (!rule.fClasses.empty())
+				fByClass[svg_hash64(rule.fClasses[0])].push_back(index);
+			else if (rule.fTag)
+				fByTag[svg_hash64(rule.fTag)].push_back(index);
+			else
+				fUniversal.push_back(index);
+
+			fRules.push_back(std::move(rule));
+		}
+
+		// tag, or '*', then any number of .class, and #id
+		static bool parseSelector(const ByteSpan& inChunk, Rule& rule)
+		{
+			static constexpr charset nameChars("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_");
+
+			ByteSpan s = inChunk;
+			if (!s)
+				return false;
+
+			auto readName = [&]() {
+				const uint8_t* start = s.fStart;
+				while (s && nameChars(*s))
+					s++;
+				return ByteSpan(start, s.fStart);
+			};
+
+			if (*s == '*')
+				s++;
+			else if (nameChars(*s))
+				rule.fTag = readName();
+
+			while (s)
+			{
+				uint8_t c = *s;
+				if (c != '.' && c != '#')
+					return false;	// a combinator, or something else not supported
+
+				s++;
+				ByteSpan name = readName();
+				if (!name)
+					return false;
+
+				if (c == '.')
+				{
+					rule.fClasses.push_back(name);
+				}
+				else
+				{
+					if (rule.fId && rule.fId != name)
+						return false;
+					rule.fId = name;
+				}
+			}
+
+			rule.fSpecificity = (rule.fId ? 0x10000 : 0) + ((uint32_t)rule.fClasses.size() << 8) + (rule.fTag ? 1 : 0);
+
+			return true;
+		}
+
+		// The properties that are known, !important is ignored
+		void loadDeclarations(const ByteSpan& block)
+		{
+			CSSInlineStyleIterator iter(block);
+			while (iter.next())
+			{
+				SVGNameId nameId = svgNameId(iter.fCurrentName);
+				if (nameId == SVG_NAME_UNKNOWN)
+					continue;
+
+				ByteSpan value = iter.fCurrentValue;
+				ByteSpan bang = chunk_find_char(value, '!');
+				if (bang)
+					value = chunk_trim(ByteSpan(value.fStart, bang.fStart), wspChars);
+
+				if (value)
+					fDeclarations.push_back({ nameId, value });
+			}
+		}
+
+		// The body of the block that was just opened, up to the '}' that
+		// closes it, not one of a block nested inside it, or one in a
+		// quoted string.  s is left after that '}'.
+		static ByteSpan nextBlock(ByteSpan& s)
+		{
+			const uint8_t* p = s.fStart;
+			const uint8_t* end = s.fEnd;
+			int depth = 0;
+			uint8_t quote = 0;
+			for (; p < end; p++)
+			{
+				uint8_t c = *p;
+				if (quote)
+				{
+					if (c == '\\' && (p + 1) < end)
+						p++;
+					else if (c == quote)
+						quote = 0;
+				}
+				else if (c == '"' || c == '\'')
+					quote = c;
+				else if (c == '{')
+					depth++;
+				else if (c == '}' && depth-- == 0)
+					break;
+			}
+
+			ByteSpan block(s.fStart, p);
+			s.fStart = (p < end) ? p + 1 : end;
+
+			return block;
+		}
+
+		static void stripComments(const ByteSpan& css, std::string& out)
+		{
+			const uint8_t* p = css.fStart;
+			const uint8_t* end = css.fEnd;
+			while (p < end)
+			{
+				if (*p == '/' && (p + 1) < end && p[1] == '*')
+				{
+					p += 2;
+					while ((p + 1) < end && !(p[0] == '*' && p[1] == '/'))
+						p++;
+
+					// An unterminated comment runs to the end
+					p = ((p + 1) < end) ? p + 2 : end;
+					out.push_back(' ');
+					continue;
+				}
+
+				out.push_back((char)*p++);
+			}
+		}
+	};
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// SVGThreadPool
+// A fixed set of worker threads, fed from a single task queue.
+//
+// For batches of independent items, use parallelFor().  Rather than
+// handing each worker a fixed slice up front, every worker claims the
+// next unclaimed item from a shared atomic cursor.  A worker that gets
+// a run of cheap items simply comes back for more, so the load evens out
+// the same way it would with work stealing, without per-worker queues.
+//
+namespace svg2b2d {
+
+	struct SVGThreadPool
+	{
+		std::vector<std::thread> fThreads{};
+		std::deque<std::function<void()>> fTasks{};
+		std::mutex fMutex{};
+		std::condition_variable fTaskReady{};
+		std::condition_variable fTaskDone{};
+		size_t fActive{ 0 };
+		bool fStopping{ false };
+
+		// threadCount == 0 means use as many threads as the hardware has
+		SVGThreadPool(size_t threadCount = 0)
+		{
+			if (threadCount == 0)
+				threadCount = std::thread::hardware_concurrency();
+			if (threadCount == 0)
+				threadCount = 1;
+
+			fThreads.reserve(threadCount);
+			for (size_t i = 0; i < threadCount; i++)
+				fThreads.emplace_back([this]() { workerLoop(); });
+		}
+
+		SVGThreadPool(const SVGThreadPool&) = delete;
+		SVGThreadPool& operator=(const SVGThreadPool&) = delete;
+
+		~SVGThreadPool()
+		{
+			{
+				std::unique_lock<std::mutex> lock(fMutex);
+				fStopping = true;
+			}
+			fTaskReady.notify_all();
+
+			for (auto& t : fThreads)
+				t.join();
+		}
+
+		size_t size() const { return fThreads.size(); }
+
+		// Queue a task to be run by one of the workers
+		void submit(std::function<void()> task)
+		{
+			{
+				std::unique_lock<std::mutex> lock(fMutex);
+				fTasks.push_back(std::move(task));
+			}
+			fTaskReady.notify_one();
+		}
+
+		// Block until the queue is empty, and no worker is busy
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(fMutex);
+			fTaskDone.wait(lock, [this]() { return fTasks.empty() && fActive == 0; });
+		}
+
+		// Call fn(itemIndex, workerSlot) for every item in [0, count)
+		// and return when they have all been processed.
+		// workerSlot is in [0, size()), and no two calls running at the
+		// same time share a slot, so it can be used to index per-worker
+		// scratch state without any locking.
+		void parallelFor(size_t count, const std::function<void(size_t, size_t)>& fn)
+		{
+			if (count == 0)
+				return;
+
+			std::atomic<size_t> cursor{ 0 };
+			size_t slots = count < size() ? count : size();
+
+			std::mutex doneMutex;
+			std::condition_variable doneCondition;
+			size_t remaining = slots;
+
+			for (size_t slot = 0; slot < slots; slot++)
+			{
+				submit([&, slot]() {
+					for (;;)
+					{
+						size_t idx = cursor.fetch_add(1, std::memory_order_relaxed);
+						if (idx >= count)
+							break;
+						fn(idx, slot);
+					}
+
+					std::unique_lock<std::mutex> lock(doneMutex);
+					if (--remaining == 0)
+						doneCondition.notify_one();
+				});
+			}
+
+			std::unique_lock<std::mutex> lock(doneMutex);
+			doneCondition.wait(lock, [&]() { return remaining == 0; });
+		}
+
+	private:
+		void workerLoop()
+		{
+			for (;;)
+			{
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(fMutex);
+					fTaskReady.wait(lock, [this]() { return fStopping || !fTasks.empty(); });
+
+					if (fTasks.empty())
+						return;		// stopping, and nothing left to do
+
+					task = std::move(fTasks.front());
+					fTasks.pop_front();
+					fActive++;
+				}
+
+				task();
+
+				{
+					std::unique_lock<std::mutex> lock(fMutex);
+					fActive--;
+					if (fTasks.empty() && fActive == 0)
+						fTaskDone.notify_all();
+				}
+			}
+		}
+	};
+}
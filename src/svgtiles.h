@@ -0,0 +1,135 @@
+#pragma once
+
+#include "svgshapes.h"
+#include "svgthreadpool.h"
+
+#include <functional>
+#include <vector>
+
+//
+// Tiled rendering
+// Render a document at a size that would be too big to hold as a single
+// image.  The output is cut into fixed size tiles, each one rendered into
+// its own small image, with the translation that puts it in the right 
+// spot.  Each tile's image is the size of the tile, so bounds culling 
+// skips everything that falls outside of it.
+//
+// Tiles are rendered a row at a time, with the tiles of a row spread
+// across a pool of threads.  Once a row is finished, its tiles are handed
+// to the callback, in order, left to right, on the calling thread.  That
+// suits writers that want the output a band of rows at a time (PNG, TIFF),
+// and it means at most one row of tiles is in memory at any time, no 
+// matter how big the output is.
+//
+// Usage:
+//   SVGTileOptions opts{};
+//   opts.fScale = 16;
+//   renderTiles(doc, opts, [&](const SVGTile& tile) {
+//       writer.write(tile.fX, tile.fY, *tile.fImage);
+//       return true;
+//   });
+//
+namespace svg2b2d {
+
+	struct SVGTileOptions
+	{
+		int fTileWidth{ 512 };
+		int fTileHeight{ 512 };
+		double fScale{ 1.0 };			// output pixels per document unit
+		int fWidth{ 0 };				// size of the whole output
+		int fHeight{ 0 };				// 0 means the document size, times the scale
+		uint32_t fThreadCount{ 0 };		// threads rendering tiles, 0 is one per hardware thread
+	};
+
+	struct SVGTile
+	{
+		int fColumn{ 0 };
+		int fRow{ 0 };
+		int fX{ 0 };					// where the tile goes in the whole output
+		int fY{ 0 };
+		const BLImage* fImage{ nullptr };	// only valid for the duration of the callback
+	};
+
+	// Return false to stop rendering
+	using SVGTileCallback = std::function<bool(const SVGTile&)>;
+
+	// Render the document as tiles, handing each finished tile to the callback
+	// Returns the number of tiles that were delivered
+	static inline size_t renderTiles(SVGDocument& doc, const SVGTileOptions& options, const SVGTileCallback& onTile)
+	{
+		if (options.fTileWidth <= 0 || options.fTileHeight <= 0 || options.fScale <= 0)
+			return 0;
+
+		int width = options.fWidth > 0 ? options.fWidth : (int)(doc.width() * options.fScale);
+		int height = options.fHeight > 0 ? options.fHeight : (int)(doc.height() * options.fScale);
+		if (width <= 0 || height <= 0)
+			return 0;
+
+		int columns = (width + options.fTileWidth - 1) / options.fTileWidth;
+		int rows = (height + options.fTileHeight - 1) / options.fTileHeight;
+
+		// The workers all draw the same document, so nothing 
+		// in it can be left to be computed on first use
+		doc.prepare();
+
+		SVGThreadPool pool(options.fThreadCount);
+		std::vector<SVGRenderer> contexts(pool.size());
+		std::vector<BLImage> band(columns);
+		std::vector<uint8_t> rendered(columns);	// not vector<bool>, the workers write to it at the same time
+
+		size_t delivered = 0;
+
+		for (int row = 0; row < rows; row++)
+		{
+			int y = row * options.fTileHeight;
+			int th = (height - y) < options.fTileHeight ? (height - y) : options.fTileHeight;
+
+			pool.parallelFor(columns, [&](size_t col, size_t slot) {
+				int x = (int)col * options.fTileWidth;
+				int tw = (width - x) < options.fTileWidth ? (width - x) : options.fTileWidth;
+
+				BLImage& img = band[col];
+				SVGRenderer& ctx = contexts[slot];
+				rendered[col] = 0;
+
+				try {
+					if (img.width() != tw || img.height() != th)
+					{
+						if (img.create(tw, th, BL_FORMAT_PRGB32) != BL_SUCCESS)
+							return;
+					}
+
+					if (ctx.begin(img) != BL_SUCCESS)
+						return;
+
+					ctx.clearAll();
+					ctx.translate(-x, -y);
+					ctx.scale(options.fScale);
+
+					doc.draw(ctx);
+					ctx.end();
+
+					rendered[col] = 1;
+				}
+				catch (...) {
+					ctx.end();
+				}
+			});
+
+			// Hand the row over, in order
+			for (int col = 0; col < columns; col++)
+			{
+				if (!rendered[col])
+					return delivered;
+
+				SVGTile tile{ col, row, col * options.fTileWidth, y, &band[col] };
+				if (!onTile(tile))
+					return delivered;
+
+				delivered++;
+			}
+		}
+
+		return delivered;
+	}
+}
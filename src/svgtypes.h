@@ -7,36 +7,220 @@
 #include "css.h"
 
 #include <memory>
+#include <memory_resource>
+#include <string>
+#include <unordered_set>
 #include <vector>
 #include <cstdint>		// uint8_t, etc
 #include <cstddef>		// nullptr_t, ptrdiff_t, size_t
+#include <cstdlib>
 
 
 namespace svg2b2d {
-	struct IMapSVGNodes;    // forward declaration
+	struct SVGObject;       // forward declarations
+	struct SVGDisplayListBuilder;
+	struct SVGThreadPool;
+	struct SVGInstanceCache;
+	struct SVGStyleSheet;
+
+	// Options that control how a document is loaded
+	struct SVGLoadOptions
+	{
+		// Allocate all the nodes from a monotonic arena owned by the 
+		// document, rather than one heap allocation per node.
+		// Nodes must not be held onto past the life of the document, 
+		// or past a call to clear().
+		bool fUseArena{ false };
+		size_t fArenaBlockSize{ 64 * 1024 };
+
+		// Keep a full copy of the XmlElement each node was loaded from.
+		// It's only needed for debugging, or tools that want to look at
+		// attributes after the fact.  Without it, a node only keeps a 
+		// ByteSpan of its tag, which points into the source data.
+		bool fRetainSourceElements{ false };
+
+		// Make a quick pass over path data to estimate its size, 
+		// and reserve that much space before parsing it, so huge 
+		// paths are not repeatedly grown and copied.
+		bool fReservePaths{ true };
+
+		// Don't parse path data ('d', and 'points') while loading.  The 
+		// shapes hold onto a ByteSpan of the attribute, and parse it the
+		// first time it's drawn, or its geometry is asked for.  Geometry 
+		// that is never drawn, like unused <defs>, costs almost nothing.
+		// The source data must stay valid, and unchanged, for as long as 
+		// the document is in use (mmap'd files, for instance).
+		bool fLazyPaths{ false };
+
+		// Look up embedded <image> data in SVGImageCache::shared(), so 
+		// the same image is only decoded once, no matter how many times,
+		// or in how many documents, it appears.
+		bool fCacheImages{ true };
+
+		// Decode embedded <image> data on this pool, in the background,
+		// while the rest of the document loads.  Drawing an image waits 
+		// for its decode, if it hasn't finished yet.  The pool must 
+		// outlive the loading.  nullptr decodes while loading.
+		SVGThreadPool* fImagePool{ nullptr };
+
+		// Embedded images larger than this, in either direction, are 
+		// scaled down to fit as soon as they're decoded, and only the
+		// smaller one is kept.  The codecs always decode at full size,
+		// so the full size pixels are only around briefly.  0 keeps 
+		// images at the size they decode to.
+		int fMaxImageSize{ 0 };
+
+		// Stroke paths by filling an outline of the stroke, made the first
+		// time it's drawn, rather than stroking them every time.  Worth it
+		// for documents that are drawn over and over at the same scale.  A
+		// change of scale, or stroke, makes the outline again.
+		bool fCacheStrokes{ false };
+
+		// Load the larger top level <g> elements of the document on this
+		// pool, each on its own, in parallel with the rest of the document.
+		// Groups smaller than fParallelMinBytes, of source, are loaded in
+		// place.  nullptr loads everything in order, on the calling thread.
+		SVGThreadPool* fLoadPool{ nullptr };
+		size_t fParallelMinBytes{ 64 * 1024 };
+
+		// Only what the document covers is going to be drawn (into an A8
+		// mask), not its colors.  Paints are loaded as black, keeping
+		// just their opacity, and url(#id) paints aren't looked up, so
+		// no gradient, or pattern, is ever made.
+		bool fCoverageOnly{ false };
+
+		// Where the counts of loading, and drawing, go.  Only kept when
+		// SVG_ENABLE_STATS is defined.  nullptr uses the document's own.
+		SVGStats* fStats{ nullptr };
+	};
     
 
     
+    // Core interface to hold document level state, primarily
+    // for the purpose of looking up nodes.
+    struct IMapSVGNodes
+    {
+        // Lookups don't allocate, and a miss doesn't add anything
+        virtual std::shared_ptr<SVGObject> findNodeById(const ByteSpan& id) = 0;
+        virtual std::shared_ptr<SVGObject> findNodeByHref(const ByteSpan& href) = 0;
+
+        
+        virtual void addDefinition(const ByteSpan& id, std::shared_ptr<SVGObject> obj) = 0;
+
+        virtual void setInDefinitions(bool indefs) = 0;
+        virtual bool inDefinitions() const = 0;
+
+        // The options the document is being loaded with
+        virtual const SVGLoadOptions& loadOptions() 
+        { 
+            static const SVGLoadOptions defaultOptions{};
+            return defaultOptions; 
+        }
+
+        // Where the nodes of the document get their memory
+        // nullptr means the regular heap
+        virtual std::pmr::memory_resource* nodeResource() { return nullptr; }
+
+        // The rules of the <style> elements loaded so far, which
+        // elements are matched against as they load
+        virtual SVGStyleSheet* styleSheet() { return nullptr; }
+    };
+
+    // SVGMemoryUsage
+    // How much memory a loaded document holds onto, by what it's for.
+    // It's an estimate, of what's been allocated, not what the allocator
+    // has actually handed out, but close enough for a cache to keep a
+    // budget with.  Nodes, and images, that are shared, or are both drawn
+    // and in the index of definitions, are only counted once.
+    struct SVGMemoryUsage
+    {
+        size_t fNodes{ 0 };             // the node objects themselves
+        size_t fNodeCount{ 0 };
+        size_t fPaths{ 0 };             // geometry, as allocated
+        size_t fPathsUsed{ 0 };         // of that, what's actually used
+        size_t fImages{ 0 };            // decoded pixels, and their smaller copies
+        size_t fStrings{ 0 };           // names, ids, and text, copied out of the source
+        size_t fMaps{ 0 };              // child lists, the index of ids, style sheets
+        size_t fCaches{ 0 };            // stroke outlines, and simplified paths
+        size_t fLoadOnly{ 0 };          // only needed while loading, shrink() frees it
+
+        std::unordered_set<const void*> fCounted{};
+
+        size_t total() const { return fNodes + fPaths + fImages + fStrings + fMaps + fCaches + fLoadOnly; }
+
+        // true the first time it's asked about 'p'
+        bool first(const void* p) { return p != nullptr && fCounted.insert(p).second; }
+
+        // What a string has on the heap, nothing when it fits within itself
+        static size_t stringBytes(const std::string& s)
+        {
+            static const size_t inplace = std::string().capacity();
+            return s.capacity() > inplace ? s.capacity() + 1 : 0;
+        }
+
+        static size_t pathBytes(const BLPath& path) { return path.capacity() * (sizeof(BLPoint) + 1); }
+
+        static size_t imageBytes(const BLImage& img)
+        {
+            BLImageData data{};
+            if (img.empty() || img.getData(&data) != BL_SUCCESS)
+                return 0;
+
+            return (size_t)std::abs((long long)data.stride) * (size_t)data.size.h;
+        }
+
+        void addPath(const BLPath& path)
+        {
+            if (!first(path._d.impl))
+                return;
+            fPaths += pathBytes(path);
+            fPathsUsed += path.size() * (sizeof(BLPoint) + 1);
+        }
+
+        void addImage(const BLImage& img)
+        {
+            if (first(img._d.impl))
+                fImages += imageBytes(img);
+        }
+    };
+
     struct SVGObject : public IDrawable
     {
-        XmlElement fSourceElement;
+        ByteSpan fSourceSpan{};     // the text of the tag, within the source data
+        std::unique_ptr<XmlElement> fSourceElement{};   // only if the load options ask for it
         
         IMapSVGNodes* fRoot{ nullptr };
         std::string fName{};    // The tag name of the element
+        SVGNameId fNameId{ SVG_NAME_UNKNOWN };  // Interned id of the tag name
         BLVar fVar{};
         bool fIsVisible{ false };
+
+        // Bounds of what the node draws, in the coordinate space of its
+        // parent (its own transform applied), including the reach of any
+        // stroke width set by the node, or below it.  A stroke inherited
+        // from above is only known at draw time, so it isn't included.  
+        // fExtentStrokeScale is how much the node, and its children, can
+        // stretch such an inherited stroke.
         BLBox fExtent{};
+        double fExtentStrokeScale{ 1.0 };
+        bool fExtentValid{ false };
+
+        // Only for nodes that a <use> refers to, see SVGInstanceCache
+        std::shared_ptr<SVGInstanceCache> fInstances{};
+
+        uint32_t fNodeBytes{ 0 };   // as allocated by makeNode()
 
         
         
 		SVGObject() = delete;
-        SVGObject(const SVGObject& other) :fName(other.fName) {}
+        SVGObject(const SVGObject& other) :fName(other.fName), fNameId(other.fNameId) {}
         SVGObject(IMapSVGNodes* root) :fRoot(root) {}
 		virtual ~SVGObject() = default;
         
 		SVGObject& operator=(const SVGObject& other) {
             fRoot = other.fRoot;
             fName = other.fName;
+            fNameId = other.fNameId;
 			BLVar fVar = other.fVar;
             
             return *this;
@@ -47,11 +231,15 @@ namespace svg2b2d {
         
         const std::string& name() const { return fName; }
         void setName(const std::string& name) { fName = name; }
+        SVGNameId nameId() const { return fNameId; }
 
 		const bool visible() const { return fIsVisible; }
 		void setVisible(bool visible) { fIsVisible = visible; }
         
-        const XmlElement& sourceElement() const { return fSourceElement; }
+        // The element this node was loaded from
+        // nullptr unless the document was loaded with fRetainSourceElements
+        const XmlElement* sourceElement() const { return fSourceElement.get(); }
+        const ByteSpan& sourceSpan() const { return fSourceSpan; }
         
         // sub-classes should return something interesting as BLVar
         // This can be used for styling, so images, colors, patterns, gradients, etc
@@ -64,18 +252,113 @@ namespace svg2b2d {
         {
             ;// draw the object
         }
+
+        // The bounds of the node, calculated the first time they're
+        // asked for.  It is marked valid before calculating, so a node
+        // that somehow refers back to itself sees 'unbounded' instead
+        // of recursing forever.
+        const BLBox& extent()
+        {
+            if (!fExtentValid)
+            {
+                fExtentValid = true;
+                fExtent = svgBoxUnbounded();
+                fExtentStrokeScale = 1.0;
+                calculateExtent();
+            }
+
+            return fExtent;
+        }
+
+        // Compute everything that would otherwise be filled in the first
+        // time the node is drawn, so drawing doesn't modify it.  Sub-classes
+        // that fill in more than their bounds override this, and call it.
+        virtual void prepare()
+        {
+            extent();
+        }
+
+        // Fill in fExtent, and fExtentStrokeScale
+        // Objects that don't know what they cover say they could cover 
+        // anything, so they are never culled.
+        virtual void calculateExtent()
+        {
+            fExtent = svgBoxUnbounded();
+        }
+
+        // Called once the whole document has been loaded, to look up
+        // anything that refers to other nodes by id.  Done then, rather
+        // than while loading, everything can be found, no matter where in
+        // the document it is, and drawing then needs no lookups at all.
+        virtual void resolveReferences()
+        {
+            ;
+        }
+
+        // Whether drawing the object, with layers on, draws some of it
+        // into a layer, which a display list doesn't record.
+        virtual bool drawsLayers()
+        {
+            return false;
+        }
+
+        // Record the drawing of the object into a display list
+        // By default, objects have nothing to contribute
+        virtual void compile(SVGDisplayListBuilder& builder)
+        {
+            ;
+        }
         
         virtual void loadSelfFromXml(const XmlElement& elem)
         {
             ;
         }
 
+        // Add what the node holds onto to 'usage', once, no
+        // matter how many places it's referred to from
+        void memoryUsage(SVGMemoryUsage& usage) const
+        {
+            if (!usage.first(this))
+                return;
+
+            usage.fNodeCount++;
+            usage.fNodes += (fNodeBytes != 0) ? fNodeBytes : sizeof(*this);
+            addMemoryUsage(usage);
+        }
+
+        // Sub-classes add what they allocate, and call their base
+        virtual void addMemoryUsage(SVGMemoryUsage& usage) const
+        {
+            usage.fStrings += SVGMemoryUsage::stringBytes(fName);
+
+            if (fSourceElement != nullptr)
+            {
+                usage.fLoadOnly += sizeof(XmlElement) + fSourceElement->attributes().capacity() * sizeof(XmlAttribute);
+            }
+        }
+
+        // Once loading is done, free what's only needed for loading, and
+        // give back the spare capacity of everything that was grown as it
+        // loaded.  Not to be called while the node is being drawn.
+        virtual void shrink()
+        {
+            fSourceElement = nullptr;
+            fName.shrink_to_fit();
+        }
+
         virtual void loadFromXmlElement(const svg2b2d::XmlElement& elem)
         {
-            fSourceElement = elem;
+            fSourceSpan = elem.data();
+            if (fRoot != nullptr && fRoot->loadOptions().fRetainSourceElements)
+            {
+                // Scanned now, so the retained copy never changes after loading
+                fSourceElement = std::make_unique<XmlElement>(elem);
+                fSourceElement->attributes();
+            }
             
             // load the common attributes
-            setName(elem.name());
+            setName(toString(elem.name()));
+            fNameId = elem.nameId();
 
             // call to loadselffromxml
             // so sub-class can do its own loading
@@ -83,19 +366,34 @@ namespace svg2b2d {
         }
     };
     
-    // Core interface to hold document level state, primarily
-    // for the purpose of looking up nodes.
-    struct IMapSVGNodes
+
+    // Add to one of the counts of the document of 'root', if
+    // it's keeping any.  Calls are wrapped in SVG_STATS().
+    inline void svgCount(IMapSVGNodes* root, std::atomic<uint64_t> SVGStats::* counter, uint64_t n = 1)
     {
-        virtual std::shared_ptr<SVGObject> findNodeById(const std::string& name) = 0;
-        virtual std::shared_ptr<SVGObject> findNodeByHref(const ByteSpan& href) = 0;
+        SVGStats* stats = (root != nullptr) ? root->loadOptions().fStats : nullptr;
+        if (stats != nullptr)
+            SVGStats::add(stats->*counter, n);
+    }
 
-        
-        virtual void addDefinition(const std::string& name, std::shared_ptr<SVGObject> obj) = 0;
+    // Create a node that belongs to the document of 'root'
+    // When the document has a node arena, the node, along with its
+    // shared_ptr control block, is allocated from the arena.
+    // Otherwise, it comes from the heap, same as make_shared.
+    template <typename T>
+    std::shared_ptr<T> makeNode(IMapSVGNodes* root)
+    {
+        SVG_STATS(svgCount(root, &SVGStats::fNodeAllocations));
+        SVG_STATS(svgCount(root, &SVGStats::fNodeBytes, sizeof(T)));
 
-        virtual void setInDefinitions(bool indefs) = 0;
-        virtual bool inDefinitions() const = 0;
-    };
+        std::pmr::memory_resource* mr = (root != nullptr) ? root->nodeResource() : nullptr;
+        std::shared_ptr<T> node = (mr != nullptr)
+            ? std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(mr), root)
+            : std::make_shared<T>(root);
+        node->fNodeBytes = (uint32_t)sizeof(T);
+
+        return node;
+    }
     
     
     // SVGVisualProperty
@@ -383,34 +681,6 @@ enum class ALIGNMENT : unsigned
 }
 
 
-namespace svg2b2d {
-    void parseStyleAttribute(const ByteSpan & inChunk, XmlElement &styleElement)
-    {
-        // Turn the style element into attributes of an XmlElement, 
-        // then, the caller can use that to more easily parse whatever they're
-        // looking for.
-        ByteSpan styleChunk = inChunk;
-        
-        if (styleChunk) {
-            // use CSSInlineIterator to iterate through the key value pairs
-            // creating a visual attribute, using the gSVGPropertyCreation map
-            CSSInlineStyleIterator iter(styleChunk);
-
-            while (iter.next())
-            {
-                std::string name = std::string((*iter).first.fStart, (*iter).first.fEnd);
-                if (!name.empty() && (*iter).second)
-                {
-                    styleElement.addAttribute(name, (*iter).second);
-                }
-            }
-
-        }
-
-        return;
-    }
-}
-
 //======================================================
 // Definition of SVG Paint
 //======================================================
@@ -515,17 +785,16 @@ namespace svg2b2d {
 
     static BLRgba32 parseColorName(const ByteSpan& inChunk)
     {
-        std::string cName = std::string(inChunk.fStart, inChunk.fEnd);
-
         // If named color not found
         // or name == "none"
         // return fully transparent black
         // BUGBUG - this is different than not having a color attribute
         // in which case, we might want to eliminate color, and allow ancestor's color to come through
-        if (!svg::colors.contains(cName))
+        BLRgba32 c{};
+        if (!svgNamedColor(inChunk, c))
             return BLRgba32(128, 128, 128, 255);
 
-        return svg::colors[cName];
+        return c;
     }
 
 
@@ -618,11 +887,9 @@ namespace svg2b2d {
                 return;
 
             // lookup the thing we're referencing
-            std::string idStr = toString(id);
-
             if (fRoot != nullptr)
             {
-                auto node = fRoot->findNodeById(idStr);
+                auto node = fRoot->findNodeById(id);
                 
                 // pull out the color value
                 if (node != nullptr)
@@ -666,14 +933,12 @@ namespace svg2b2d {
                 loadFromUrl(str);
             }
             else {
-                std::string cName = std::string(str.fStart, str.fEnd);
-                if (cName == "none") {
+                if (str == "none") {
                     fExplicitNone = true;
                     set(true);
                 }
-                else if (svg::colors.contains(cName))
+                else if (svgNamedColor(str, c))
                 {
-                    c = svg::colors[cName];
                     blVarAssignRgba32(&fPaint, c.value);
                     set(true);
                 }
@@ -712,7 +977,7 @@ namespace svg2b2d {
             {
                 paint->setPaintFor(SVG_PaintForFill);
                 // look for fill-opacity as well
-                auto o = elem.getAttribute("fill-opacity");
+                auto o = elem.getAttribute(SVG_NAME_FILL_OPACITY);
                 if (o)
                 {
                     auto onum = toNumber(o);
@@ -723,7 +988,7 @@ namespace svg2b2d {
             {
                 paint->setPaintFor(SVG_PaintForStroke);
                 // look for stroke-opacity as well
-                auto o = elem.getAttribute("stroke-opacity");
+                auto o = elem.getAttribute(SVG_NAME_STROKE_OPACITY);
                 if (o)
                 {
                     auto onum = toNumber(o);
@@ -734,7 +999,7 @@ namespace svg2b2d {
 			{
 				//paint->setPaintFor(SVG_PaintForStopColor);
 				// look for stop-opacity as well
-				auto o = elem.getAttribute("stop-opacity");
+				auto o = elem.getAttribute(SVG_NAME_STOP_OPACITY);
 				if (o)
 				{
 					auto onum = toNumber(o);
@@ -1110,6 +1375,7 @@ namespace svg2b2d
     static std::vector<BLPoint> parsePoints(const ByteSpan &inChunk)
 	{
 		std::vector<BLPoint> points;
+		points.reserve(chunk_count_numbers(inChunk) / 2);
 
 		ByteSpan s = inChunk;
 		charset numDelims = wspChars + ',';
@@ -1137,170 +1403,192 @@ namespace svg2b2d
     //
     // parsing transforms
     //
+    // The arguments between the '(' and ')', separated by whitespace,
+    // commas, or nothing at all where a sign starts the next number.
+    // Returns what follows the ')'.
     static ByteSpan parseTransformArgs(const ByteSpan& inChunk, double* args, int maxNa, int& na)
     {
         na = 0;
 
         ByteSpan s = inChunk;
-
-        // Skip past everything until we see a '('
-		s = chunk_find_char(s, '(');
-
-        // If we got to the end of the chunk, and did not see the '('
-        // then just return
+        s.fStart = scan_find_char(s.fStart, s.fEnd, '(');
         if (!s)
             return s;
-
-        // by the time we're here, we're sitting right on top of the 
-        //'(', so skip past that to get to what should be the numbers
         s++;
 
-        // We want to create a  chunk that contains all the numbers
-        // without the closing ')', so create a chunk that just
-        // represents that range.
-        // Start the chunk at the current position
-        // and expand it after we find the ')'
         ByteSpan item = s;
-        item.fEnd = item.fStart;
-
-        // scan until the closing ')'
-        s = chunk_find_char(s, ')');
-
-
-        // At this point, we're either sitting at the ')' or at the end
-        // of the chunk.  If we're at the end of the chunk, then we
-        // didn't find the closing ')', so just return
+        s.fStart = scan_find_char(s.fStart, s.fEnd, ')');
         if (!s)
             return s;
-
-        // We found the closing ')', so if we use the current position
-        // as the end (sitting on top of the ')', the item chunk will
-        // perfectly represent the numbers we want to parse.
         item.fEnd = s.fStart;
-
-        // Create a chunk that will represent a specific number to be parsed.
-        ByteSpan numChunk{};
-
-        // Move the source chunk cursor past the ')', so that whatever
-        // needs to use it next is ready to go.
         s++;
 
-        // Now we're ready to parse the individual numbers
-		auto numDelims = wspChars + ',';
-        
-        while (item) {
-            if (na >= maxNa)
-                break;
-            
-			args[na++] = nextNumber(item, numDelims);
-        }
+        double value{ 0 };
+        while (na < maxNa && parseNextNumber(item, value))
+            args[na++] = value;
 
         return s;
     }
 
-    static ByteSpan parseMatrix(ByteSpan& inMatrix, BLMatrix2D &m)
+    // m = t * m, so 't' is applied before what's already in 'm'
+    // The same as BLMatrix2D::transform(), done inline.
+    static inline void svgMatrixPremultiply(BLMatrix2D& m, double a, double b, double c, double d, double e, double f) noexcept
     {
-        ByteSpan s = inMatrix;
-        m.reset();  // start with identity
-
-        
-        double t[6];    // storage for our 6 numbers
-		int na = 0;     // Number of arguments parsed
-
-        s = parseTransformArgs(s, t, 6, na);
-
-        if (na != 6)
-            return s;
-
-		m.reset(t[0], t[1], t[2], t[3], t[4], t[5]);
-
-        return s;
+        double m00 = a * m.m00 + b * m.m10;
+        double m01 = a * m.m01 + b * m.m11;
+        double m10 = c * m.m00 + d * m.m10;
+        double m11 = c * m.m01 + d * m.m11;
+
+        m.m20 += e * m.m00 + f * m.m10;
+        m.m21 += e * m.m01 + f * m.m11;
+        m.m00 = m00;
+        m.m01 = m01;
+        m.m10 = m10;
+        m.m11 = m11;
     }
-    
-    
-    static ByteSpan parseTranslate(const ByteSpan& inChunk, BLMatrix2D& xform)
-    {
-        double args[2];
-        int na = 0;
-        ByteSpan s = inChunk;
-        s = parseTransformArgs(s, args, 2, na);
-        if (na == 1)
-            args[1] = 0.0;
 
-        xform.translate(args[0], args[1]);
-
-        return s;
-    }
-    
-    static ByteSpan parseScale(const ByteSpan& inChunk, BLMatrix2D& xform)
+    // Consume the keyword if 's' starts with it
+    // The length is known at compile time, so there's no strlen().
+    template <size_t N>
+    static inline bool svgTransformKeyword(ByteSpan& s, const char (&keyword)[N]) noexcept
     {
-        double args[2]{ 0 };
-        int na = 0;
-        ByteSpan s = inChunk;
-        
-        s = parseTransformArgs(s, args, 2, na);
+        constexpr size_t len = N - 1;
+        if (s.size() < len || memcmp(s.fStart, keyword, len) != 0)
+            return false;
 
-        if (na == 1)
-            args[1] = args[0];
+        s.fStart += len;
+        return true;
+    }
 
-        xform.scale(args[0], args[1]);
+    enum SVG_TRANSFORM_OP {
+        SVG_TRANSFORM_NONE = 0
+        , SVG_TRANSFORM_MATRIX
+        , SVG_TRANSFORM_TRANSLATE
+        , SVG_TRANSFORM_SCALE
+        , SVG_TRANSFORM_ROTATE
+        , SVG_TRANSFORM_SKEWX
+        , SVG_TRANSFORM_SKEWY
+    };
 
-        return s;
-    }
-    
-    
-    static ByteSpan parseSkewX(const ByteSpan& inChunk, BLMatrix2D& xform)
+    // Which transform function 's' starts with, one character and
+    // one compare deciding it
+    static inline SVG_TRANSFORM_OP svgTransformOp(ByteSpan& s) noexcept
     {
-        double args[1];
-        int na = 0;
-        ByteSpan s = inChunk;
-        s = parseTransformArgs(s, args, 1, na);
-
-        xform.resetToSkewing(radians(args[0]), 0.0f);
+        switch (*s)
+        {
+        case 'm':
+            if (svgTransformKeyword(s, "matrix"))
+                return SVG_TRANSFORM_MATRIX;
+        break;
+
+        case 't':
+            if (svgTransformKeyword(s, "translate"))
+                return SVG_TRANSFORM_TRANSLATE;
+        break;
+
+        case 'r':
+            if (svgTransformKeyword(s, "rotate"))
+                return SVG_TRANSFORM_ROTATE;
+        break;
+
+        case 's':
+            if (svgTransformKeyword(s, "scale"))
+                return SVG_TRANSFORM_SCALE;
+            if (svgTransformKeyword(s, "skewX"))
+                return SVG_TRANSFORM_SKEWX;
+            if (svgTransformKeyword(s, "skewY"))
+                return SVG_TRANSFORM_SKEWY;
+        break;
+        }
 
-        return s;
+        return SVG_TRANSFORM_NONE;
     }
 
-    static ByteSpan parseSkewY(const ByteSpan& inChunk, BLMatrix2D& xform)
+    // Parse the arguments of one transform function, and fold it into 'm'
+    // Returns what follows the function.  A function with the wrong
+    // number of arguments is skipped over, and leaves 'm' alone.
+    static ByteSpan parseTransformOp(const ByteSpan& inChunk, SVG_TRANSFORM_OP op, BLMatrix2D& m, bool& translateOnly)
     {
-        double args[1]{ 0 };
+        double args[6]{ 0 };
         int na = 0;
-        ByteSpan s = inChunk;
-        s = parseTransformArgs(s, args, 1, na);
+        ByteSpan s = parseTransformArgs(inChunk, args, 6, na);
 
-        xform.resetToSkewing(0.0f, radians(args[0]));
+        switch (op)
+        {
+        case SVG_TRANSFORM_TRANSLATE:
+            if (na < 1 || na > 2)
+                break;
+            m.translate(args[0], na == 2 ? args[1] : 0.0);
+        break;
 
-        return s;
-    }
-    
-    
-    static ByteSpan parseRotate(const ByteSpan& inChunk, BLMatrix2D& xform)
-    {
-        double args[3]{ 0 };
-        int na = 0;
-        float m[6]{ 0 };
-        float t[6]{ 0 };
-        ByteSpan s = inChunk;
+        case SVG_TRANSFORM_MATRIX:
+            if (na != 6)
+                break;
+            svgMatrixPremultiply(m, args[0], args[1], args[2], args[3], args[4], args[5]);
+            translateOnly = translateOnly && args[0] == 1 && args[1] == 0 && args[2] == 0 && args[3] == 1;
+        break;
+
+        case SVG_TRANSFORM_SCALE:
+            if (na < 1 || na > 2)
+                break;
+            if (na == 1)
+                args[1] = args[0];
+            m.scale(args[0], args[1]);
+            translateOnly = translateOnly && args[0] == 1 && args[1] == 1;
+        break;
+
+        case SVG_TRANSFORM_ROTATE: {
+            if (na != 1 && na != 3)
+                break;
+            if (args[0] == 0)
+                break;
 
-		s = parseTransformArgs(s, args, 3, na);
+            double a = radians(args[0]);
+            double cs = std::cos(a);
+            double sn = std::sin(a);
+            double cx = (na == 3) ? args[1] : 0.0;
+            double cy = (na == 3) ? args[2] : 0.0;
+
+            // translate(cx, cy) rotate(a) translate(-cx, -cy)
+            m.translate(cx, cy);
+            svgMatrixPremultiply(m, cs, sn, -sn, cs, 0, 0);
+            m.translate(-cx, -cy);
+            translateOnly = false;
+        }
+        break;
+
+        case SVG_TRANSFORM_SKEWX:
+            if (na != 1)
+                break;
+            svgMatrixPremultiply(m, 1, 0, std::tan(radians(args[0])), 1, 0, 0);
+            translateOnly = translateOnly && args[0] == 0;
+        break;
 
-        if (na == 1)
-            args[1] = args[2] = 0.0f;
+        case SVG_TRANSFORM_SKEWY:
+            if (na != 1)
+                break;
+            svgMatrixPremultiply(m, 1, std::tan(radians(args[0])), 0, 1, 0, 0);
+            translateOnly = translateOnly && args[0] == 0;
+        break;
 
-		xform.rotate(radians(args[0]), args[1], args[2]);
+        default:
+        break;
+        }
 
-        return  s;
+        return s;
     }
 
 
     struct SVGTransform : public SVGVisualProperty
     {
         BLMatrix2D fTransform{};
+        bool fTranslateOnly{ true };
 
 		SVGTransform(IMapSVGNodes* iMap) : SVGVisualProperty(iMap) {}
         SVGTransform(const SVGTransform& other)
             :SVGVisualProperty(other)
             ,fTransform(other.fTransform)
+            ,fTranslateOnly(other.fTranslateOnly)
         {
 
         }
@@ -1309,79 +1597,48 @@ namespace svg2b2d
         {
             SVGVisualProperty::operator=(rhs);
             fTransform = rhs.fTransform;
+            fTranslateOnly = rhs.fTranslateOnly;
 
             return *this;
         }
 
         BLMatrix2D& getTransform() { return fTransform; }
 
+		// The functions are composed straight into the transform,
+        // left to right, the way the list is applied.
 		void loadSelfFromChunk(const ByteSpan& inChunk) override
 		{
             ByteSpan s = inChunk;
             fTransform.reset();     // set to identity initially
-            
+            fTranslateOnly = true;
 
             while (s)
             {
 				s = chunk_skip_wsp(s);
-                
-                // Set out temp transform to the identity to start
-                // so that if parsing goes wrong, we can still do
-                // the multiply without worrying about messing things up
-                // That means, the individula parsing functions need to not
-                // partially mess up the transform if they fail.
-                //svg_xformIdentity(t);
+                if (!s)
+                    break;
 
-                BLMatrix2D tm{};
-				tm.reset();
-
-                if (chunk_starts_with_cstr(s, "matrix"))
+                SVG_TRANSFORM_OP op = svgTransformOp(s);
+                if (op == SVG_TRANSFORM_NONE)
                 {
-                    s = parseMatrix(s, tm);
-                    fTransform = tm;
-                    set(true);
-                }
-                else if (chunk_starts_with_cstr(s, "translate"))
-                {
-                    s = parseTranslate(s, tm);
-                    fTransform.transform(tm);
-                    set(true);
-                }
-                else if (chunk_starts_with_cstr(s, "scale"))
-                {
-                    s = parseScale(s, tm);
-					fTransform.transform(tm);
-                    set(true);
-                }
-                else if (chunk_starts_with_cstr(s, "rotate"))
-                {
-                    s = parseRotate(s, tm);
-                    fTransform.transform(tm);
-                    set(true);
-                }
-                else if (chunk_starts_with_cstr(s, "skewX"))
-                {
-                    s = parseSkewX(s,tm);
-                    fTransform.transform(tm);
-                    set(true);
-                }
-                else if (chunk_starts_with_cstr(s, "skewY"))
-                {
-                    s = parseSkewY(s,tm);
-                    fTransform.transform(tm);
-                    set(true);
-                }
-                else {
-                    s++;
+                    s++;        // separators, or something we don't know
+                    continue;
                 }
 
+                s = parseTransformOp(s, op, fTransform, fTranslateOnly);
+                set(true);
             }
-
 		}
 
+        // Nothing but a translation, so it can be applied as one
+        bool isTranslation() const { return fTranslateOnly; }
+
         void drawSelf(IRender& ctx) override
         {
-			ctx.transform(fTransform);
+            if (fTranslateOnly)
+                ctx.translate(fTransform.m20, fTransform.m21);
+            else
+			    ctx.transform(fTransform);
         }
 
         static std::shared_ptr<SVGTransform> createFromChunk(IMapSVGNodes* root, const std::string& name, const ByteSpan& inChunk)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "bspanutil.h"
+#include "svgnames.h"
 
 
 #include <string>
@@ -27,7 +28,10 @@
 // The element contains individual members for
 //  kind - content, self-closing, start-tag, end-tag, comment, processing-instruction
 //  name - the name of the element, if opening or closing tag
-//  attributes - a map of attribute names to attribute values.  Values are still in raw form
+//  nameId - the interned id of the name (svgnames.h), or SVG_NAME_UNKNOWN
+//  attributes - a flat list of attribute name/value pairs.  Both the names and the values
+//               are spans into the source, still in raw form, so no allocation is needed
+//               to hold them.  They're only scanned when they're first asked for.
 //  data - the raw data of the element.  
 // The starting name has been removed, to be turned into the name
 // 
@@ -105,6 +109,24 @@ namespace svg2b2d {
 		ByteSpan name() const { return fName; }
 		ByteSpan ns() const { return fNamespace; }
 	};
+
+    // XmlAttribute
+    // A single name/value pair found in an element tag.  Both the name
+    // and the value point into the source chunk, so they are only valid
+    // as long as that memory is.
+    struct XmlAttribute {
+        ByteSpan fName{};
+        ByteSpan fValue{};
+        SVGNameId fNameId{ SVG_NAME_UNKNOWN };
+
+        XmlAttribute() = default;
+        XmlAttribute(const ByteSpan& name, const ByteSpan& value) 
+            : fName(name), fValue(value), fNameId(svgNameId(name)) {}
+
+        const ByteSpan& name() const { return fName; }
+        const ByteSpan& value() const { return fValue; }
+        SVGNameId nameId() const { return fNameId; }
+    };
     
     // Representation of an xml element
     // The xml iterator will generate these
@@ -115,8 +137,18 @@ namespace svg2b2d {
         ByteSpan fData{};
 
         XmlName fXmlName{};
-        std::string fName{};
-        std::map<std::string, ByteSpan> fAttributes{};
+        ByteSpan fName{};       // points into the source, same as everything else
+        SVGNameId fNameId{ SVG_NAME_UNKNOWN };
+
+        // Attributes are kept in a flat vector, in the order they were seen.
+        // Elements typically have only a handful of attributes, so a linear
+        // scan is cheaper than any tree or hash lookup.  Since clear() keeps
+        // the capacity, an element that is reused by the iterator stops
+        // allocating once it has seen its largest attribute count.
+        // They aren't scanned until something asks for them, so end tags,
+        // and elements that are skipped over, never pay for it.
+        mutable std::vector<XmlAttribute> fAttributes{};
+        mutable bool fAttributesScanned{ false };
 
     public:
         XmlElement() {}
@@ -140,10 +172,13 @@ namespace svg2b2d {
             {
                 scanTagName();
 
-                if (autoScanAttr) {
-                    if (fElementKind != XML_ELEMENT_TYPE_END_TAG)
-                        scanAttributes();
-                }
+                // Only start tags have attributes to scan, later
+                fAttributesScanned = (fElementKind == XML_ELEMENT_TYPE_END_TAG);
+                if (autoScanAttr)
+                    ensureAttributes();
+            }
+            else {
+                fAttributesScanned = true;
             }
 		}
         
@@ -151,9 +186,19 @@ namespace svg2b2d {
         void clear() {
 			fElementKind = XML_ELEMENT_TYPE_INVALID;
 			fData = {};
-			fName.clear();
+			fName = {};
+            fNameId = SVG_NAME_UNKNOWN;
 			fAttributes.clear();
+            fAttributesScanned = true;
 		}
+
+        // Start the attributes over, empty, rather than having them
+        // scanned from the data.  They can be added with addAttribute().
+        void resetAttributes()
+        {
+            fAttributes.clear();
+            fAttributesScanned = true;
+        }
         
         // determines whether the element is currently empty
         bool empty() const { return fElementKind == XML_ELEMENT_TYPE_INVALID; }
@@ -161,10 +206,14 @@ namespace svg2b2d {
         explicit operator bool() const { return !empty(); }
 
         // Returning information about the element
-        const std::map<std::string, ByteSpan>& attributes() const { return fAttributes; }
+        const std::vector<XmlAttribute>& attributes() const { ensureAttributes(); return fAttributes; }
         
-        const std::string& name() const { return fName; }
-		void setName(const std::string& name) { fName = name; }
+        // The name is a span of the source, or of whatever it was set
+        // from, so it's only good for as long as that memory is.
+        const ByteSpan& name() const { return fName; }
+        const XmlName& xmlName() const { return fXmlName; }
+		void setName(const ByteSpan& name) { fName = name; fNameId = svgNameId(name); }
+        SVGNameId nameId() const { return fNameId; }
         
         int kind() const { return fElementKind; }
 		void kind(int kind) { fElementKind = kind; }
@@ -182,21 +231,66 @@ namespace svg2b2d {
 		bool isDoctype() const { return fElementKind == XML_ELEMENT_TYPE_DOCTYPE; }
 
         
-        void addAttribute(std::string& name, const ByteSpan& valueChunk)
+        // Add an attribute.  If an attribute of the same name is already
+        // present, its value is replaced, so the last one seen wins.
+        // The name must point at memory that outlives this element.
+        void addAttribute(const ByteSpan& name, const ByteSpan& valueChunk)
+        {
+            ensureAttributes();
+
+            for (auto& attr : fAttributes)
+            {
+                if (attr.fName == name)
+                {
+                    attr.fValue = valueChunk;
+                    return;
+                }
+            }
+
+            fAttributes.emplace_back(name, valueChunk);
+        }
+
+        // Lookup by interned id, which is an integer compare per attribute
+        ByteSpan getAttribute(SVGNameId id) const
         {
-            fAttributes[name] = valueChunk;
+            if (id == SVG_NAME_UNKNOWN)
+                return ByteSpan{};
+
+            ensureAttributes();
+            for (auto& attr : fAttributes)
+            {
+                if (attr.fNameId == id)
+                    return attr.fValue;
+            }
+
+            return ByteSpan{};
         }
 
-        ByteSpan getAttribute(const std::string &name) const
+        ByteSpan getAttribute(const ByteSpan& name) const
 		{
-			auto it = fAttributes.find(name);
-			if (it != fAttributes.end())
-				return it->second;
-			else
-                return ByteSpan{};
+            ensureAttributes();
+            for (auto& attr : fAttributes)
+            {
+                if (attr.fName == name)
+                    return attr.fValue;
+            }
+
+            return ByteSpan{};
 		}
+
+        ByteSpan getAttribute(const char* name) const { return getAttribute(ByteSpan(name)); }
+        ByteSpan getAttribute(const std::string& name) const { return getAttribute(ByteSpan(name.data(), name.size())); }
         
     private:
+        // Scan the attributes, if that hasn't happened yet
+        void ensureAttributes() const
+        {
+            if (fAttributesScanned)
+                return;
+
+            const_cast<XmlElement*>(this)->scanAttributes();
+        }
+
         //
         // Parse an XML element
         // We should be sitting on the first character of the element tag after the '<'
@@ -212,7 +306,8 @@ namespace svg2b2d {
         void setTagName(const ByteSpan& inChunk)
         {
             fXmlName.reset(inChunk);
-            fName = toString(fXmlName.name());
+            fName = fXmlName.name();
+            fNameId = svgNameId(fName);
         }
         
         void scanTagName()
@@ -259,6 +354,7 @@ namespace svg2b2d {
         //
         int scanAttributes()
         {
+            fAttributesScanned = true;
 
             int nattr = 0;
             bool start = false;
@@ -275,7 +371,7 @@ namespace svg2b2d {
 
 
                 // Skip white space before the attrib name
-                s = chunk_ltrim(s, wspChars);
+                s = chunk_skip_wsp(s);
 
                 if (!s)
                     break;
@@ -290,11 +386,8 @@ namespace svg2b2d {
                 auto attrNameChunk = chunk_token(s, "=");
                 attrNameChunk = chunk_trim(attrNameChunk, wspChars);    // trim whitespace on both ends
 
-                std::string attrName = std::string(attrNameChunk.fStart, attrNameChunk.fEnd);
-
                 // Skip stuff past '=' until the beginning of the value.
-                while (s && (*s != '\"') && (*s != '\''))
-                    s++;
+                s.fStart = scan_find_any(s.fStart, s.fEnd, '\"', '\'', '\"', '\'');
 
                 // If we've reached end of span, bail out
                 if (!s)
@@ -308,8 +401,7 @@ namespace svg2b2d {
                 beginattrValue = (uint8_t*)s.fStart;    // Mark the beginning of the attribute content
 
                 // Skip until we find the matching closing quote
-                while (s && *s != quote)
-                    s++;
+                s.fStart = scan_find_char(s.fStart, s.fEnd, quote);
 
                 if (s)
                 {
@@ -320,7 +412,7 @@ namespace svg2b2d {
                 // Store only well formed attributes
                 ByteSpan attrValue = { beginattrValue, endattrValue };
 
-                addAttribute(attrName, attrValue);
+                addAttribute(attrNameChunk, attrValue);
 
                 nattr++;
             }
@@ -372,6 +464,7 @@ namespace svg2b2d {
         svg2b2d::ByteSpan mark{};
 
         XmlElement fCurrentElement{};
+        const uint8_t* fTagStart{ nullptr };    // the '<' of the current element's tag
         
     public:
         XmlElementIterator(const svg2b2d::ByteSpan& inChunk)
@@ -402,13 +495,86 @@ namespace svg2b2d {
             fState = st;
         }
 
+        // Where the current element came from in the source.  For a tag,
+        // that's from its '<' to just past its '>', for content it's
+        // the content itself.
+        ByteSpan elementSpan() const
+        {
+            if (fCurrentElement.empty())
+                return {};
+
+            if (fCurrentElement.isContent())
+                return fCurrentElement.data();
+
+            return ByteSpan(fTagStart, fSource.fStart);
+        }
+
+        // Start over on new data.  The current element, and the
+        // storage of its attributes, are reused rather than reallocated
+        void restart(const svg2b2d::ByteSpan& inChunk)
+        {
+            reset(inChunk, XML_ITERATOR_STATE_CONTENT);
+            next();
+        }
+
+        // The whole of the current element, from the '<' of its start tag,
+        // to just past the '>' of its end tag, found without building any
+        // elements along the way.  Tags are found the same way next() finds
+        // them, so iterating over the span gives the same elements.
+        // Returns an empty span if the current element isn't a start tag,
+        // or its end can't be found.
+        ByteSpan elementExtent() const
+        {
+            if (!fCurrentElement.isStart())
+                return {};
+
+            const uint8_t* end = fSource.fEnd;
+            const uint8_t* p = fSource.fStart;
+            int depth = 1;
+
+            while (p < end)
+            {
+                p = scan_find_char(p, end, '<');
+                if (p >= end)
+                    break;
+
+                const uint8_t* tagEnd = scan_find_char(p, end, '>');
+                if (tagEnd >= end)
+                    break;
+
+                ByteSpan tag(p + 1, tagEnd);
+                if (chunk_starts_with_cstr(tag, "/"))
+                {
+                    if (--depth == 0)
+                        return ByteSpan(fTagStart, tagEnd + 1);
+                }
+                else if (!chunk_starts_with_cstr(tag, "?") && !chunk_starts_with_cstr(tag, "!") &&
+                    !chunk_ends_with_char(chunk_rtrim(tag, wspChars), '/'))
+                {
+                    depth++;
+                }
+
+                p = tagEnd + 1;
+            }
+
+            return {};
+        }
+
+        // Carry on from the end of 'extent', which came from elementExtent()
+        // The next element is whatever follows it.
+        void skipElement(const ByteSpan& extent)
+        {
+            fSource.fStart = extent.fEnd;
+            mark = fSource;
+            fState = XML_ITERATOR_STATE_CONTENT;
+        }
+
         ByteSpan readTag()
         {
             ByteSpan elementChunk = fSource;
             elementChunk.fEnd = fSource.fStart;
             
-            while (fSource && *fSource != '>')
-                fSource++;
+            fSource.fStart = scan_find_char(fSource.fStart, fSource.fEnd, '>');
 
             elementChunk.fEnd = fSource.fStart;
             elementChunk = chunk_rtrim(elementChunk, wspChars);
@@ -433,7 +599,7 @@ namespace svg2b2d {
             
 			// Skip past the whitespace
             // to get to the beginning of things
-			fSource = chunk_ltrim(fSource, wspChars);
+			fSource = chunk_skip_wsp(fSource);
 
             
             // Mark the beginning of the "content" we might return
@@ -512,7 +678,8 @@ namespace svg2b2d {
                         mark = fSource;
                     }
                     else {
-                        fSource++;
+                        // Jump straight to the next tag
+                        fSource.fStart = scan_find_char(fSource.fStart, fSource.fEnd, '<');
                     }
 
                 }
@@ -524,6 +691,7 @@ namespace svg2b2d {
                     ByteSpan elementChunk = fSource;
                     elementChunk.fEnd = fSource.fStart;
                     int kind = XML_ELEMENT_TYPE_START_TAG;
+                    fTagStart = fSource.fStart - 1;
                     
                     if (chunk_starts_with_cstr(fSource, "?xml"))
                     {
@@ -565,7 +733,7 @@ namespace svg2b2d {
 
                     mark = fSource;
 
-					fCurrentElement.reset(kind, elementChunk, true);
+					fCurrentElement.reset(kind, elementChunk);
 
                     return true;
                 }
@@ -582,6 +750,165 @@ namespace svg2b2d {
             return false;
         } // end of next()
     };
+
+    //
+    // XmlChunkedIterator
+    // The same elements XmlElementIterator finds, only the document
+    // doesn't have to be there all at once.  It's handed over a chunk at
+    // a time, as it arrives (from a network stream, for instance), and
+    // elements are returned as soon as they're complete.  When a tag, or
+    // run of content, is cut off by the end of a chunk, next() says it
+    // needs more data.  Only that unfinished tail is copied, and held onto
+    // until the rest of it shows up, everything else is iterated in place.
+    //
+    // Usage:
+    //   XmlChunkedIterator iter;
+    //   while (read(chunk)) {
+    //       iter.feed(chunk);
+    //       while (iter.next() == XML_CHUNK_ELEMENT)
+    //           use(*iter);
+    //   }
+    //   iter.finish();
+    //   while (iter.next() == XML_CHUNK_ELEMENT)
+    //       use(*iter);
+    //
+    // The current element can point into the last chunk fed, so that
+    // chunk must stay valid until next() asks for more data.
+    // Chunks are split before a '<', which only ever starts a tag, so
+    // neither tags, nor runs of content (which can have a '>' in them),
+    // are split.  A '<' inside a comment, or CDATA, that lands at the end
+    // of a chunk, can split what it's inside of.  A DOCTYPE with an
+    // internal subset is the same.
+    //
+    enum XML_CHUNK_STATUS {
+        XML_CHUNK_ELEMENT = 0       // there's an element to look at
+        , XML_CHUNK_NEED_DATA       // feed() the next chunk, or finish()
+        , XML_CHUNK_DONE            // finish() was called, and there's nothing left
+    };
+
+    struct XmlChunkedIterator {
+    private:
+        XmlElementIterator fIter{ ByteSpan{} };
+        ByteSpan fChunk{};                  // what's left of the last chunk
+        std::vector<uint8_t> fTail{};       // an unfinished tag, or content, carried over
+        std::vector<uint8_t> fJoined{};     // the tail, with the rest of it from the next chunk
+        bool fInRegion{ false };
+        bool fFresh{ false };
+        bool fFinished{ false };
+
+    public:
+        XmlChunkedIterator() = default;
+
+        const XmlElement& operator*() const { return *fIter; }
+        const XmlElement* operator->() const { return &(*fIter); }
+
+        // How much is being held onto, waiting for the rest of it
+        size_t pending() const { return fTail.size(); }
+
+        // The next piece of the document
+        // Only call this once next() has asked for more data.
+        void feed(const ByteSpan& chunk)
+        {
+            fChunk = chunk;
+        }
+
+        // There is no more data, whatever is left is all there is
+        void finish()
+        {
+            fFinished = true;
+        }
+
+        XML_CHUNK_STATUS next()
+        {
+            for (;;)
+            {
+                if (fInRegion)
+                {
+                    if (!fFresh)
+                        fIter++;
+                    fFresh = false;
+
+                    if (fIter)
+                        return XML_CHUNK_ELEMENT;
+
+                    fInRegion = false;
+                }
+
+                if (!nextRegion())
+                    return fFinished ? XML_CHUNK_DONE : XML_CHUNK_NEED_DATA;
+            }
+        }
+
+    private:
+        void startRegion(const ByteSpan& region)
+        {
+            fIter.restart(region);
+            fInRegion = true;
+            fFresh = true;
+        }
+
+        // Find the next stretch of data that ends on a '<', so every
+        // tag, and run of content, before it is complete.  The '<' is
+        // part of the stretch, that's what ends the content before it.
+        // Whatever comes from the last '<' on is held back, to be joined
+        // up with the next chunk.
+        bool nextRegion()
+        {
+            if (!fTail.empty() && fChunk)
+            {
+                // Finish off the tail, with the start of this chunk
+                const uint8_t* lt = scan_find_char(fChunk.fStart, fChunk.fEnd, '<');
+                if (lt >= fChunk.fEnd)
+                {
+                    fTail.insert(fTail.end(), fChunk.fStart, fChunk.fEnd);
+                    fChunk = {};
+                    return false;
+                }
+
+                fJoined.assign(fTail.begin(), fTail.end());
+                fJoined.insert(fJoined.end(), fChunk.fStart, lt + 1);
+                fTail.clear();
+                fChunk.fStart = lt;
+
+                startRegion(ByteSpan(fJoined.data(), fJoined.size()));
+                return true;
+            }
+
+            if (fChunk)
+            {
+                const uint8_t* last = fChunk.fEnd;
+                while (last > fChunk.fStart && last[-1] != '<')
+                    last--;
+
+                // Nothing is complete until there's a '<' past the start
+                if (last <= fChunk.fStart + 1)
+                {
+                    fTail.assign(fChunk.fStart, fChunk.fEnd);
+                    fChunk = {};
+                    return false;
+                }
+
+                ByteSpan region(fChunk.fStart, last);
+                fTail.assign(last - 1, fChunk.fEnd);
+                fChunk = {};
+
+                startRegion(region);
+                return true;
+            }
+
+            // Nothing more is coming, so the tail is as complete as it gets
+            if (fFinished && !fTail.empty())
+            {
+                fJoined.swap(fTail);
+                fTail.clear();
+
+                startRegion(ByteSpan(fJoined.data(), fJoined.size()));
+                return true;
+            }
+
+            return false;
+        }
+    };
 }
 
 
@@ -0,0 +1,272 @@
+#pragma once
+
+#include "xmlscan.h"
+
+#include <cstdint>
+#include <vector>
+
+//
+// XmlTape
+// A structural index of a whole document, built in one pass of the
+// scanner.  Every element the XmlElementIterator would return gets an
+// entry on the tape, in document order, holding its kind, interned name,
+// where it is in the source, its attributes, and how it's related to
+// the elements around it (parent, next sibling, where it closes).
+//
+// Once the tape is built, later passes can jump straight to what they're
+// interested in, without scanning the XML again: walk only the children
+// of an element, skip a whole subtree, find every element with an id,
+// or split the document up into pieces of known size.
+//
+// Everything on the tape is an offset into the source, not a pointer,
+// so the tape is compact, and the source must stay valid as long as
+// anything is read from it.  Documents are limited to 4GB.
+//
+// Usage:
+//   XmlTape tape;
+//   tape.build(data);
+//   for (uint32_t i = tape.firstChild(root); i != XmlTape::kNone; i = tape.nextSibling(i))
+//       ...
+//
+namespace svg2b2d {
+
+    struct XmlTapeAttribute
+    {
+        uint32_t fNameStart{ 0 };
+        uint32_t fNameEnd{ 0 };
+        uint32_t fValueStart{ 0 };
+        uint32_t fValueEnd{ 0 };
+        SVGNameId fNameId{ SVG_NAME_UNKNOWN };
+    };
+
+    struct XmlTapeNode
+    {
+        uint8_t fKind{ XML_ELEMENT_TYPE_INVALID };
+        SVGNameId fNameId{ SVG_NAME_UNKNOWN };
+
+        uint32_t fStart{ 0 };           // of the whole tag, or content, in the source
+        uint32_t fEnd{ 0 };
+        uint32_t fNameStart{ 0 };
+        uint32_t fNameEnd{ 0 };
+        uint32_t fDataStart{ 0 };       // what the XmlElement's data() would be
+        uint32_t fDataEnd{ 0 };
+
+        uint32_t fFirstAttribute{ 0 };  // into the tape's attributes
+        uint32_t fAttributeCount{ 0 };
+
+        uint32_t fParent{ UINT32_MAX };
+        uint32_t fNextSibling{ UINT32_MAX };
+        uint32_t fClose{ UINT32_MAX };  // the end tag of a start tag
+    };
+
+    struct XmlTape
+    {
+        static constexpr uint32_t kNone = UINT32_MAX;
+
+        ByteSpan fSource{};
+        std::vector<XmlTapeNode> fNodes{};
+        std::vector<XmlTapeAttribute> fAttributes{};
+
+        size_t size() const { return fNodes.size(); }
+        bool empty() const { return fNodes.empty(); }
+        const XmlTapeNode& operator[](size_t i) const { return fNodes[i]; }
+
+        void clear()
+        {
+            fSource = {};
+            fNodes.clear();
+            fAttributes.clear();
+        }
+
+        // Scan the whole of 'src' onto the tape
+        // Returns false if it's too big to be indexed.
+        bool build(const ByteSpan& src)
+        {
+            clear();
+
+            if (src.size() >= kNone)
+                return false;
+
+            fSource = src;
+
+            // Roughly one element for every 32 bytes, in typical SVG
+            fNodes.reserve(src.size() / 32 + 1);
+            fAttributes.reserve(src.size() / 32 + 1);
+
+            std::vector<uint32_t> open{};           // start tags not closed yet
+            std::vector<uint32_t> lastChild{ kNone };   // per level of open, the last child seen
+
+            XmlElementIterator iter(src);
+            while (iter)
+            {
+                const XmlElement& elem = *iter;
+                uint32_t index = (uint32_t)fNodes.size();
+
+                XmlTapeNode node{};
+                node.fKind = (uint8_t)elem.kind();
+                node.fNameId = elem.nameId();
+
+                ByteSpan span = iter.elementSpan();
+                node.fStart = offset(span.fStart);
+                node.fEnd = offset(span.fEnd);
+                node.fDataStart = offset(elem.data().fStart);
+                node.fDataEnd = offset(elem.data().fEnd);
+
+                ByteSpan name = elem.xmlName().name();
+                if (!elem.isContent() && name)
+                {
+                    node.fNameStart = offset(name.fStart);
+                    node.fNameEnd = offset(name.fEnd);
+                }
+
+                node.fFirstAttribute = (uint32_t)fAttributes.size();
+                node.fAttributeCount = (uint32_t)elem.attributes().size();
+                for (const auto& attr : elem.attributes())
+                {
+                    XmlTapeAttribute a{};
+                    a.fNameStart = offset(attr.name().fStart);
+                    a.fNameEnd = offset(attr.name().fEnd);
+                    a.fValueStart = offset(attr.value().fStart);
+                    a.fValueEnd = offset(attr.value().fEnd);
+                    a.fNameId = attr.nameId();
+                    fAttributes.push_back(a);
+                }
+
+                if (elem.isEnd())
+                {
+                    // An end tag belongs to the element it closes
+                    if (!open.empty())
+                    {
+                        uint32_t start = open.back();
+                        fNodes[start].fClose = index;
+                        node.fParent = start;
+
+                        open.pop_back();
+                        lastChild.pop_back();
+                    }
+                }
+                else
+                {
+                    node.fParent = open.empty() ? kNone : open.back();
+
+                    if (lastChild.back() != kNone)
+                        fNodes[lastChild.back()].fNextSibling = index;
+                    lastChild.back() = index;
+
+                    if (elem.isStart())
+                    {
+                        open.push_back(index);
+                        lastChild.push_back(kNone);
+                    }
+                }
+
+                fNodes.push_back(node);
+
+                iter++;
+            }
+
+            return true;
+        }
+
+        // Walking the tree
+        uint32_t parent(uint32_t i) const { return fNodes[i].fParent; }
+        uint32_t nextSibling(uint32_t i) const { return fNodes[i].fNextSibling; }
+
+        uint32_t firstChild(uint32_t i) const
+        {
+            if (fNodes[i].fKind != XML_ELEMENT_TYPE_START_TAG)
+                return kNone;
+
+            uint32_t child = i + 1;
+            if (child >= fNodes.size() || child == fNodes[i].fClose)
+                return kNone;
+
+            return child;
+        }
+
+        // The entry after the whole of element i, its children, and
+        // its end tag.  Jumping here skips the subtree.
+        uint32_t skip(uint32_t i) const
+        {
+            const XmlTapeNode& node = fNodes[i];
+            if (node.fKind != XML_ELEMENT_TYPE_START_TAG)
+                return i + 1;
+
+            return (node.fClose == kNone) ? (uint32_t)fNodes.size() : node.fClose + 1;
+        }
+
+        // The source of element i, and everything in it, through
+        // to its end tag
+        ByteSpan extent(uint32_t i) const
+        {
+            const XmlTapeNode& node = fNodes[i];
+            uint32_t end = node.fEnd;
+            if (node.fKind == XML_ELEMENT_TYPE_START_TAG)
+                end = (node.fClose == kNone) ? (uint32_t)fSource.size() : fNodes[node.fClose].fEnd;
+
+            return span(node.fStart, end);
+        }
+
+        ByteSpan source(uint32_t i) const { return span(fNodes[i].fStart, fNodes[i].fEnd); }
+        ByteSpan name(uint32_t i) const { return span(fNodes[i].fNameStart, fNodes[i].fNameEnd); }
+        ByteSpan data(uint32_t i) const { return span(fNodes[i].fDataStart, fNodes[i].fDataEnd); }
+
+        ByteSpan attributeName(const XmlTapeAttribute& a) const { return span(a.fNameStart, a.fNameEnd); }
+        ByteSpan attributeValue(const XmlTapeAttribute& a) const { return span(a.fValueStart, a.fValueEnd); }
+
+        // The value of element i's attribute, or an empty span
+        ByteSpan getAttribute(uint32_t i, SVGNameId id) const
+        {
+            const XmlTapeNode& node = fNodes[i];
+            for (uint32_t a = 0; a < node.fAttributeCount; a++)
+            {
+                const XmlTapeAttribute& attr = fAttributes[node.fFirstAttribute + a];
+                if (attr.fNameId == id)
+                    return attributeValue(attr);
+            }
+
+            return {};
+        }
+
+        // Fill in 'elem' with entry i, the same as the iterator would
+        // have, without scanning the attributes again
+        void element(uint32_t i, XmlElement& elem) const
+        {
+            const XmlTapeNode& node = fNodes[i];
+
+            if ((node.fKind != XML_ELEMENT_TYPE_START_TAG) &&
+                (node.fKind != XML_ELEMENT_TYPE_SELF_CLOSING) &&
+                (node.fKind != XML_ELEMENT_TYPE_END_TAG))
+            {
+                elem.reset(node.fKind, data(i));
+                return;
+            }
+
+            // The tag name is scanned from the start of the tag,
+            // the same way the iterator did it
+            ByteSpan tag = span(node.fStart + 1, node.fDataEnd);
+            elem.reset(node.fKind, tag);
+            elem.resetAttributes();
+
+            for (uint32_t a = 0; a < node.fAttributeCount; a++)
+            {
+                const XmlTapeAttribute& attr = fAttributes[node.fFirstAttribute + a];
+                elem.addAttribute(attributeName(attr), attributeValue(attr));
+            }
+        }
+
+    private:
+        uint32_t offset(const uint8_t* p) const
+        {
+            if (p == nullptr || p < fSource.fStart || p > fSource.fEnd)
+                return 0;
+
+            return (uint32_t)(p - fSource.fStart);
+        }
+
+        ByteSpan span(uint32_t start, uint32_t end) const
+        {
+            return ByteSpan(fSource.fStart + start, fSource.fStart + end);
+        }
+    };
+}
@@ -5,7 +5,8 @@
 namespace ndt_debug {
     using namespace svg2b2d;
 
-    std::map<int, std::string> elemTypeNames = {
+    // Read only, use elemTypeName() to lookup
+    const std::map<int, std::string> elemTypeNames = {
      {svg2b2d::XML_ELEMENT_TYPE_INVALID, "INVALID"}
     ,{svg2b2d::XML_ELEMENT_TYPE_CONTENT, "CONTENT"}
     ,{svg2b2d::XML_ELEMENT_TYPE_SELF_CLOSING, "SELF_CLOSING"}
@@ -18,6 +19,15 @@ namespace ndt_debug {
     ,{svg2b2d::XML_ELEMENT_TYPE_DOCTYPE, "DOCTYPE"}
     };
 
+    static const char* elemTypeName(int kind)
+    {
+        auto it = elemTypeNames.find(kind);
+        if (it == elemTypeNames.end())
+            return "UNKNOWN";
+
+        return it->second.c_str();
+    }
+
     void printXmlElement(const svg2b2d::XmlElement& elem)
     {
         if (elem.kind() == XML_ELEMENT_TYPE_INVALID)
@@ -29,38 +39,38 @@ namespace ndt_debug {
         case svg2b2d::XML_ELEMENT_TYPE_COMMENT:
         case svg2b2d::XML_ELEMENT_TYPE_PROCESSING_INSTRUCTION:
         case svg2b2d::XML_ELEMENT_TYPE_DOCTYPE:
-            printf("%s: \n", elemTypeNames[elem.kind()].c_str());
+            printf("%s: \n", elemTypeName(elem.kind()));
             printChunk(elem.data());
             break;
 
         //case svg2b2d::XML_ELEMENT_TYPE_DOCTYPE:
-        //    printf("%s: \n", elemTypeNames[elem.kind()].c_str());
+        //    printf("%s: \n", elemTypeName(elem.kind()));
         //    break;
             
         case svg2b2d::XML_ELEMENT_TYPE_START_TAG:
-            printf("START_TAG: [%s]\n", elem.name().c_str());
+            printf("START_TAG: [%.*s]\n", (int)elem.name().size(), (const char*)elem.name().fStart);
             break;
 
         case svg2b2d::XML_ELEMENT_TYPE_SELF_CLOSING:
-            printf("SELF_CLOSING: [%s]\n", elem.name().c_str());
+            printf("SELF_CLOSING: [%.*s]\n", (int)elem.name().size(), (const char*)elem.name().fStart);
             break;
 
         case svg2b2d::XML_ELEMENT_TYPE_END_TAG:
-            printf("END_TAG: [%s]\n", elem.name().c_str());
+            printf("END_TAG: [%.*s]\n", (int)elem.name().size(), (const char*)elem.name().fStart);
             break;
 
 
                 
         default:
-            printf("NYI: %s\n", elemTypeNames[elem.kind()].c_str());
+            printf("NYI: %s\n", elemTypeName(elem.kind()));
             printChunk(elem.data());
             break;
         }
 
         for (auto& attr : elem.attributes())
         {
-            printf("    %s: ", attr.first.c_str());
-            printChunk(attr.second);
+            printf("    %.*s: ", (int)attr.name().size(), (const char*)attr.name().data());
+            printChunk(attr.value());
         }
     }
 }
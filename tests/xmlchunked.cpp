@@ -0,0 +1,163 @@
+//
+// xmlchunked
+// Checks that XmlChunkedIterator finds the same elements as iterating
+// over the whole buffer at once, no matter where the chunks are split.
+//
+// Usage: xmlchunked [file.svg ...]
+// Along with a few documents of its own, every file named is checked,
+// split every way it can be into two chunks (for small documents), and
+// into a few hundred random runs of chunks.
+//
+// Returns 0 when everything matches.
+//
+// g++ -std=c++20 -I../src xmlchunked.cpp -o xmlchunked
+//
+
+#include "xmlscan.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace svg2b2d;
+
+static std::string describe(const XmlElement& elem)
+{
+	return std::to_string(elem.kind()) + ":" + std::string((const char*)elem.data().fStart, elem.data().size());
+}
+
+static std::vector<std::string> wholeElements(const std::string& doc)
+{
+	std::vector<std::string> out{};
+	XmlElementIterator iter(ByteSpan(doc.data(), doc.size()));
+	while (iter)
+	{
+		out.push_back(describe(*iter));
+		iter++;
+	}
+
+	return out;
+}
+
+// The document, fed as chunks of the given sizes
+static std::vector<std::string> chunkedElements(const std::string& doc, const std::vector<size_t>& sizes)
+{
+	std::vector<std::string> out{};
+	std::vector<std::unique_ptr<std::string>> chunks{};		// kept valid until the end, to be safe
+	XmlChunkedIterator iter{};
+
+	size_t pos = 0;
+	for (size_t n : sizes)
+	{
+		chunks.push_back(std::make_unique<std::string>(doc.substr(pos, n)));
+		pos += n;
+
+		iter.feed(ByteSpan(chunks.back()->data(), chunks.back()->size()));
+		while (iter.next() == XML_CHUNK_ELEMENT)
+			out.push_back(describe(*iter));
+	}
+
+	iter.finish();
+	while (iter.next() == XML_CHUNK_ELEMENT)
+		out.push_back(describe(*iter));
+
+	return out;
+}
+
+static uint32_t gSeed = 12345;
+static uint32_t nextRandom()
+{
+	gSeed = gSeed * 1664525u + 1013904223u;
+	return gSeed >> 8;
+}
+
+static int check(const char* name, const std::string& doc)
+{
+	std::vector<std::string> expected = wholeElements(doc);
+	int failures = 0;
+
+	auto compare = [&](const std::vector<size_t>& sizes) {
+		if (chunkedElements(doc, sizes) == expected)
+			return;
+
+		if (failures++ == 0)
+		{
+			printf("FAIL: %s, split at", name);
+			size_t at = 0;
+			for (size_t n : sizes)
+				printf(" %zu", at += n);
+			printf("\n");
+		}
+	};
+
+	// Every split into two
+	if (doc.size() <= 4096)
+	{
+		for (size_t i = 0; i <= doc.size(); i++)
+			compare({ i, doc.size() - i });
+	}
+
+	// Random runs of small, and larger, chunks
+	for (int trial = 0; trial < 500; trial++)
+	{
+		size_t maxChunk = (trial & 1) ? 16 : 512;
+		std::vector<size_t> sizes{};
+		for (size_t pos = 0; pos < doc.size(); )
+		{
+			size_t n = 1 + nextRandom() % maxChunk;
+			if (n > doc.size() - pos)
+				n = doc.size() - pos;
+			sizes.push_back(n);
+			pos += n;
+		}
+
+		compare(sizes);
+	}
+
+	printf("%s: %s (%zu elements)\n", failures ? "FAIL" : "ok", name, expected.size());
+
+	return failures;
+}
+
+static bool readFile(const char* filename, std::string& out)
+{
+	FILE* f = fopen(filename, "rb");
+	if (f == nullptr)
+		return false;
+
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		out.append(buf, n);
+	fclose(f);
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	int failures = 0;
+
+	failures += check("content with '>'", "<svg><text x=\"1\">a b > c</text></svg>");
+	failures += check("doctype", "<?xml version=\"1.0\"?>\n<!DOCTYPE svg>\n<svg><rect width=\"1\"/></svg>\n");
+	failures += check("mixed", "<?xml version=\"1.0\"?>\n<svg width=\"10\" height='20'>\n <!-- a comment -->\n"
+		" <g id=\"a\"><rect x=\"1\" y=\"2\"/>\n<text>hello > world</text><path d=\"M0 0 L 10 10 Z\"/></g>\n"
+		" <style><![CDATA[ .a { fill: red } ]]></style>\n</svg>\n");
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string doc{};
+		if (!readFile(argv[i], doc))
+		{
+			printf("FAIL: could not read %s\n", argv[i]);
+			failures++;
+			continue;
+		}
+
+		failures += check(argv[i], doc);
+	}
+
+	return failures ? 1 : 0;
+}